@@ -0,0 +1,155 @@
+/* -*- mode: C; coding: utf-8; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*-
+ *
+ * cfunge - A standard-conforming Befunge93/98/109 interpreter in C.
+ * Copyright (C) 2008-2013 Arvid Norlander <VorpalBlade AT users.noreply.github.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at the proxy's option) any later version. Arvid Norlander is a
+ * proxy who can decide which future versions of the GNU General Public
+ * License can be used.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "global.h"
+#include "checkpoint.h"
+
+#include "diagnostic.h"
+#include "image.h"
+#include "output.h"
+#include "settings.h"
+#include "funge-space/funge-space.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h> /* strerror, strlen */
+
+#include <sys/types.h>
+#include <sys/wait.h>  /* waitpid */
+#include <unistd.h>    /* fork, _exit */
+
+volatile sig_atomic_t checkpoint_requested = 0;
+
+/// Full checkpoints are written to this file and then renamed into place.
+static char *checkpoint_tmpfile = NULL;
+/// Process ID of the child writing the last checkpoint, 0 if none.
+static pid_t checkpoint_writer = 0;
+/// Does the checkpoint file need to be written in full next time?
+static bool checkpoint_need_full = true;
+
+static void checkpoint_signal_handler(int signum)
+{
+	(void)signum;
+	checkpoint_requested = 1;
+}
+
+FUNGE_ATTR_FAST void checkpoint_init(void)
+{
+	struct sigaction action;
+	size_t length;
+
+	if (!setting_checkpoint_file)
+		return;
+
+	length = strlen(setting_checkpoint_file);
+	checkpoint_tmpfile = malloc(length + sizeof(".tmp"));
+	if (FUNGE_UNLIKELY(!checkpoint_tmpfile)) {
+		DIAG_OOM("Could not allocate checkpoint file name.");
+	}
+	memcpy(checkpoint_tmpfile, setting_checkpoint_file, length);
+	memcpy(checkpoint_tmpfile + length, ".tmp", sizeof(".tmp"));
+
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = &checkpoint_signal_handler;
+	sigemptyset(&action.sa_mask);
+	// Don't disturb blocking reads in the program, the checkpoint is taken
+	// when it returns to the main loop anyway.
+	action.sa_flags = SA_RESTART;
+	if (FUNGE_UNLIKELY(sigaction(SIGUSR1, &action, NULL) != 0)) {
+		diag_fatal_format("Failed to install SIGUSR1 handler: %s", strerror(errno));
+	}
+}
+
+/**
+ * Actually write the checkpoint file.
+ * @return True if successful, otherwise false (errno will be set).
+ */
+#ifdef CONCURRENT_FUNGE
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL FUNGE_ATTR_WARN_UNUSED
+static bool checkpoint_do_write(const ipList * restrict ips, bool full)
+#else
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL FUNGE_ATTR_WARN_UNUSED
+static bool checkpoint_do_write(const instructionPointer * restrict ips, bool full)
+#endif
+{
+	if (!full)
+		return image_update(setting_checkpoint_file, ips);
+	// Don't destroy the previous checkpoint if writing this one fails.
+	return image_save(checkpoint_tmpfile, ips)
+	       && (rename(checkpoint_tmpfile, setting_checkpoint_file) == 0);
+}
+
+#ifdef CONCURRENT_FUNGE
+FUNGE_ATTR_FAST void checkpoint_write(const ipList * restrict ips)
+#else
+FUNGE_ATTR_FAST void checkpoint_write(const instructionPointer * restrict ips)
+#endif
+{
+	bool full;
+	pid_t pid;
+
+	checkpoint_requested = 0;
+
+	// Writers must not overlap, and if the last one failed the file on disk
+	// can't be updated incrementally.
+	if (checkpoint_writer > 0) {
+		int status;
+		pid_t result;
+		do {
+			result = waitpid(checkpoint_writer, &status, 0);
+		} while ((result == -1) && (errno == EINTR));
+		if ((result == -1) || !WIFEXITED(status) || (WEXITSTATUS(status) != 0))
+			checkpoint_need_full = true;
+		checkpoint_writer = 0;
+	}
+
+	// Output written so far belongs to the state before the checkpoint. Also
+	// this stops the child from having a copy of any unwritten output.
+	output_flush();
+
+	full = checkpoint_need_full;
+	pid = fork();
+	if (pid == 0) {
+		// Child.
+		if (!checkpoint_do_write(ips, full)) {
+			diag_error_format("Failed to write checkpoint \"%s\": %s",
+			                  setting_checkpoint_file, strerror(errno));
+			_exit(EXIT_FAILURE);
+		}
+		_exit(EXIT_SUCCESS);
+	} else if (pid > 0) {
+		checkpoint_writer = pid;
+		checkpoint_need_full = false;
+		fungespace_image_mark_clean();
+	} else {
+		// No fork, do it ourselves.
+		diag_warn_format("fork() failed (%s), writing checkpoint in foreground.", strerror(errno));
+		if (checkpoint_do_write(ips, full)) {
+			checkpoint_need_full = false;
+			fungespace_image_mark_clean();
+		} else {
+			diag_error_format("Failed to write checkpoint \"%s\": %s",
+			                  setting_checkpoint_file, strerror(errno));
+			checkpoint_need_full = true;
+		}
+	}
+}
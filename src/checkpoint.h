@@ -0,0 +1,64 @@
+/* -*- mode: C; coding: utf-8; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*-
+ *
+ * cfunge - A standard-conforming Befunge93/98/109 interpreter in C.
+ * Copyright (C) 2008-2013 Arvid Norlander <VorpalBlade AT users.noreply.github.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at the proxy's option) any later version. Arvid Norlander is a
+ * proxy who can decide which future versions of the GNU General Public
+ * License can be used.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file
+ * Checkpointing of a running program to an image on SIGUSR1.
+ *
+ * The image is written by a forked child, so the interpreter only pauses for
+ * the fork(). The first checkpoint is a full image, later ones only write
+ * the parts of the static area of Funge-Space that changed since the one
+ * before. A checkpoint is resumed by loading it as an image with -I.
+ */
+
+#ifndef FUNGE_HAD_SRC_CHECKPOINT_H
+#define FUNGE_HAD_SRC_CHECKPOINT_H
+
+#include "global.h"
+
+#include <signal.h>
+
+#include "ip.h"
+
+/// Set by the signal handler, checked by the main loop between instructions.
+extern volatile sig_atomic_t checkpoint_requested;
+
+/**
+ * Install the SIGUSR1 handler if a checkpoint file was given.
+ * @warning Should only be called from internal setup code.
+ */
+FUNGE_ATTR_FAST
+void checkpoint_init(void);
+
+/**
+ * Write a checkpoint. Must only be called between instructions (and, for
+ * concurrent Funge, between ticks).
+ * @param ips The IP list (or IP) to save.
+ */
+#ifdef CONCURRENT_FUNGE
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL FUNGE_ATTR_COLD
+void checkpoint_write(const ipList * restrict ips);
+#else
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL FUNGE_ATTR_COLD
+void checkpoint_write(const instructionPointer * restrict ips);
+#endif
+
+#endif
@@ -0,0 +1,12 @@
+%fingerprint-spec 1.4
+%fprint:3DPT
+%url:https://github.com/VorpalBlade/cfunge
+%desc:cfunge transforms of many 3DSP points at once
+%condition:!defined(CFUN_NO_FLOATS)
+%safe:true
+%begin-instrs
+#I Name              Desc
+T  transform_stack   Transform points on the stack
+V  map               Map points in Funge-Space to 2D view
+X  transform         Transform points in Funge-Space
+%end
@@ -0,0 +1,310 @@
+/* -*- mode: C; coding: utf-8; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*-
+ *
+ * cfunge - A standard-conforming Befunge93/98/109 interpreter in C.
+ * Copyright (C) 2008-2013 Arvid Norlander <VorpalBlade AT users.noreply.github.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at the proxy's option) any later version. Arvid Norlander is a
+ * proxy who can decide which future versions of the GNU General Public
+ * License can be used.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "3DPT.h"
+#if !defined(CFUN_NO_FLOATS)
+#include "../../stack.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif
+
+/*
+ * Points and matrices are stored as single precision floats in cells, as in
+ * 3DSP. A point is three cells (x y z), points in Funge-Space are stored one
+ * after another in a row. Results are exactly the same as when using 3DSP X
+ * and V for each point.
+ */
+
+/// An union for float and 32-bit int.
+typedef union u_floatint {
+	float f;
+	int32_t i;
+} floatint;
+
+/// Points as one array for each coordinate.
+typedef struct points {
+	size_t  count;
+	double *x;
+	double *y;
+	double *z;
+} points;
+
+
+/********************
+ * Helper functions *
+ ********************/
+
+/**
+ * Allocate room for count points, and optionally for the cells of them.
+ * @param p Points to allocate, free with free(p->x).
+ * @param cells If not NULL, set to a malloc()ed buffer of 3 * count cells.
+ * @return False if out of memory, then nothing is allocated.
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_WARN_UNUSED
+static bool points_alloc(points * restrict p, size_t count, funge_cell ** restrict cells)
+{
+	assert(count > 0);
+	if (count > SIZE_MAX / 3 / sizeof(double))
+		return false;
+	p->count = count;
+	p->x = malloc(3 * count * sizeof(double));
+	if (!p->x)
+		return false;
+	p->y = p->x + count;
+	p->z = p->y + count;
+	if (cells) {
+		*cells = malloc(3 * count * sizeof(funge_cell));
+		if (!*cells) {
+			free(p->x);
+			return false;
+		}
+	}
+	return true;
+}
+
+FUNGE_ATTR_FAST
+static inline double cell_to_double(funge_cell c)
+{
+	floatint u;
+	u.i = (int32_t)c;
+	return u.f;
+}
+
+FUNGE_ATTR_FAST
+static inline funge_cell double_to_cell(double d)
+{
+	floatint u;
+	u.f = (float)d;
+	return u.i;
+}
+
+/// Convert points from cells (x y z for each point).
+FUNGE_ATTR_FAST
+static void points_from_cells(points * restrict p, const funge_cell * restrict cells)
+{
+	for (size_t i = 0; i < p->count; i++) {
+		p->x[i] = cell_to_double(cells[3 * i]);
+		p->y[i] = cell_to_double(cells[3 * i + 1]);
+		p->z[i] = cell_to_double(cells[3 * i + 2]);
+	}
+}
+
+/// Convert points to cells (x y z for each point).
+FUNGE_ATTR_FAST
+static void points_to_cells(const points * restrict p, funge_cell * restrict cells)
+{
+	for (size_t i = 0; i < p->count; i++) {
+		cells[3 * i] = double_to_cell(p->x[i]);
+		cells[3 * i + 1] = double_to_cell(p->y[i]);
+		cells[3 * i + 2] = double_to_cell(p->z[i]);
+	}
+}
+
+/// Read the 4x4 matrix at fV, same as readMatrix() in 3DSP.
+FUNGE_ATTR_FAST
+static void read_matrix(const instructionPointer * restrict ip,
+                        const funge_vector * restrict fV, double m[restrict 16])
+{
+	const fungeRect rect = { fV->x + ip->storageOffset.x, fV->y + ip->storageOffset.y, 4, 4 };
+	funge_cell cells[16];
+	fungespace_get_rect(cells, &rect);
+	for (size_t i = 0; i < 16; i++)
+		m[i] = cell_to_double(cells[i]);
+}
+
+/**
+ * Transform points in place by the matrix m, with w = 1. The sums are done in
+ * the same order as mulMatrixVector() in 3DSP, so the results are the same.
+ * With SSE2 two points are done at once.
+ */
+FUNGE_ATTR_FAST
+static void transform_points(points * restrict p, const double m[restrict 16])
+{
+	double *out[3] = { p->x, p->y, p->z };
+	size_t i = 0;
+#ifdef __SSE2__
+	for (; i + 2 <= p->count; i += 2) {
+		const __m128d x = _mm_loadu_pd(p->x + i);
+		const __m128d y = _mm_loadu_pd(p->y + i);
+		const __m128d z = _mm_loadu_pd(p->z + i);
+		__m128d r[3];
+		for (size_t row = 0; row < 3; row++) {
+			__m128d n = _mm_setzero_pd();
+			n = _mm_add_pd(n, _mm_mul_pd(_mm_set1_pd(m[row * 4]), x));
+			n = _mm_add_pd(n, _mm_mul_pd(_mm_set1_pd(m[row * 4 + 1]), y));
+			n = _mm_add_pd(n, _mm_mul_pd(_mm_set1_pd(m[row * 4 + 2]), z));
+			r[row] = _mm_add_pd(n, _mm_set1_pd(m[row * 4 + 3]));
+		}
+		for (size_t row = 0; row < 3; row++)
+			_mm_storeu_pd(out[row] + i, r[row]);
+	}
+#endif
+	for (; i < p->count; i++) {
+		const double v[3] = { p->x[i], p->y[i], p->z[i] };
+		for (size_t row = 0; row < 3; row++) {
+			double n = 0;
+			for (size_t k = 0; k < 3; k++)
+				n += m[row * 4 + k] * v[k];
+			out[row][i] = n + m[row * 4 + 3];
+		}
+	}
+}
+
+/// Pop the position of a row of points, and adjust for the storage offset.
+FUNGE_ATTR_FAST
+static inline funge_vector pop_position(instructionPointer * restrict ip)
+{
+	funge_vector pos = stack_pop_vector(ip->stack);
+	pos.x += ip->storageOffset.x;
+	pos.y += ip->storageOffset.y;
+	return pos;
+}
+
+/**
+ * Read count points from a row in Funge-Space.
+ * @param cells Buffer for 3 * count cells.
+ */
+FUNGE_ATTR_FAST
+static void read_points(points * restrict p, funge_cell * restrict cells,
+                        const funge_vector * restrict pos)
+{
+	fungespace_get_row(cells, pos, 3 * p->count);
+	points_from_cells(p, cells);
+}
+
+
+/****************************
+ * Fingerprint instructions *
+ ****************************/
+
+/// T - Transform points on the stack
+static void finger_3DPT_transform_stack(instructionPointer * ip)
+{
+	funge_vector fm = stack_pop_vector(ip->stack);
+	funge_cell n = stack_pop(ip->stack);
+	double m[16];
+	funge_cell *cells;
+	points p;
+
+	// Unlike with other instructions, the points must be on the stack.
+	if (n < 0 || (size_t)n > ip->stack->top / 3) {
+		ip_reverse(ip);
+		return;
+	}
+	if (n == 0)
+		return;
+	if (!points_alloc(&p, (size_t)n, NULL)) {
+		ip_reverse(ip);
+		return;
+	}
+	read_matrix(ip, &fm, m);
+	// The points are directly below the top of the stack.
+	cells = ip->stack->entries + ip->stack->top - 3 * p.count;
+	points_from_cells(&p, cells);
+	transform_points(&p, m);
+	points_to_cells(&p, cells);
+	free(p.x);
+}
+
+/// V - Map points in Funge-Space to 2D view
+static void finger_3DPT_map(instructionPointer * ip)
+{
+	funge_cell n = stack_pop(ip->stack);
+	funge_vector src = pop_position(ip);
+	funge_vector dst = pop_position(ip);
+	funge_cell *cells;
+	points p;
+
+	if (n < 0) {
+		ip_reverse(ip);
+		return;
+	}
+	if (n == 0)
+		return;
+	if (!points_alloc(&p, (size_t)n, &cells)) {
+		ip_reverse(ip);
+		return;
+	}
+	read_points(&p, cells, &src);
+	// Same as 3DSP V.
+	for (size_t i = 0; i < p.count; i++) {
+		double x = p.x[i], y = p.y[i], z = p.z[i];
+#ifdef FP_ZERO
+		if (fpclassify(z) != FP_ZERO)
+#else
+		if (z != 0)
+#endif
+		{
+			x /= z;
+			y /= z;
+		}
+		cells[2 * i] = double_to_cell(x);
+		cells[2 * i + 1] = double_to_cell(y);
+	}
+	fungespace_set_row(cells, &dst, 2 * p.count);
+	free(cells);
+	free(p.x);
+}
+
+/// X - Transform points in Funge-Space
+static void finger_3DPT_transform(instructionPointer * ip)
+{
+	funge_vector fm = stack_pop_vector(ip->stack);
+	funge_cell n = stack_pop(ip->stack);
+	funge_vector src = pop_position(ip);
+	funge_vector dst = pop_position(ip);
+	double m[16];
+	funge_cell *cells;
+	points p;
+
+	if (n < 0) {
+		ip_reverse(ip);
+		return;
+	}
+	if (n == 0)
+		return;
+	if (!points_alloc(&p, (size_t)n, &cells)) {
+		ip_reverse(ip);
+		return;
+	}
+	read_matrix(ip, &fm, m);
+	read_points(&p, cells, &src);
+	transform_points(&p, m);
+	points_to_cells(&p, cells);
+	fungespace_set_row(cells, &dst, 3 * p.count);
+	free(cells);
+	free(p.x);
+}
+
+bool finger_3DPT_load(instructionPointer * ip)
+{
+	manager_add_opcode(3DPT, 'T', transform_stack);
+	manager_add_opcode(3DPT, 'V', map);
+	manager_add_opcode(3DPT, 'X', transform);
+	return true;
+}
+#endif /* !defined(CFUN_NO_FLOATS) */
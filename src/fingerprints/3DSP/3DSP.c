@@ -100,33 +100,40 @@ static inline double vector_length(const double vec[restrict 3])
 	return sqrt(vec[0] * vec[0] + vec[1] * vec[1] + vec[2] * vec[2]);
 }
 
+/// The 4x4 rectangle of the matrix at fV, adjusted for the storage offset.
+FUNGE_ATTR_FAST
+static inline fungeRect matrixRect(const instructionPointer * restrict ip,
+                                   const funge_vector * restrict fV)
+{
+	fungeRect rect = { fV->x + ip->storageOffset.x, fV->y + ip->storageOffset.y, 4, 4 };
+	return rect;
+}
+
 FUNGE_ATTR_FAST
 static inline void writeMatrix(const instructionPointer * restrict ip,
                                const funge_vector * restrict fV, const double m[restrict 16])
 {
-	const funge_cell basex = fV->x + ip->storageOffset.x;
-	const funge_cell basey = fV->y + ip->storageOffset.y;
-	for (funge_cell y = 0; y < 4; ++y) {
-		for (funge_cell x = 0; x < 4; ++x) {
-			floatint u;
-			u.f = (float)m[4 * y + x];
-			fungespace_set(u.i, vector_create_ref(basex + x, basey + y));
-		}
+	const fungeRect rect = matrixRect(ip, fV);
+	funge_cell cells[16];
+	for (size_t i = 0; i < 16; ++i) {
+		floatint u;
+		u.f = (float)m[i];
+		cells[i] = u.i;
 	}
+	fungespace_set_rect(cells, &rect);
 }
 
 FUNGE_ATTR_FAST
 static inline void readMatrix(const instructionPointer * restrict ip,
                               const funge_vector * restrict fV, double m[restrict 16])
 {
-	const funge_cell basex = fV->x + ip->storageOffset.x;
-	const funge_cell basey = fV->y + ip->storageOffset.y;
-	for (funge_cell y = 0; y < 4; ++y) {
-		for (funge_cell x = 0; x < 4; ++x) {
-			floatint u;
-			u.i = (int32_t)fungespace_get(vector_create_ref(basex + x, basey + y));
-			m[y * 4 + x] = u.f;
-		}
+	const fungeRect rect = matrixRect(ip, fV);
+	funge_cell cells[16];
+	fungespace_get_rect(cells, &rect);
+	for (size_t i = 0; i < 16; ++i) {
+		floatint u;
+		u.i = (int32_t)cells[i];
+		m[i] = u.f;
 	}
 }
 
@@ -254,21 +261,16 @@ static void finger_3DSP_normalise(instructionPointer * ip)
 static void finger_3DSP_matrix_copy(instructionPointer * ip)
 {
 	funge_vector fs, ft;
+	fungeRect rs, rt;
+	funge_cell cells[16];
 
 	fs = stack_pop_vector(ip->stack);
 	ft = stack_pop_vector(ip->stack);
-	// Add in storage offset
-	fs.x += ip->storageOffset.x;
-	fs.y += ip->storageOffset.y;
-	ft.x += ip->storageOffset.x;
-	ft.y += ip->storageOffset.y;
+	rs = matrixRect(ip, &fs);
+	rt = matrixRect(ip, &ft);
 
-
-	for (funge_cell y = 0; y < 4; ++y)
-		for (funge_cell x = 0; x < 4; ++x) {
-			fungespace_set(fungespace_get(vector_create_ref(fs.x + x, fs.y + y)),
-			               vector_create_ref(ft.x + x, ft.y + y));
-		}
+	fungespace_get_rect(cells, &rs);
+	fungespace_set_rect(cells, &rt);
 }
 
 /// R - Generate a rotation matrix
@@ -29,37 +29,34 @@
 static void finger_DIRF_chdir(instructionPointer * ip)
 {
 	size_t len;
-	char * restrict str = (char*)stack_pop_string(ip->stack, &len);
+	const char * restrict str = (const char*)stack_pop_string_scratch(ip->stack, &len);
 	if (!str || (len < 1)) {
 		ip_reverse(ip);
 	} else if (chdir(str) != 0) {
 		ip_reverse(ip);
 	}
-	stack_free_string(str);
 }
 
 static void finger_DIRF_mkdir(instructionPointer * ip)
 {
 	size_t len;
-	char * restrict str = (char*)stack_pop_string(ip->stack, &len);
+	const char * restrict str = (const char*)stack_pop_string_scratch(ip->stack, &len);
 	if (!str || (len < 1)) {
 		ip_reverse(ip);
 	} else if (mkdir(str, S_IRWXU) != 0) {
 		ip_reverse(ip);
 	}
-	stack_free_string(str);
 }
 
 static void finger_DIRF_rmdir(instructionPointer * ip)
 {
 	size_t len;
-	char * restrict str = (char*)stack_pop_string(ip->stack, &len);
+	const char * restrict str = (const char*)stack_pop_string_scratch(ip->stack, &len);
 	if (!str || (len < 1)) {
 		ip_reverse(ip);
 	} else if (rmdir(str) != 0) {
 		ip_reverse(ip);
 	}
-	stack_free_string(str);
 }
 
 
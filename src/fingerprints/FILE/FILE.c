@@ -125,14 +125,12 @@ static void finger_FILE_fclose(instructionPointer * ip)
 /// D - Delete specified file
 static void finger_FILE_delete(instructionPointer * ip)
 {
-	char * restrict filename;
+	const char * restrict filename;
 
-	filename = (char*)stack_pop_string(ip->stack, NULL);
+	filename = (const char*)stack_pop_string_scratch(ip->stack, NULL);
 	if (!filename || (unlink(filename) != 0)) {
 		ip_reverse(ip);
 	}
-
-	stack_free_string(filename);
 }
 
 
@@ -238,12 +236,12 @@ static const char* const mode_table[] = {
 /// O - Open a file (Va = i/o buffer vector)
 static void finger_FILE_fopen(instructionPointer * ip)
 {
-	char * restrict filename;
+	const char * restrict filename;
 	funge_cell mode;
 	funge_vector vect;
 	funge_cell h;
 
-	filename = (char*)stack_pop_string(ip->stack, NULL);
+	filename = (const char*)stack_pop_string_scratch(ip->stack, NULL);
 	if (FUNGE_UNLIKELY(!filename))
 		goto error;
 	mode = stack_pop(ip->stack);
@@ -275,21 +273,19 @@ static void finger_FILE_fopen(instructionPointer * ip)
 
 	handles[h]->buffvect = vect;
 	stack_push(ip->stack, h);
-	goto end;
+	return;
 // Look... The alternatives to the goto were worse...
 error:
 	ip_reverse(ip);
-end:
-	stack_free_string(filename);
 }
 
 /// P - Put string to file (like c fputs)
 static void finger_FILE_fputs(instructionPointer * ip)
 {
-	char * restrict str;
+	const char * restrict str;
 	funge_cell h;
 
-	str = (char*)stack_pop_string(ip->stack, NULL);
+	str = (const char*)stack_pop_string_scratch(ip->stack, NULL);
 	h = stack_peek(ip->stack);
 	if (!valid_handle(h) || !str) {
 		ip_reverse(ip);
@@ -299,7 +295,6 @@ static void finger_FILE_fputs(instructionPointer * ip)
 			ip_reverse(ip);
 		}
 	}
-	stack_free_string(str);
 }
 
 /// R - Read n bytes from file to i/o buffer
@@ -65,6 +65,163 @@
 #define FUNGE_PI_180 (M_PIl / 180.0)
 #define FUNGE_180_PI (180.0 / M_PIl)
 
+/*
+ * The trigonometric functions are defined by the long double expressions in
+ * the fixp_ref_* functions below. Those are slow (long double math is done
+ * on the x87 FPU on x86-64), so the value is first computed with double math
+ * along with a bound on the error. The result of the rounding is only used if
+ * it can't differ from the rounding of the exact value, which means it is the
+ * same as the long double result too. Otherwise (when the value is close to
+ * halfway between two integers or out of range) the reference is used.
+ */
+
+/// Radians per unit of input to sin, cos and tan (1/10000 degree).
+#define FIXP_RAD_PER_UNIT (M_PI / 1800000.0)
+/// Output units per radian from asin, acos and atan.
+#define FIXP_UNITS_PER_RAD (1800000.0 / M_PI)
+/// Largest input to sin, cos and tan that is handled with double math.
+#define FIXP_TRIG_MAX 2147483647
+/// Relative error to allow for each rounded double operation. Several times
+/// larger than needed, this also covers the error of the reference.
+#define FIXP_EPS 2e-15
+
+/**
+ * Round y like roundl() does, if that can be decided from y alone.
+ * @param y Approximation of the value to round.
+ * @param err Bound on the absolute error of y.
+ * @param result Set to the rounded value on success.
+ * @return False if the exact value could round differently or is out of range.
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL FUNGE_ATTR_WARN_UNUSED
+static inline bool fixp_round(double y, double err, funge_cell * result)
+{
+	funge_cell r;
+	// Also false for NaN.
+	if (!(fabs(y) < 2147483647.0))
+		return false;
+	r = (funge_cell)(y < 0 ? y - 0.5 : y + 0.5);
+	if (fabs(y - (double)r) >= 0.5 - err)
+		return false;
+	*result = r;
+	return true;
+}
+
+/// @defgroup fixp_ref Reference versions of the trigonometric functions.
+//@{
+static funge_cell fixp_ref_acos(funge_cell n)
+{
+	long double d = roundl(10000 * acosl((long double)n / 10000.0L) * FUNGE_180_PI);
+	return (funge_cell)d;
+}
+
+static funge_cell fixp_ref_asin(funge_cell n)
+{
+	long double d = roundl(10000 * asinl((long double)n / 10000.0L) * FUNGE_180_PI);
+	return (funge_cell)d;
+}
+
+static funge_cell fixp_ref_atan(funge_cell n)
+{
+	long double d = roundl(10000 * atanl((long double)n / 10000.0L)  * FUNGE_180_PI);
+	return (funge_cell)d;
+}
+
+static funge_cell fixp_ref_cos(funge_cell n)
+{
+	long double d = roundl(10000 * cosl(((long double)n / 10000.0L) * FUNGE_PI_180));
+	return (funge_cell)d;
+}
+
+static funge_cell fixp_ref_sin(funge_cell n)
+{
+	long double d = roundl(10000 * sinl(((long double)n / 10000.0L) * FUNGE_PI_180));
+	return (funge_cell)d;
+}
+
+static funge_cell fixp_ref_tan(funge_cell n)
+{
+	long double d = roundl(10000 * tanl(((long double)n / 10000.0L) * FUNGE_PI_180));
+	return (funge_cell)d;
+}
+//@}
+
+/// asin and acos: The derivative is at most 71 for |n| < 10000, and for
+/// |n| = 10000 the argument is exact.
+static funge_cell fixp_acos(funge_cell n)
+{
+	funge_cell r;
+	if (n >= -10000 && n <= 10000) {
+		double y = acos(n / 10000.0) * FIXP_UNITS_PER_RAD;
+		if (fixp_round(y, (71 * FIXP_UNITS_PER_RAD + fabs(y) + 1) * FIXP_EPS, &r))
+			return r;
+	}
+	return fixp_ref_acos(n);
+}
+
+static funge_cell fixp_asin(funge_cell n)
+{
+	funge_cell r;
+	if (n >= -10000 && n <= 10000) {
+		double y = asin(n / 10000.0) * FIXP_UNITS_PER_RAD;
+		if (fixp_round(y, (71 * FIXP_UNITS_PER_RAD + fabs(y) + 1) * FIXP_EPS, &r))
+			return r;
+	}
+	return fixp_ref_asin(n);
+}
+
+/// atan: The error from the argument is at most half the output scale.
+static funge_cell fixp_atan(funge_cell n)
+{
+	funge_cell r;
+	double y = atan(n / 10000.0) * FIXP_UNITS_PER_RAD;
+	if (fixp_round(y, (FIXP_UNITS_PER_RAD + fabs(y) + 1) * FIXP_EPS, &r))
+		return r;
+	return fixp_ref_atan(n);
+}
+
+/// sin and cos: The error grows with the argument, as does the difference
+/// between the double and long double arguments.
+static funge_cell fixp_cos(funge_cell n)
+{
+	funge_cell r;
+	if (n >= -FIXP_TRIG_MAX && n <= FIXP_TRIG_MAX) {
+		double x = n * FIXP_RAD_PER_UNIT;
+		double y = 10000 * cos(x);
+		if (fixp_round(y, (10000 * fabs(x) + fabs(y) + 1) * FIXP_EPS, &r))
+			return r;
+	}
+	return fixp_ref_cos(n);
+}
+
+static funge_cell fixp_sin(funge_cell n)
+{
+	funge_cell r;
+	if (n >= -FIXP_TRIG_MAX && n <= FIXP_TRIG_MAX) {
+		double x = n * FIXP_RAD_PER_UNIT;
+		double y = 10000 * sin(x);
+		if (fixp_round(y, (10000 * fabs(x) + fabs(y) + 1) * FIXP_EPS, &r))
+			return r;
+	}
+	return fixp_ref_sin(n);
+}
+
+/// tan: As sin and cos, but the derivative is 1 + tan^2.
+static funge_cell fixp_tan(funge_cell n)
+{
+	funge_cell r;
+	if (n >= -FIXP_TRIG_MAX && n <= FIXP_TRIG_MAX) {
+		double x = n * FIXP_RAD_PER_UNIT;
+		double t = tan(x);
+		double y = 10000 * t;
+		if (fixp_round(y, (10000 * (1 + t * t) * fabs(x) + fabs(y) + 1) * FIXP_EPS, &r))
+			return r;
+	}
+	return fixp_ref_tan(n);
+}
+
+// tools/fixp-check.c includes this file for the functions above only.
+#ifndef FIXP_CHECK
+
 /// A - and
 static void finger_FIXP_and(instructionPointer * ip)
 {
@@ -74,20 +231,13 @@ static void finger_FIXP_and(instructionPointer * ip)
 /// B - acos
 static void finger_FIXP_acos(instructionPointer * ip)
 {
-	long double d;
-	funge_cell n = stack_pop(ip->stack);
-	d = roundl(10000 * acosl((long double)n / 10000.0L) * FUNGE_180_PI);
-	stack_push(ip->stack, (funge_cell)d);
+	stack_push(ip->stack, fixp_acos(stack_pop(ip->stack)));
 }
 
 /// C - cos
 static void finger_FIXP_cos(instructionPointer * ip)
 {
-	long double d;
-	funge_cell n = stack_pop(ip->stack);
-	d = roundl(10000 * cosl(((long double)n / 10000.0L) * FUNGE_PI_180));
-	stack_push(ip->stack, (funge_cell)d);
-
+	stack_push(ip->stack, fixp_cos(stack_pop(ip->stack)));
 }
 
 /// D - rand
@@ -105,19 +255,13 @@ static void finger_FIXP_rand(instructionPointer * ip)
 /// I - sin
 static void finger_FIXP_sin(instructionPointer * ip)
 {
-	long double d;
-	funge_cell n = stack_pop(ip->stack);
-	d = roundl(10000 * sinl(((long double)n / 10000.0L) * FUNGE_PI_180));
-	stack_push(ip->stack, (funge_cell)d);
+	stack_push(ip->stack, fixp_sin(stack_pop(ip->stack)));
 }
 
 /// J - asin
 static void finger_FIXP_asin(instructionPointer * ip)
 {
-	long double d;
-	funge_cell n = stack_pop(ip->stack);
-	d = roundl(10000 * asinl((long double)n / 10000.0L) * FUNGE_180_PI);
-	stack_push(ip->stack, (funge_cell)d);
+	stack_push(ip->stack, fixp_asin(stack_pop(ip->stack)));
 }
 
 /// N - neg
@@ -168,19 +312,13 @@ static void finger_FIXP_signbit(instructionPointer * ip)
 /// T - tan
 static void finger_FIXP_tan(instructionPointer * ip)
 {
-	long double d;
-	funge_cell n = stack_pop(ip->stack);
-	d = roundl(10000 * tanl(((long double)n / 10000.0L) * FUNGE_PI_180));
-	stack_push(ip->stack, (funge_cell)d);
+	stack_push(ip->stack, fixp_tan(stack_pop(ip->stack)));
 }
 
 /// U - atan
 static void finger_FIXP_atan(instructionPointer * ip)
 {
-	long double d;
-	funge_cell n = stack_pop(ip->stack);
-	d = roundl(10000 * atanl((long double)n / 10000.0L)  * FUNGE_180_PI);
-	stack_push(ip->stack, (funge_cell)d);
+	stack_push(ip->stack, fixp_atan(stack_pop(ip->stack)));
 }
 
 /// V - abs
@@ -215,4 +353,5 @@ bool finger_FIXP_load(instructionPointer * ip)
 	manager_add_opcode(FIXP, 'X', xor);
 	return true;
 }
+#endif /* FIXP_CHECK */
 #endif /* !defined(CFUN_NO_FLOATS) */
@@ -0,0 +1,26 @@
+%fingerprint-spec 1.4
+%fprint:FPAR
+%url:https://github.com/VorpalBlade/cfunge
+%desc:cfunge arrays of double precision floating point numbers
+%condition:!defined(CFUN_NO_FLOATS)
+%safe:true
+%begin-instrs
+#I Name              Desc
+A  add               Add arrays
+B  abs               Absolute value of array
+C  cos               Cosine of array
+D  div               Divide arrays
+E  exp               Exponential of array
+F  fill              Fill array with value
+I  sin               Sine of array
+K  scale             Multiply array by value
+L  log               Natural logarithm of array
+M  mul               Multiply arrays
+N  neg               Negate array
+P  dot               Push dot product of arrays
+Q  sqrt              Square root of array
+S  sub               Subtract arrays
+U  sum               Push sum of array
+X  max               Push maximum of array
+Y  min               Push minimum of array
+%end
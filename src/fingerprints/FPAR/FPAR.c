@@ -0,0 +1,680 @@
+/* -*- mode: C; coding: utf-8; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*-
+ *
+ * cfunge - A standard-conforming Befunge93/98/109 interpreter in C.
+ * Copyright (C) 2008-2013 Arvid Norlander <VorpalBlade AT users.noreply.github.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at the proxy's option) any later version. Arvid Norlander is a
+ * proxy who can decide which future versions of the GNU General Public
+ * License can be used.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "FPAR.h"
+#if !defined(CFUN_NO_FLOATS)
+#include "../../stack.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/*
+ * An array is a rectangle of doubles in Funge-Space, each stored as two
+ * cells next to each other in the same order as FPDP uses on the stack. The
+ * size of an array is given as a vector (w h) of w doubles (2w cells) in each
+ * of h rows. Arrays are read completely before the result is written, so the
+ * destination may overlap the sources.
+ *
+ * On x86-64 the loops that can use SIMD have AVX2 versions, used if the CPU
+ * supports it. The plain C versions do the same operations in the same order,
+ * so the results are the same on all CPUs, apart from which NaN a NaN result
+ * is. Other functions (sin and so on) are done one element at a time with
+ * the C library.
+ */
+
+#if defined(CFUNGE_ARCH_X86_64) \
+    && (defined(CFUNGE_COMP_CLANG) || (defined(CFUNGE_COMP_GCC) && (__GNUC__ >= 5)))
+#  define FPAR_AVX2
+#  include <immintrin.h>
+/// Compile a function for AVX2.
+#  define FPAR_TARGET_AVX2 FUNGE_ATTR((target("avx2")))
+#endif
+
+/// An union for double and two 32-bit ints, same layout as in FPDP.
+typedef union u_doubleint {
+	double d;
+	struct { int32_t high; int32_t low; } i;
+} doubleint;
+
+/// Operations on two arrays.
+typedef enum fpar_binary_op {
+	FPAR_ADD,
+	FPAR_SUB,
+	FPAR_MUL,
+	FPAR_DIV
+} fpar_binary_op;
+
+/// Operations on one array, the ones before FPAR_SIN have AVX2 versions.
+typedef enum fpar_unary_op {
+	FPAR_SQRT,
+	FPAR_ABS,
+	FPAR_NEG,
+	FPAR_SCALE,
+	FPAR_SIN,
+	FPAR_COS,
+	FPAR_EXP,
+	FPAR_LOG
+} fpar_unary_op;
+
+#ifdef FPAR_AVX2
+static bool useAVX2 = false;
+#endif
+
+// Buffer for one row of cells.
+static funge_cell *rowBuffer = NULL;
+static size_t rowBufferSize = 0;
+
+
+/*****************************
+ * Plain C versions of loops *
+ *****************************/
+
+FUNGE_ATTR_FAST
+static void c_binary(fpar_binary_op op, double *dst, const double *a, const double *b, size_t n)
+{
+	switch (op) {
+		case FPAR_ADD: for (size_t i = 0; i < n; i++) dst[i] = a[i] + b[i]; break;
+		case FPAR_SUB: for (size_t i = 0; i < n; i++) dst[i] = a[i] - b[i]; break;
+		case FPAR_MUL: for (size_t i = 0; i < n; i++) dst[i] = a[i] * b[i]; break;
+		case FPAR_DIV: for (size_t i = 0; i < n; i++) dst[i] = a[i] / b[i]; break;
+	}
+}
+
+FUNGE_ATTR_FAST
+static void c_unary(fpar_unary_op op, double *dst, const double *a, size_t n, double k)
+{
+	switch (op) {
+		case FPAR_SQRT:  for (size_t i = 0; i < n; i++) dst[i] = sqrt(a[i]); break;
+		case FPAR_ABS:   for (size_t i = 0; i < n; i++) dst[i] = fabs(a[i]); break;
+		case FPAR_NEG:   for (size_t i = 0; i < n; i++) dst[i] = -a[i]; break;
+		case FPAR_SCALE: for (size_t i = 0; i < n; i++) dst[i] = a[i] * k; break;
+		case FPAR_SIN:   for (size_t i = 0; i < n; i++) dst[i] = sin(a[i]); break;
+		case FPAR_COS:   for (size_t i = 0; i < n; i++) dst[i] = cos(a[i]); break;
+		case FPAR_EXP:   for (size_t i = 0; i < n; i++) dst[i] = exp(a[i]); break;
+		case FPAR_LOG:   for (size_t i = 0; i < n; i++) dst[i] = log(a[i]); break;
+	}
+}
+
+/*
+ * Reductions keep four partial results, element i going to number i % 4, and
+ * combine them as (r0 op r2) op (r1 op r3) before the last n % 4 elements.
+ * This is the order the AVX2 versions use. Minimum and maximum work like the
+ * SSE/AVX instructions: if a comparison is false (such as with NaN) the
+ * second operand is the result.
+ */
+
+FUNGE_ATTR_FAST FUNGE_ATTR_PURE
+static double c_sum(const double *a, const double *b, size_t n)
+{
+	double r[4] = { 0.0, 0.0, 0.0, 0.0 };
+	double result;
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		for (size_t j = 0; j < 4; j++)
+			r[j] += b ? a[i + j] * b[i + j] : a[i + j];
+	}
+	result = (r[0] + r[2]) + (r[1] + r[3]);
+	for (; i < n; i++)
+		result += b ? a[i] * b[i] : a[i];
+	return result;
+}
+
+#define MIN_OP(m_a, m_b) ((m_a) < (m_b) ? (m_a) : (m_b))
+#define MAX_OP(m_a, m_b) ((m_a) > (m_b) ? (m_a) : (m_b))
+
+/// Tail of min/max, r has the combined partial results (or a[0] if n < 4).
+FUNGE_ATTR_FAST FUNGE_ATTR_PURE
+static double minmax_tail(bool max, double r, const double *a, size_t i, size_t n)
+{
+	for (; i < n; i++)
+		r = max ? MAX_OP(r, a[i]) : MIN_OP(r, a[i]);
+	return r;
+}
+
+FUNGE_ATTR_FAST FUNGE_ATTR_PURE
+static double c_minmax(bool max, const double *a, size_t n)
+{
+	double r[4], t0, t1;
+	size_t i = 4;
+	if (n < 4)
+		return minmax_tail(max, a[0], a, 1, n);
+	for (size_t j = 0; j < 4; j++)
+		r[j] = a[j];
+	for (; i + 4 <= n; i += 4) {
+		for (size_t j = 0; j < 4; j++)
+			r[j] = max ? MAX_OP(r[j], a[i + j]) : MIN_OP(r[j], a[i + j]);
+	}
+	t0 = max ? MAX_OP(r[0], r[2]) : MIN_OP(r[0], r[2]);
+	t1 = max ? MAX_OP(r[1], r[3]) : MIN_OP(r[1], r[3]);
+	return minmax_tail(max, max ? MAX_OP(t0, t1) : MIN_OP(t0, t1), a, i, n);
+}
+
+
+/***********************
+ * AVX2 version of them *
+ ***********************/
+
+#ifdef FPAR_AVX2
+FPAR_TARGET_AVX2 FUNGE_ATTR_FAST
+static void avx2_binary(fpar_binary_op op, double *dst, const double *a, const double *b, size_t n)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m256d x = _mm256_loadu_pd(a + i);
+		__m256d y = _mm256_loadu_pd(b + i);
+		switch (op) {
+			case FPAR_ADD: x = _mm256_add_pd(x, y); break;
+			case FPAR_SUB: x = _mm256_sub_pd(x, y); break;
+			case FPAR_MUL: x = _mm256_mul_pd(x, y); break;
+			case FPAR_DIV: x = _mm256_div_pd(x, y); break;
+		}
+		_mm256_storeu_pd(dst + i, x);
+	}
+	c_binary(op, dst + i, a + i, b + i, n - i);
+}
+
+FPAR_TARGET_AVX2 FUNGE_ATTR_FAST
+static void avx2_unary(fpar_unary_op op, double *dst, const double *a, size_t n, double k)
+{
+	const __m256d sign = _mm256_set1_pd(-0.0);
+	const __m256d factor = _mm256_set1_pd(k);
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m256d x = _mm256_loadu_pd(a + i);
+		switch (op) {
+			case FPAR_SQRT:  x = _mm256_sqrt_pd(x); break;
+			case FPAR_ABS:   x = _mm256_andnot_pd(sign, x); break;
+			case FPAR_NEG:   x = _mm256_xor_pd(sign, x); break;
+			case FPAR_SCALE: x = _mm256_mul_pd(x, factor); break;
+			// Not used, see do_unary().
+			case FPAR_SIN:
+			case FPAR_COS:
+			case FPAR_EXP:
+			case FPAR_LOG:
+				break;
+		}
+		_mm256_storeu_pd(dst + i, x);
+	}
+	c_unary(op, dst + i, a + i, n - i, k);
+}
+
+FPAR_TARGET_AVX2 FUNGE_ATTR_FAST FUNGE_ATTR_PURE
+static double avx2_sum(const double *a, const double *b, size_t n)
+{
+	__m256d r = _mm256_setzero_pd();
+	__m128d t;
+	double result;
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m256d x = _mm256_loadu_pd(a + i);
+		if (b)
+			x = _mm256_mul_pd(x, _mm256_loadu_pd(b + i));
+		r = _mm256_add_pd(r, x);
+	}
+	t = _mm_add_pd(_mm256_castpd256_pd128(r), _mm256_extractf128_pd(r, 1));
+	result = _mm_cvtsd_f64(t) + _mm_cvtsd_f64(_mm_unpackhi_pd(t, t));
+	for (; i < n; i++)
+		result += b ? a[i] * b[i] : a[i];
+	return result;
+}
+
+FPAR_TARGET_AVX2 FUNGE_ATTR_FAST FUNGE_ATTR_PURE
+static double avx2_minmax(bool max, const double *a, size_t n)
+{
+	__m256d r;
+	__m128d t;
+	double t0, t1;
+	size_t i = 4;
+	if (n < 4)
+		return minmax_tail(max, a[0], a, 1, n);
+	r = _mm256_loadu_pd(a);
+	for (; i + 4 <= n; i += 4) {
+		__m256d x = _mm256_loadu_pd(a + i);
+		r = max ? _mm256_max_pd(r, x) : _mm256_min_pd(r, x);
+	}
+	t = max ? _mm_max_pd(_mm256_castpd256_pd128(r), _mm256_extractf128_pd(r, 1))
+	        : _mm_min_pd(_mm256_castpd256_pd128(r), _mm256_extractf128_pd(r, 1));
+	t0 = _mm_cvtsd_f64(t);
+	t1 = _mm_cvtsd_f64(_mm_unpackhi_pd(t, t));
+	return minmax_tail(max, max ? MAX_OP(t0, t1) : MIN_OP(t0, t1), a, i, n);
+}
+#endif
+
+
+/*********************************
+ * Pick the version of each loop *
+ *********************************/
+
+FUNGE_ATTR_FAST
+static inline void do_binary(fpar_binary_op op, double *dst, const double *a, const double *b, size_t n)
+{
+#ifdef FPAR_AVX2
+	if (useAVX2) {
+		avx2_binary(op, dst, a, b, n);
+		return;
+	}
+#endif
+	c_binary(op, dst, a, b, n);
+}
+
+FUNGE_ATTR_FAST
+static inline void do_unary(fpar_unary_op op, double *dst, const double *a, size_t n, double k)
+{
+#ifdef FPAR_AVX2
+	if (useAVX2 && op < FPAR_SIN) {
+		avx2_unary(op, dst, a, n, k);
+		return;
+	}
+#endif
+	c_unary(op, dst, a, n, k);
+}
+
+/// Sum of a, or dot product of a and b if b isn't NULL.
+FUNGE_ATTR_FAST
+static inline double do_sum(const double *a, const double *b, size_t n)
+{
+#ifdef FPAR_AVX2
+	if (useAVX2)
+		return avx2_sum(a, b, n);
+#endif
+	return c_sum(a, b, n);
+}
+
+/// Minimum or maximum of a, n must be at least 1.
+FUNGE_ATTR_FAST
+static inline double do_minmax(bool max, const double *a, size_t n)
+{
+#ifdef FPAR_AVX2
+	if (useAVX2)
+		return avx2_minmax(max, a, n);
+#endif
+	return c_minmax(max, a, n);
+}
+
+
+/****************************
+ * Funge-Space and the stack *
+ ****************************/
+
+FUNGE_ATTR_FAST
+static inline double pop_double(instructionPointer * restrict ip)
+{
+	doubleint u;
+	u.i.low = (int32_t)stack_pop(ip->stack);
+	u.i.high = (int32_t)stack_pop(ip->stack);
+	return u.d;
+}
+
+FUNGE_ATTR_FAST
+static inline void push_double(instructionPointer * restrict ip, double d)
+{
+	doubleint u;
+	u.d = d;
+	stack_push(ip->stack, u.i.high);
+	stack_push(ip->stack, u.i.low);
+}
+
+/// Pop the position of an array, relative to the storage offset.
+FUNGE_ATTR_FAST
+static inline funge_vector pop_position(instructionPointer * restrict ip)
+{
+	funge_vector pos = stack_pop_vector(ip->stack);
+	pos.x += ip->storageOffset.x;
+	pos.y += ip->storageOffset.y;
+	return pos;
+}
+
+/**
+ * Pop the size of an array.
+ * @return False if the size is negative or too large.
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_WARN_UNUSED
+static bool pop_size(instructionPointer * restrict ip, size_t *width, size_t *height)
+{
+	funge_vector size = stack_pop_vector(ip->stack);
+	if (size.x < 0 || size.y < 0)
+		return false;
+	*width = (size_t)size.x;
+	*height = (size_t)size.y;
+	// Both the doubles and a row of cells must fit in memory.
+	if (*width > SIZE_MAX / 2 / sizeof(funge_cell))
+		return false;
+	if (*height && *width > SIZE_MAX / sizeof(double) / *height)
+		return false;
+	return true;
+}
+
+/// Make sure rowBuffer has room for a row of width doubles.
+FUNGE_ATTR_FAST FUNGE_ATTR_WARN_UNUSED
+static bool reserve_row(size_t width)
+{
+	if (rowBufferSize < 2 * width) {
+		funge_cell *newBuffer = realloc(rowBuffer, 2 * width * sizeof(funge_cell));
+		if (!newBuffer)
+			return false;
+		rowBuffer = newBuffer;
+		rowBufferSize = 2 * width;
+	}
+	return true;
+}
+
+/**
+ * Read an array from Funge-Space.
+ * @return A malloc()ed array of width * height doubles, or NULL if out of
+ * memory.
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_MALLOC FUNGE_ATTR_WARN_UNUSED
+static double *read_array(const funge_vector * restrict pos, size_t width, size_t height)
+{
+	double *values;
+	if (!reserve_row(width))
+		return NULL;
+	values = malloc(width * height * sizeof(double));
+	if (!values)
+		return NULL;
+	for (size_t y = 0; y < height; y++) {
+		double *row = values + y * width;
+		fungespace_get_row(rowBuffer,
+		                   vector_create_ref(pos->x, (funge_cell)((funge_unsigned_cell)pos->y + y)),
+		                   2 * width);
+		for (size_t x = 0; x < width; x++) {
+			doubleint u;
+			u.i.high = (int32_t)rowBuffer[2 * x];
+			u.i.low = (int32_t)rowBuffer[2 * x + 1];
+			row[x] = u.d;
+		}
+	}
+	return values;
+}
+
+/// Write an array to Funge-Space. Must be called after read_array() or
+/// reserve_row() for the same width.
+FUNGE_ATTR_FAST
+static void write_array(const funge_vector * restrict pos, size_t width, size_t height,
+                        const double * restrict values)
+{
+	for (size_t y = 0; y < height; y++) {
+		const double *row = values + y * width;
+		for (size_t x = 0; x < width; x++) {
+			doubleint u;
+			u.d = row[x];
+			rowBuffer[2 * x] = u.i.high;
+			rowBuffer[2 * x + 1] = u.i.low;
+		}
+		fungespace_set_row(rowBuffer,
+		                   vector_create_ref(pos->x, (funge_cell)((funge_unsigned_cell)pos->y + y)),
+		                   2 * width);
+	}
+}
+
+
+/*****************
+ * Instructions. *
+ *****************/
+
+/// Elementwise operation on two arrays (dst src1 src2 size --).
+FUNGE_ATTR_FAST
+static void binary_op(instructionPointer * ip, fpar_binary_op op)
+{
+	size_t width, height;
+	bool valid = pop_size(ip, &width, &height);
+	funge_vector src2 = pop_position(ip);
+	funge_vector src1 = pop_position(ip);
+	funge_vector dst = pop_position(ip);
+	double *a, *b;
+
+	if (!valid) {
+		ip_reverse(ip);
+		return;
+	}
+	if (!width || !height)
+		return;
+	a = read_array(&src1, width, height);
+	b = read_array(&src2, width, height);
+	if (!a || !b) {
+		free(a);
+		free(b);
+		ip_reverse(ip);
+		return;
+	}
+	do_binary(op, a, a, b, width * height);
+	write_array(&dst, width, height, a);
+	free(a);
+	free(b);
+}
+
+/// Elementwise operation on one array (dst src size --), k is only used by
+/// FPAR_SCALE.
+FUNGE_ATTR_FAST
+static void unary_op(instructionPointer * ip, fpar_unary_op op, double k, bool valid)
+{
+	size_t width, height;
+	funge_vector src, dst;
+	double *a;
+
+	valid = pop_size(ip, &width, &height) && valid;
+	src = pop_position(ip);
+	dst = pop_position(ip);
+	if (!valid) {
+		ip_reverse(ip);
+		return;
+	}
+	if (!width || !height)
+		return;
+	a = read_array(&src, width, height);
+	if (!a) {
+		ip_reverse(ip);
+		return;
+	}
+	do_unary(op, a, a, width * height, k);
+	write_array(&dst, width, height, a);
+	free(a);
+}
+
+/// Reduce an array (src size -- result). If dot is true the dot product of
+/// two arrays is pushed instead (src1 src2 size -- result).
+FUNGE_ATTR_FAST
+static void reduce_op(instructionPointer * ip, bool dot, bool minmax, bool max)
+{
+	size_t width, height;
+	bool valid = pop_size(ip, &width, &height);
+	funge_vector src2 = pop_position(ip);
+	funge_vector src1 = dot ? pop_position(ip) : src2;
+	double *a, *b = NULL;
+	double result;
+
+	if (!valid || (minmax && (!width || !height))) {
+		ip_reverse(ip);
+		return;
+	}
+	if (!width || !height) {
+		push_double(ip, 0.0);
+		return;
+	}
+	a = read_array(&src1, width, height);
+	if (dot)
+		b = read_array(&src2, width, height);
+	if (!a || (dot && !b)) {
+		free(a);
+		free(b);
+		ip_reverse(ip);
+		return;
+	}
+	if (minmax)
+		result = do_minmax(max, a, width * height);
+	else
+		result = do_sum(a, b, width * height);
+	free(a);
+	free(b);
+	push_double(ip, result);
+}
+
+/// A - Add arrays
+static void finger_FPAR_add(instructionPointer * ip)
+{
+	binary_op(ip, FPAR_ADD);
+}
+
+/// B - Absolute value of array
+static void finger_FPAR_abs(instructionPointer * ip)
+{
+	unary_op(ip, FPAR_ABS, 0.0, true);
+}
+
+/// C - Cosine of array
+static void finger_FPAR_cos(instructionPointer * ip)
+{
+	unary_op(ip, FPAR_COS, 0.0, true);
+}
+
+/// D - Divide arrays
+static void finger_FPAR_div(instructionPointer * ip)
+{
+	binary_op(ip, FPAR_DIV);
+}
+
+/// E - Exponential of array
+static void finger_FPAR_exp(instructionPointer * ip)
+{
+	unary_op(ip, FPAR_EXP, 0.0, true);
+}
+
+/// F - Fill array with value
+static void finger_FPAR_fill(instructionPointer * ip)
+{
+	double value = pop_double(ip);
+	size_t width, height;
+	bool valid = pop_size(ip, &width, &height);
+	funge_vector dst = pop_position(ip);
+	double *a;
+
+	if (!valid) {
+		ip_reverse(ip);
+		return;
+	}
+	if (!width || !height)
+		return;
+	a = malloc(width * height * sizeof(double));
+	if (!a || !reserve_row(width)) {
+		free(a);
+		ip_reverse(ip);
+		return;
+	}
+	for (size_t i = 0; i < width * height; i++)
+		a[i] = value;
+	write_array(&dst, width, height, a);
+	free(a);
+}
+
+/// I - Sine of array
+static void finger_FPAR_sin(instructionPointer * ip)
+{
+	unary_op(ip, FPAR_SIN, 0.0, true);
+}
+
+/// K - Multiply array by value
+static void finger_FPAR_scale(instructionPointer * ip)
+{
+	double k = pop_double(ip);
+	unary_op(ip, FPAR_SCALE, k, true);
+}
+
+/// L - Natural logarithm of array
+static void finger_FPAR_log(instructionPointer * ip)
+{
+	unary_op(ip, FPAR_LOG, 0.0, true);
+}
+
+/// M - Multiply arrays
+static void finger_FPAR_mul(instructionPointer * ip)
+{
+	binary_op(ip, FPAR_MUL);
+}
+
+/// N - Negate array
+static void finger_FPAR_neg(instructionPointer * ip)
+{
+	unary_op(ip, FPAR_NEG, 0.0, true);
+}
+
+/// P - Push dot product of arrays
+static void finger_FPAR_dot(instructionPointer * ip)
+{
+	reduce_op(ip, true, false, false);
+}
+
+/// Q - Square root of array
+static void finger_FPAR_sqrt(instructionPointer * ip)
+{
+	unary_op(ip, FPAR_SQRT, 0.0, true);
+}
+
+/// S - Subtract arrays
+static void finger_FPAR_sub(instructionPointer * ip)
+{
+	binary_op(ip, FPAR_SUB);
+}
+
+/// U - Push sum of array
+static void finger_FPAR_sum(instructionPointer * ip)
+{
+	reduce_op(ip, false, false, false);
+}
+
+/// X - Push maximum of array
+static void finger_FPAR_max(instructionPointer * ip)
+{
+	reduce_op(ip, false, true, true);
+}
+
+/// Y - Push minimum of array
+static void finger_FPAR_min(instructionPointer * ip)
+{
+	reduce_op(ip, false, true, false);
+}
+
+bool finger_FPAR_load(instructionPointer * ip)
+{
+#ifdef FPAR_AVX2
+	__builtin_cpu_init();
+	useAVX2 = __builtin_cpu_supports("avx2");
+#endif
+	manager_add_opcode(FPAR, 'A', add);
+	manager_add_opcode(FPAR, 'B', abs);
+	manager_add_opcode(FPAR, 'C', cos);
+	manager_add_opcode(FPAR, 'D', div);
+	manager_add_opcode(FPAR, 'E', exp);
+	manager_add_opcode(FPAR, 'F', fill);
+	manager_add_opcode(FPAR, 'I', sin);
+	manager_add_opcode(FPAR, 'K', scale);
+	manager_add_opcode(FPAR, 'L', log);
+	manager_add_opcode(FPAR, 'M', mul);
+	manager_add_opcode(FPAR, 'N', neg);
+	manager_add_opcode(FPAR, 'P', dot);
+	manager_add_opcode(FPAR, 'Q', sqrt);
+	manager_add_opcode(FPAR, 'S', sub);
+	manager_add_opcode(FPAR, 'U', sum);
+	manager_add_opcode(FPAR, 'X', max);
+	manager_add_opcode(FPAR, 'Y', min);
+	return true;
+}
+#endif /* !defined(CFUN_NO_FLOATS) */
@@ -22,6 +22,7 @@
 #include "FPDP.h"
 
 #if !defined(CFUN_NO_FLOATS)
+#include "../../output.h"
 #include "../../stack.h"
 
 #include <math.h>
@@ -209,21 +210,20 @@ static void finger_FPDP_toint(instructionPointer * ip)
 
 static void finger_FPDP_fromascii(instructionPointer * ip)
 {
-	char * restrict str;
-	str = (char*)stack_pop_string(ip->stack, NULL);
+	const char * restrict str;
+	str = (const char*)stack_pop_string_scratch(ip->stack, NULL);
 	if (FUNGE_UNLIKELY(!str)) {
 		ip_reverse(ip);
 		return;
 	}
 	u.d = strtod(str, NULL);
 	pushDbl(ip);
-	stack_free_string(str);
 }
 
 static void finger_FPDP_print(instructionPointer * ip)
 {
 	popDbl(ip);
-	printf("%f ", u.d);
+	output_printf("%f ", u.d);
 }
 
 bool finger_FPDP_load(instructionPointer * ip)
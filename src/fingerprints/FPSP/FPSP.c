@@ -22,6 +22,7 @@
 #include "FPSP.h"
 
 #if !defined(CFUN_NO_FLOATS)
+#include "../../output.h"
 #include "../../stack.h"
 
 #include <math.h>
@@ -209,23 +210,22 @@ static void finger_FPSP_toint(instructionPointer * ip)
 
 static void finger_FPSP_fromascii(instructionPointer * ip)
 {
-	char * restrict str;
+	const char * restrict str;
 	floatint a;
-	str = (char*)stack_pop_string(ip->stack, NULL);
+	str = (const char*)stack_pop_string_scratch(ip->stack, NULL);
 	if (FUNGE_UNLIKELY(!str)) {
 		ip_reverse(ip);
 		return;
 	}
 	a.f = strtof(str, NULL);
 	stack_push(ip->stack, a.i);
-	stack_free_string(str);
 }
 
 static void finger_FPSP_print(instructionPointer * ip)
 {
 	floatint a;
 	a.i = (int32_t)stack_pop(ip->stack);
-	printf("%f ", a.f);
+	output_printf("%f ", (double)a.f);
 }
 
 bool finger_FPSP_load(instructionPointer * ip)
@@ -35,36 +35,19 @@ static void finger_FRTH_stack_size(instructionPointer * ip)
 /// L - Forth Roll command
 static void finger_FRTH_forth_roll(instructionPointer * ip)
 {
-	// FIXME: Move most of this functionality into stack.c
 	funge_cell u;
-	size_t s;
 	u = stack_pop(ip->stack);
 	if (u < 0) {
 		ip_reverse(ip);
 		return;
 	}
-	s = ip->stack->top;
 
-	if (u >= (funge_cell)s) {
+	if (u >= (funge_cell)ip->stack->top) {
 		stack_push(ip->stack, 0);
 	} else {
-		funge_cell * restrict elems;
 		funge_cell xu;
-
-		elems = malloc(sizeof(funge_cell) * ip->stack->top);
-		if (!elems) {
-			ip_reverse(ip);
-			return;
-		}
-		memcpy(elems, ip->stack->entries, sizeof(funge_cell) * ip->stack->top);
-		xu = elems[s - (u + 1)];
-
-		stack_discard(ip->stack, (size_t)(u + 1));
-		for (size_t i = s - (size_t)u; i < s; i++) {
-			stack_push(ip->stack, elems[i]);
-		}
+		stack_remove(ip->stack, (size_t)u, &xu, 1);
 		stack_push(ip->stack, xu);
-		free(elems);
 	}
 }
 
@@ -0,0 +1,16 @@
+%fingerprint-spec 1.4
+%fprint:HMAP
+%url:https://github.com/VorpalBlade/cfunge
+%desc:cfunge hash maps from cells to cells
+%safe:true
+%begin-instrs
+#I Name              Desc
+D  delete            Remove key from map
+F  free              Free a map
+G  get               Get value of key
+H  has               Check if map contains key
+I  iterate           Get entry at iteration cursor
+L  size              Push number of entries in map
+N  new               Create a new map
+S  set               Set value of key
+%end
@@ -0,0 +1,377 @@
+/* -*- mode: C; coding: utf-8; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*-
+ *
+ * cfunge - A standard-conforming Befunge93/98/109 interpreter in C.
+ * Copyright (C) 2008-2013 Arvid Norlander <VorpalBlade AT users.noreply.github.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at the proxy's option) any later version. Arvid Norlander is a
+ * proxy who can decide which future versions of the GNU General Public
+ * License can be used.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "HMAP.h"
+#include "../../stack.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Each map is an open addressing hash table with linear probing. Deleting
+ * moves later entries of the probe sequence back instead of leaving
+ * tombstones, so lookups never get slower because of deletes.
+ */
+
+/// Initial number of slots in a map, must be a power of two.
+#define HMAP_INITIAL_SIZE 16
+/// How many handles to allocate in one go.
+#define ALLOCCHUNK 4
+
+typedef struct hmap_entry {
+	funge_cell key;
+	funge_cell value;
+} hmap_entry;
+
+typedef struct FungeHashMap {
+	hmap_entry *entries;
+	bool       *used;     ///< If the slot with the same index is in use.
+	size_t      size;     ///< Number of slots, a power of two.
+	size_t      count;    ///< Number of slots in use.
+	unsigned    shift;    ///< 64 - log2(size), used by hmap_slot().
+} FungeHashMap;
+
+// Array of pointers
+static FungeHashMap** maps = NULL;
+static funge_cell maxHandle = 0;
+
+
+/**************
+ * Hash maps. *
+ **************/
+
+/// Home slot of a key (Fibonacci hashing).
+FUNGE_ATTR_FAST FUNGE_ATTR_PURE FUNGE_ATTR_WARN_UNUSED
+static inline size_t hmap_slot(const FungeHashMap * map, funge_cell key)
+{
+	return (size_t)(((uint64_t)(funge_unsigned_cell)key * UINT64_C(0x9E3779B97F4A7C15)) >> map->shift);
+}
+
+/// Allocate the slots of a map.
+FUNGE_ATTR_FAST FUNGE_ATTR_WARN_UNUSED
+static bool hmap_alloc(FungeHashMap * map, size_t size)
+{
+	unsigned bits = 0;
+	map->entries = malloc(size * sizeof(hmap_entry));
+	map->used = calloc(size, sizeof(bool));
+	if (!map->entries || !map->used) {
+		free(map->entries);
+		free(map->used);
+		return false;
+	}
+	while (((size_t)1 << bits) < size)
+		bits++;
+	map->size = size;
+	map->count = 0;
+	map->shift = 64 - bits;
+	return true;
+}
+
+/// Find the slot of key, or the free slot where it would be inserted.
+FUNGE_ATTR_FAST FUNGE_ATTR_PURE FUNGE_ATTR_WARN_UNUSED
+static inline size_t hmap_find(const FungeHashMap * map, funge_cell key)
+{
+	const size_t mask = map->size - 1;
+	size_t i = hmap_slot(map, key);
+	while (map->used[i] && map->entries[i].key != key)
+		i = (i + 1) & mask;
+	return i;
+}
+
+/// Double the number of slots.
+FUNGE_ATTR_FAST FUNGE_ATTR_WARN_UNUSED
+static bool hmap_grow(FungeHashMap * map)
+{
+	FungeHashMap old = *map;
+	if (!hmap_alloc(map, old.size * 2)) {
+		*map = old;
+		return false;
+	}
+	for (size_t i = 0; i < old.size; i++) {
+		if (old.used[i]) {
+			size_t slot = hmap_find(map, old.entries[i].key);
+			map->entries[slot] = old.entries[i];
+			map->used[slot] = true;
+		}
+	}
+	map->count = old.count;
+	free(old.entries);
+	free(old.used);
+	return true;
+}
+
+/// Insert or replace a value, returns false if out of memory.
+FUNGE_ATTR_FAST FUNGE_ATTR_WARN_UNUSED
+static bool hmap_set(FungeHashMap * map, funge_cell key, funge_cell value)
+{
+	size_t slot = hmap_find(map, key);
+	if (!map->used[slot]) {
+		// Keep the load factor at most 3/4.
+		if ((map->count + 1) * 4 > map->size * 3) {
+			if (!hmap_grow(map))
+				return false;
+			slot = hmap_find(map, key);
+		}
+		map->used[slot] = true;
+		map->entries[slot].key = key;
+		map->count++;
+	}
+	map->entries[slot].value = value;
+	return true;
+}
+
+/// Remove the entry in a slot that is in use.
+FUNGE_ATTR_FAST
+static void hmap_remove_slot(FungeHashMap * map, size_t slot)
+{
+	const size_t mask = map->size - 1;
+	size_t next = slot;
+	// Move back later entries of the probe sequence that would no longer be
+	// found once there is a hole at slot.
+	while (true) {
+		size_t home;
+		next = (next + 1) & mask;
+		if (!map->used[next])
+			break;
+		home = hmap_slot(map, map->entries[next].key);
+		// Can the entry at next be moved to slot? Only if its home slot is
+		// not cyclically in (slot, next].
+		if (((next - home) & mask) >= ((next - slot) & mask)) {
+			map->entries[slot] = map->entries[next];
+			slot = next;
+		}
+	}
+	map->used[slot] = false;
+	map->count--;
+}
+
+
+/********************
+ * Handle handling. *
+ ********************/
+
+/// Used by allocate_handle() below to find next free handle.
+FUNGE_ATTR_FAST FUNGE_ATTR_WARN_UNUSED
+static inline funge_cell find_next_free_handle(void)
+{
+	for (funge_cell i = 0; i < maxHandle; i++) {
+		if (maps[i] == NULL)
+			return i;
+	}
+	// No free one, extend array..
+	{
+		FungeHashMap** newlist = (FungeHashMap**)realloc(maps, (size_t)(maxHandle + ALLOCCHUNK) * sizeof(FungeHashMap*));
+		if (!newlist)
+			return -1;
+		maps = newlist;
+		for (funge_cell i = maxHandle; i < (maxHandle + ALLOCCHUNK); i++)
+			maps[i] = NULL;
+		maxHandle += ALLOCCHUNK;
+		return (maxHandle - ALLOCCHUNK);
+	}
+}
+
+/// Get a new handle to use for a map, also allocates the map.
+/// @return Handle, or -1 on failure
+FUNGE_ATTR_FAST FUNGE_ATTR_WARN_UNUSED
+static inline funge_cell allocate_handle(void)
+{
+	funge_cell h;
+
+	h = find_next_free_handle();
+	if (h < 0)
+		return -1;
+
+	maps[h] = malloc(sizeof(FungeHashMap));
+	if (!maps[h])
+		return -1;
+	if (!hmap_alloc(maps[h], HMAP_INITIAL_SIZE)) {
+		free(maps[h]);
+		maps[h] = NULL;
+		return -1;
+	}
+	return h;
+}
+
+/// Free a handle and the map.
+FUNGE_ATTR_FAST
+static inline void free_handle(funge_cell h)
+{
+	if (!maps[h])
+		return;
+	free(maps[h]->entries);
+	free(maps[h]->used);
+	free(maps[h]);
+	maps[h] = NULL;
+}
+
+/// Checks if handle is valid.
+FUNGE_ATTR_FAST FUNGE_ATTR_WARN_UNUSED
+static inline bool valid_handle(funge_cell h)
+{
+	if ((h < 0) || (h >= maxHandle) || (!maps[h])) {
+		return false;
+	} else {
+		return true;
+	}
+}
+
+
+/*****************
+ * Instructions. *
+ *****************/
+
+/// D - Remove key from map
+static void finger_HMAP_delete(instructionPointer * ip)
+{
+	funge_cell key = stack_pop(ip->stack);
+	funge_cell h = stack_pop(ip->stack);
+	size_t slot;
+
+	if (!valid_handle(h)) {
+		ip_reverse(ip);
+		return;
+	}
+	slot = hmap_find(maps[h], key);
+	if (!maps[h]->used[slot]) {
+		ip_reverse(ip);
+		return;
+	}
+	hmap_remove_slot(maps[h], slot);
+}
+
+/// F - Free a map
+static void finger_HMAP_free(instructionPointer * ip)
+{
+	funge_cell h = stack_pop(ip->stack);
+
+	if (!valid_handle(h)) {
+		ip_reverse(ip);
+		return;
+	}
+	free_handle(h);
+}
+
+/// G - Get value of key
+static void finger_HMAP_get(instructionPointer * ip)
+{
+	funge_cell key = stack_pop(ip->stack);
+	funge_cell h = stack_pop(ip->stack);
+	size_t slot;
+
+	if (!valid_handle(h)) {
+		ip_reverse(ip);
+		return;
+	}
+	slot = hmap_find(maps[h], key);
+	if (!maps[h]->used[slot]) {
+		ip_reverse(ip);
+		return;
+	}
+	stack_push(ip->stack, maps[h]->entries[slot].value);
+}
+
+/// H - Check if map contains key
+static void finger_HMAP_has(instructionPointer * ip)
+{
+	funge_cell key = stack_pop(ip->stack);
+	funge_cell h = stack_pop(ip->stack);
+
+	if (!valid_handle(h)) {
+		ip_reverse(ip);
+		return;
+	}
+	stack_push(ip->stack, maps[h]->used[hmap_find(maps[h], key)] ? 1 : 0);
+}
+
+/// I - Get entry at iteration cursor
+static void finger_HMAP_iterate(instructionPointer * ip)
+{
+	funge_cell cursor = stack_pop(ip->stack);
+	funge_cell h = stack_pop(ip->stack);
+	const FungeHashMap * map;
+
+	if (!valid_handle(h) || cursor < 0) {
+		ip_reverse(ip);
+		return;
+	}
+	map = maps[h];
+	// The cursor is the slot to continue the search from.
+	for (size_t i = (size_t)cursor; i < map->size; i++) {
+		if (map->used[i]) {
+			stack_push(ip->stack, (funge_cell)(i + 1));
+			stack_push(ip->stack, map->entries[i].key);
+			stack_push(ip->stack, map->entries[i].value);
+			return;
+		}
+	}
+	ip_reverse(ip);
+}
+
+/// L - Push number of entries in map
+static void finger_HMAP_size(instructionPointer * ip)
+{
+	funge_cell h = stack_pop(ip->stack);
+
+	if (!valid_handle(h)) {
+		ip_reverse(ip);
+		return;
+	}
+	stack_push(ip->stack, (funge_cell)maps[h]->count);
+}
+
+/// N - Create a new map
+static void finger_HMAP_new(instructionPointer * ip)
+{
+	funge_cell h = allocate_handle();
+
+	if (h == -1) {
+		ip_reverse(ip);
+		return;
+	}
+	stack_push(ip->stack, h);
+}
+
+/// S - Set value of key
+static void finger_HMAP_set(instructionPointer * ip)
+{
+	funge_cell value = stack_pop(ip->stack);
+	funge_cell key = stack_pop(ip->stack);
+	funge_cell h = stack_pop(ip->stack);
+
+	if (!valid_handle(h) || !hmap_set(maps[h], key, value))
+		ip_reverse(ip);
+}
+
+bool finger_HMAP_load(instructionPointer * ip)
+{
+	manager_add_opcode(HMAP, 'D', delete);
+	manager_add_opcode(HMAP, 'F', free);
+	manager_add_opcode(HMAP, 'G', get);
+	manager_add_opcode(HMAP, 'H', has);
+	manager_add_opcode(HMAP, 'I', iterate);
+	manager_add_opcode(HMAP, 'L', size);
+	manager_add_opcode(HMAP, 'N', new);
+	manager_add_opcode(HMAP, 'S', set);
+	return true;
+}
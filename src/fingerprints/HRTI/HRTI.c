@@ -20,6 +20,7 @@
  */
 
 #include "HRTI.h"
+#include "../../replay.h"
 #include "../../stack.h"
 
 #include <stdint.h>
@@ -86,6 +87,16 @@ typedef suseconds_t res_type;
 /// The resolution.
 static res_type resolution = 0;
 
+/// Read the timer. Goes through the replay log, so replayed runs see the
+/// same times.
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL
+static inline void get_time(timetype * restrict t)
+{
+	TIMERFUNC(t);
+	t->tv_sec = (time_t)replay_value(replay_event_clock, (int64_t)t->tv_sec);
+	SMALL_P(t) = (res_type)replay_value(replay_event_clock, (int64_t)SMALL_P(t));
+}
+
 FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL FUNGE_ATTR_PURE FUNGE_ATTR_WARN_UNUSED
 static inline funge_cell get_difference(const timetype * restrict before,
                                         const timetype * restrict after)
@@ -132,7 +143,7 @@ static void finger_HRTI_mark(instructionPointer * ip)
 		return;
 	}
 
-	TIMERFUNC(ip->fingerHRTItimestamp);
+	get_time(ip->fingerHRTItimestamp);
 }
 
 /// T - Timer
@@ -142,7 +153,7 @@ static void finger_HRTI_timer(instructionPointer * ip)
 		ip_reverse(ip);
 	} else {
 		timetype curTime;
-		TIMERFUNC(&curTime);
+		get_time(&curTime);
 		stack_push(ip->stack, get_difference(ip->fingerHRTItimestamp, &curTime));
 	}
 }
@@ -151,7 +162,7 @@ static void finger_HRTI_timer(instructionPointer * ip)
 static void finger_HRTI_second(instructionPointer * ip)
 {
 	timetype curTime;
-	TIMERFUNC(&curTime);
+	get_time(&curTime);
 	stack_push(ip->stack, (funge_cell)MSEC_P(&curTime));
 }
 
@@ -162,9 +173,9 @@ FUNGE_ATTR_FAST static inline bool setup_HRTI(instructionPointer * ip)
 		timetype before;
 		timetype after;
 
-		TIMERFUNC(&before);
+		get_time(&before);
 		do {
-			TIMERFUNC(&after);
+			get_time(&after);
 			resolution = SECONDS_MUTIPLIER * (after.tv_sec - before.tv_sec) + SMALL_P(&after) - SMALL_P(&before);
 		} while (resolution < MICRO_TO_SMALL);
 	}
@@ -23,6 +23,7 @@
 #include "../../rect.h"
 #include "../../stack.h"
 #include "../../interpreter.h"
+#include "../../output.h"
 #include "../../funge-space/funge-space.h"
 
 #include <stdio.h> /* fputs */
@@ -74,14 +75,12 @@ static void finger_ORTH_put(instructionPointer * ip)
 // output string
 static void finger_ORTH_output_string(instructionPointer * ip)
 {
-	char * restrict str = (char*)stack_pop_string(ip->stack, NULL);
+	const char * restrict str = (const char*)stack_pop_string_scratch(ip->stack, NULL);
 	if (FUNGE_UNLIKELY(!str)) {
 		ip_reverse(ip);
 		return;
 	}
-	// puts add newline, we therefore do fputs on stdout
-	fputs(str, stdout);
-	stack_free_string(str);
+	output_string(str);
 }
 
 // change dx
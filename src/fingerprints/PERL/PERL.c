@@ -194,14 +194,13 @@ static void finger_PERL_eval(instructionPointer * ip)
 {
 	size_t length;
 	char * restrict result;
-	char * restrict perlcode = (char*)stack_pop_string(ip->stack, NULL);
+	const char * restrict perlcode = (const char*)stack_pop_string_scratch(ip->stack, NULL);
 	result = run_perl(perlcode, &length);
 	if (result == NULL) {
 		ip_reverse(ip);
 	} else {
 		stack_push_string(ip->stack, (unsigned char*)result, length);
 	}
-	stack_free_string(perlcode);
 	free(result);
 }
 
@@ -209,7 +208,7 @@ static void finger_PERL_eval(instructionPointer * ip)
 static void finger_PERL_int_eval(instructionPointer * ip)
 {
 	char * restrict result;
-	char * restrict perlcode = (char*)stack_pop_string(ip->stack, NULL);
+	const char * restrict perlcode = (const char*)stack_pop_string_scratch(ip->stack, NULL);
 	result = run_perl(perlcode, NULL);
 	if (result == NULL) {
 		ip_reverse(ip);
@@ -222,7 +221,6 @@ static void finger_PERL_int_eval(instructionPointer * ip)
 		else
 			stack_push(ip->stack, (funge_cell)i);
 	}
-	stack_free_string(perlcode);
 	free(result);
 }
 
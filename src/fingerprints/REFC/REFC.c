@@ -22,10 +22,30 @@
 #include "REFC.h"
 #include "../../stack.h"
 #include "../../vector.h"
+#ifdef CFUN_REFC_RECLAIM
+#  include "../../interpreter.h"
+#endif
 
 #include <assert.h>
+#include <stdint.h>
+
+/*
+ * References are stored in an array indexed by the reference, with an open
+ * addressing hash table from vector to reference on the side, so that R
+ * returns the same reference for the same vector each time. Both grow
+ * geometrically.
+ *
+ * If CFUN_REFC_RECLAIM is defined, references that are not on any stack of
+ * any IP are reused. This is done in generations: references created since
+ * the last collection are young and freed at the next collection unless they
+ * are on a stack, then they become old. Old references are only checked when
+ * the number of them has doubled since that was last done. Note that this
+ * means a reference kept only in Funge-Space may be reused!
+ */
+
+/// Initial size of the array of references and of the hash table.
+#define INITIAL_SIZE 16
 
-#define ALLOCCHUNK 5
 // Array holding references.
 static funge_vector *references = NULL;
 // Top index used in array.
@@ -33,27 +53,237 @@ static size_t referencesTop = 0;
 // Size of array (including allocated but not yet used elements).
 static size_t referencesSize = 0;
 
-static void finger_REFC_reference(instructionPointer * ip)
+// Hash table from vector to reference, 0 is a free slot.
+static size_t *refIndex = NULL;
+// Number of slots in refIndex, a power of two.
+static size_t refIndexSize = 0;
+// 64 - log2(refIndexSize).
+static unsigned refIndexShift = 0;
+
+#ifdef CFUN_REFC_RECLAIM
+/// Minimum number of young references before there is a collection.
+#  define RECLAIM_MIN_YOUNG 1024
+
+enum {
+	REFC_FREE   = 0,
+	REFC_YOUNG  = 1,
+	REFC_OLD    = 2,
+	REFC_MARKED = 4
+};
+
+// State of each reference, one of the values above.
+static unsigned char *referenceState = NULL;
+// Reclaimed references, used as a stack.
+static size_t *freeRefs = NULL;
+static size_t freeRefsTop = 0;
+// Number of young and old references.
+static size_t youngCount = 0;
+static size_t oldCount = 0;
+// Number of old references after the last collection that checked them.
+static size_t oldCountChecked = 0;
+#endif
+
+
+/// Slot in refIndex where the search for a vector starts.
+FUNGE_ATTR_FAST FUNGE_ATTR_PURE FUNGE_ATTR_WARN_UNUSED
+static inline size_t ref_hash(funge_cell x, funge_cell y)
 {
-	funge_cell x, y;
-	y = stack_pop(ip->stack);
-	x = stack_pop(ip->stack);
-	if (referencesSize == referencesTop + 1) {
-		funge_vector * newrefs = (funge_vector*)realloc(references, (referencesSize + ALLOCCHUNK) * sizeof(funge_vector));
-		if (newrefs == NULL) {
-			ip_reverse(ip);
-			return;
+	uint64_t h = (uint64_t)(funge_unsigned_cell)x * UINT64_C(0x9E3779B97F4A7C15);
+	h ^= (uint64_t)(funge_unsigned_cell)y;
+	return (size_t)((h * UINT64_C(0xC2B2AE3D27D4EB4F)) >> refIndexShift);
+}
+
+/// Find the slot for a vector, either holding its reference or free.
+FUNGE_ATTR_FAST FUNGE_ATTR_PURE FUNGE_ATTR_WARN_UNUSED
+static inline size_t ref_find(funge_cell x, funge_cell y)
+{
+	const size_t mask = refIndexSize - 1;
+	size_t i = ref_hash(x, y);
+	while (refIndex[i]) {
+		const funge_vector *v = &references[refIndex[i]];
+		if (v->x == x && v->y == y)
+			break;
+		i = (i + 1) & mask;
+	}
+	return i;
+}
+
+/// Allocate a hash table with size slots and insert all references.
+FUNGE_ATTR_FAST FUNGE_ATTR_WARN_UNUSED
+static bool ref_index_rebuild(size_t size)
+{
+	size_t *newIndex = (size_t*)calloc(size, sizeof(size_t));
+	unsigned bits = 0;
+	if (!newIndex)
+		return false;
+	free(refIndex);
+	refIndex = newIndex;
+	while (((size_t)1 << bits) < size)
+		bits++;
+	refIndexSize = size;
+	refIndexShift = 64 - bits;
+	for (size_t i = 1; i <= referencesTop; i++) {
+#ifdef CFUN_REFC_RECLAIM
+		if (referenceState[i] == REFC_FREE)
+			continue;
+#endif
+		refIndex[ref_find(references[i].x, references[i].y)] = i;
+	}
+	return true;
+}
+
+#ifdef CFUN_REFC_RECLAIM
+/// Remove a reference from refIndex, moving back later entries of the probe
+/// sequence so no tombstones are needed.
+FUNGE_ATTR_FAST
+static void ref_index_remove(size_t ref)
+{
+	const size_t mask = refIndexSize - 1;
+	size_t slot = ref_find(references[ref].x, references[ref].y);
+	size_t next = slot;
+	assert(refIndex[slot] == ref);
+	while (true) {
+		size_t home;
+		next = (next + 1) & mask;
+		if (!refIndex[next])
+			break;
+		home = ref_hash(references[refIndex[next]].x, references[refIndex[next]].y);
+		if (((next - home) & mask) >= ((next - slot) & mask)) {
+			refIndex[slot] = refIndex[next];
+			slot = next;
+		}
+	}
+	refIndex[slot] = 0;
+}
+
+/// Mark all references on the stacks of an IP.
+FUNGE_ATTR_FAST
+static void mark_ip(instructionPointer * ip)
+{
+	const funge_stackstack *stackStack = ip->stackstack;
+	for (size_t s = 0; s <= stackStack->current; s++) {
+		const funge_stack *stack = stackStack->stacks[s];
+		for (size_t i = 0; i < stack->top; i++) {
+			funge_cell value = stack->entries[i];
+			if (value > 0 && (size_t)value <= referencesTop && referenceState[value] != REFC_FREE)
+				referenceState[value] |= REFC_MARKED;
 		}
-		references = newrefs;
-		referencesSize += ALLOCCHUNK;
 	}
-	// TODO: Return same value for the same cell each time!
+}
+
+/// Free the references that are not on any stack. Young references are
+/// always checked, old ones only if checkOld is true.
+FUNGE_ATTR_FAST
+static void collect(bool checkOld)
+{
+	interpreter_foreach_ip(mark_ip);
+	for (size_t i = 1; i <= referencesTop; i++) {
+		unsigned char state = referenceState[i];
+		if (state == REFC_FREE)
+			continue;
+		if (state & REFC_MARKED) {
+			if ((state & ~REFC_MARKED) == REFC_YOUNG) {
+				youngCount--;
+				oldCount++;
+			}
+			referenceState[i] = REFC_OLD;
+		} else if (state == REFC_YOUNG || checkOld) {
+			if (state == REFC_YOUNG)
+				youngCount--;
+			else
+				oldCount--;
+			ref_index_remove(i);
+			referenceState[i] = REFC_FREE;
+			freeRefs[freeRefsTop++] = i;
+		}
+	}
+	if (checkOld)
+		oldCountChecked = oldCount;
+}
+#endif
+
+/// Make room for one more reference in the array.
+FUNGE_ATTR_FAST FUNGE_ATTR_WARN_UNUSED
+static bool grow_references(void)
+{
+	size_t newSize = referencesSize * 2;
+	funge_vector * newrefs = (funge_vector*)realloc(references, newSize * sizeof(funge_vector));
+	if (newrefs == NULL)
+		return false;
+	references = newrefs;
+#ifdef CFUN_REFC_RECLAIM
+	{
+		unsigned char *newState = (unsigned char*)realloc(referenceState, newSize);
+		size_t *newFree;
+		if (newState == NULL)
+			return false;
+		referenceState = newState;
+		newFree = (size_t*)realloc(freeRefs, newSize * sizeof(size_t));
+		if (newFree == NULL)
+			return false;
+		freeRefs = newFree;
+	}
+#endif
+	referencesSize = newSize;
+	return true;
+}
+
+/// Get an unused reference number.
+/// @return The reference, or 0 if out of memory.
+FUNGE_ATTR_FAST FUNGE_ATTR_WARN_UNUSED
+static size_t allocate_reference(void)
+{
+#ifdef CFUN_REFC_RECLAIM
+	// Only collect when a quarter of the references are young, so that the
+	// time spent scanning is proportional to the number of references made.
+	if (!freeRefsTop && referencesSize == referencesTop + 1
+	    && youngCount >= RECLAIM_MIN_YOUNG && youngCount >= referencesTop / 4)
+		collect(oldCount >= 2 * oldCountChecked);
+	if (freeRefsTop) {
+		size_t ref = freeRefs[--freeRefsTop];
+		referenceState[ref] = REFC_YOUNG;
+		youngCount++;
+		return ref;
+	}
+#endif
+	if (referencesSize == referencesTop + 1)
+		if (!grow_references())
+			return 0;
+	// Keep the hash table at most half full.
+	if ((referencesTop + 1) * 2 > refIndexSize)
+		if (!ref_index_rebuild(refIndexSize * 2))
+			return 0;
 	// Yes cell 0 will never be used, but that is a hack to prevent having
 	// errors on someone doing 0D before they do any R.
 	referencesTop++;
-	references[referencesTop].x = x;
-	references[referencesTop].y = y;
-	stack_push(ip->stack, (funge_cell)referencesTop);
+#ifdef CFUN_REFC_RECLAIM
+	referenceState[referencesTop] = REFC_YOUNG;
+	youngCount++;
+#endif
+	return referencesTop;
+}
+
+static void finger_REFC_reference(instructionPointer * ip)
+{
+	funge_cell x, y;
+	size_t slot, ref;
+	y = stack_pop(ip->stack);
+	x = stack_pop(ip->stack);
+	slot = ref_find(x, y);
+	if (refIndex[slot]) {
+		stack_push(ip->stack, (funge_cell)refIndex[slot]);
+		return;
+	}
+	ref = allocate_reference();
+	if (!ref) {
+		ip_reverse(ip);
+		return;
+	}
+	references[ref].x = x;
+	references[ref].y = y;
+	// The table may have been rebuilt or changed by a collection.
+	refIndex[ref_find(x, y)] = ref;
+	stack_push(ip->stack, (funge_cell)ref);
 }
 
 static void finger_REFC_dereference(instructionPointer * ip)
@@ -64,17 +294,41 @@ static void finger_REFC_dereference(instructionPointer * ip)
 		ip_reverse(ip);
 		return;
 	}
+#ifdef CFUN_REFC_RECLAIM
+	if (referenceState[ref] == REFC_FREE) {
+		ip_reverse(ip);
+		return;
+	}
+#endif
 	stack_push_vector(ip->stack, &references[ref]);
 }
 
 FUNGE_ATTR_FAST static inline bool init_references(void)
 {
 	assert(!references);
-	references = (funge_vector*)malloc(ALLOCCHUNK * sizeof(funge_vector));
+	references = (funge_vector*)malloc(INITIAL_SIZE * sizeof(funge_vector));
 	if (!references)
 		return false;
-	referencesSize = ALLOCCHUNK;
+#ifdef CFUN_REFC_RECLAIM
+	referenceState = (unsigned char*)calloc(INITIAL_SIZE, 1);
+	freeRefs = (size_t*)malloc(INITIAL_SIZE * sizeof(size_t));
+	if (!referenceState || !freeRefs)
+		goto error;
+#endif
+	referencesSize = INITIAL_SIZE;
+	if (!ref_index_rebuild(INITIAL_SIZE * 2))
+		goto error;
 	return true;
+error:
+	free(references);
+	references = NULL;
+#ifdef CFUN_REFC_RECLAIM
+	free(referenceState);
+	referenceState = NULL;
+	free(freeRefs);
+	freeRefs = NULL;
+#endif
+	return false;
 }
 
 
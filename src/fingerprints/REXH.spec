@@ -0,0 +1,12 @@
+%fingerprint-spec 1.4
+%fprint:REXH
+%url:https://github.com/VorpalBlade/cfunge
+%desc:cfunge handles to compiled regular expressions
+%safe:true
+%begin-instrs
+#I Name              Desc
+C  compile           Compile a regular expression to a handle
+E  execute           Execute regular expression on string
+F  free              Free a handle
+T  test              Check if a string matches
+%end
@@ -0,0 +1,165 @@
+/* -*- mode: C; coding: utf-8; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*-
+ *
+ * cfunge - A standard-conforming Befunge93/98/109 interpreter in C.
+ * Copyright (C) 2008-2013 Arvid Norlander <VorpalBlade AT users.noreply.github.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at the proxy's option) any later version. Arvid Norlander is a
+ * proxy who can decide which future versions of the GNU General Public
+ * License can be used.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "REXH.h"
+#define FUNGE_EXTENDS_REXP
+#include "../REXP/REXP.h"
+#include "../../stack.h"
+
+#include <stdlib.h>
+
+/*
+ * Each handle refers to an expression in the cache of REXP, which keeps it
+ * from being evicted until the handle is freed. Compiling the same pattern
+ * with the same flags again gives a new handle to the same expression.
+ */
+
+/// How many handles to allocate in one go.
+#define ALLOCCHUNK 4
+
+// Array of pointers
+static FungeRegex** regexes = NULL;
+static funge_cell maxHandle = 0;
+
+
+/********************
+ * Handle handling. *
+ ********************/
+
+/// Used by allocate_handle() below to find next free handle.
+FUNGE_ATTR_FAST FUNGE_ATTR_WARN_UNUSED
+static inline funge_cell find_next_free_handle(void)
+{
+	for (funge_cell i = 0; i < maxHandle; i++) {
+		if (regexes[i] == NULL)
+			return i;
+	}
+	// No free one, extend array..
+	{
+		FungeRegex** newlist = (FungeRegex**)realloc(regexes, (size_t)(maxHandle + ALLOCCHUNK) * sizeof(FungeRegex*));
+		if (!newlist)
+			return -1;
+		regexes = newlist;
+		for (funge_cell i = maxHandle; i < (maxHandle + ALLOCCHUNK); i++)
+			regexes[i] = NULL;
+		maxHandle += ALLOCCHUNK;
+		return (maxHandle - ALLOCCHUNK);
+	}
+}
+
+/// Checks if handle is valid.
+FUNGE_ATTR_FAST FUNGE_ATTR_WARN_UNUSED
+static inline bool valid_handle(funge_cell h)
+{
+	if ((h < 0) || (h >= maxHandle) || (!regexes[h])) {
+		return false;
+	} else {
+		return true;
+	}
+}
+
+/// Pop a 0"gnirts" and ignore it.
+FUNGE_ATTR_FAST
+static inline void discard_string(funge_stack * stack)
+{
+	funge_string_view view = stack_pop_string_view(stack);
+	(void)view;
+}
+
+
+/*****************
+ * Instructions. *
+ *****************/
+
+/// C - Compile a regular expression to a handle
+static void finger_REXH_compile(instructionPointer * ip)
+{
+	funge_cell flags = stack_pop(ip->stack);
+	funge_cell h;
+	int error;
+	FungeRegex *re = finger_REXP_Acquire(ip->stack, flags, &error);
+
+	if (!re) {
+		ip_reverse(ip);
+		stack_push(ip->stack, error);
+		return;
+	}
+	h = find_next_free_handle();
+	if (h < 0) {
+		finger_REXP_Release(re);
+		ip_reverse(ip);
+		stack_push(ip->stack, FUNGE_REG_ESPACE);
+		return;
+	}
+	regexes[h] = re;
+	stack_push(ip->stack, h);
+}
+
+/// E - Execute regular expression on string
+static void finger_REXH_execute(instructionPointer * ip)
+{
+	funge_cell h = stack_pop(ip->stack);
+	funge_cell flags = stack_pop(ip->stack);
+
+	if (!valid_handle(h)) {
+		discard_string(ip->stack);
+		ip_reverse(ip);
+		return;
+	}
+	if (!finger_REXP_Match(ip, regexes[h], flags, true))
+		ip_reverse(ip);
+}
+
+/// F - Free a handle
+static void finger_REXH_free(instructionPointer * ip)
+{
+	funge_cell h = stack_pop(ip->stack);
+
+	if (!valid_handle(h)) {
+		ip_reverse(ip);
+		return;
+	}
+	finger_REXP_Release(regexes[h]);
+	regexes[h] = NULL;
+}
+
+/// T - Check if a string matches
+static void finger_REXH_test(instructionPointer * ip)
+{
+	funge_cell h = stack_pop(ip->stack);
+	funge_cell flags = stack_pop(ip->stack);
+
+	if (!valid_handle(h)) {
+		discard_string(ip->stack);
+		ip_reverse(ip);
+		return;
+	}
+	stack_push(ip->stack, finger_REXP_Match(ip, regexes[h], flags, false));
+}
+
+bool finger_REXH_load(instructionPointer * ip)
+{
+	manager_add_opcode(REXH, 'C', compile);
+	manager_add_opcode(REXH, 'E', execute);
+	manager_add_opcode(REXH, 'F', free);
+	manager_add_opcode(REXH, 'T', test);
+	return true;
+}
@@ -19,6 +19,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#define FUNGE_EXTENDS_REXP
 #include "REXP.h"
 #include "../../stack.h"
 #include "../../diagnostic.h"
@@ -26,17 +27,52 @@
 #include <sys/types.h> /* Regular expressions */
 #include <regex.h> /* Regular expressions */
 #include <unistd.h>
+#include <ctype.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 
 #if !defined(_POSIX_REGEXP) || (_POSIX_REGEXP < 1)
 #  error "cfunge needs POSIX regular expressions, which this system claims it doesn't have."
 #endif
 
+/*
+ * Compiled expressions are kept in a cache keyed by pattern and flags, so
+ * switching between a few patterns with C doesn't compile them again. REXH
+ * uses the same cache for its handles.
+ *
+ * Patterns that are plain strings (optionally with ^ and $ anchors) are not
+ * given to regcomp() at all. They are matched with a KMP automaton that runs
+ * directly on the string on the stack, in linear time and without copying it.
+ */
+
 #define MATCHSIZE 128
+/// Number of compiled expressions kept in the cache while not in use.
+#define REXP_CACHE_SIZE 16
 
-static regex_t compiled_regex;
-static bool compiled_valid = false;
-static bool compiled_nosub = false;
+struct FungeRegex {
+	unsigned char *pattern;     ///< The pattern, 0-terminated.
+	size_t         len;         ///< Length of the pattern.
+	uint32_t       hash;        ///< Hash of the pattern.
+	int            cflags;      ///< System flags used to compile it.
+	uint32_t       pins;        ///< Number of users, evicted only when 0.
+	uint64_t       lastUse;     ///< Value of useCounter when last used.
+	bool           literal;     ///< Use the literal matcher, regex is unused.
+	bool           anchorStart; ///< Literal pattern starts with ^.
+	bool           anchorEnd;   ///< Literal pattern ends with $.
+	unsigned char *lit;         ///< The literal string (folded for REG_ICASE).
+	size_t         litLen;      ///< Length of lit.
+	size_t        *fail;        ///< KMP failure function of lit.
+	regex_t        regex;       ///< The compiled expression otherwise.
+};
+
+static FungeRegex** cache = NULL;
+static size_t cacheCount = 0;
+static size_t cacheSize = 0;
+static uint64_t useCounter = 0;
+
+/// The expression used by REXP C, E and F.
+static FungeRegex* current = NULL;
 static regmatch_t matches[MATCHSIZE];
 
 // The flags used in Funge could differ from the system ones.
@@ -57,7 +93,7 @@ static regmatch_t matches[MATCHSIZE];
 #define FUNGE_REG_EESCAPE  9
 #define FUNGE_REG_EPAREN   10
 #define FUNGE_REG_ERANGE   11
-#define FUNGE_REG_ESPACE   13
+// FUNGE_REG_ESPACE is in REXP.h
 #define FUNGE_REG_ESUBREG  14
 // E
 #define FUNGE_REG_NOTBOL 1
@@ -115,84 +151,379 @@ static inline int translate_return_C(int error)
 	return -1;
 }
 
+
+/*********************
+ * Literal patterns. *
+ *********************/
+
+/// Characters that are special in basic or extended expressions. Some are
+/// only special in one of them, but those patterns just use regcomp().
+#define REXP_SPECIAL "\\.[]*^$()|+?{}"
+
+/**
+ * Check if a pattern is a plain string, and set up the literal matcher if it
+ * is. ^ is allowed first and $ last, as anchors.
+ * @return False if it is not a plain string, or on out of memory.
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL FUNGE_ATTR_WARN_UNUSED
+static bool literal_setup(FungeRegex * re)
+{
+	const unsigned char *start = re->pattern;
+	size_t len = re->len;
+
+	if (len > 0 && start[0] == '^') {
+		re->anchorStart = true;
+		start++;
+		len--;
+	}
+	if (len > 0 && start[len - 1] == '$') {
+		re->anchorEnd = true;
+		len--;
+	}
+	if (len == 0)
+		return false;
+	for (size_t i = 0; i < len; i++) {
+		if (strchr(REXP_SPECIAL, start[i]))
+			return false;
+	}
+
+	re->lit = malloc(len);
+	re->fail = malloc(len * sizeof(size_t));
+	if (!re->lit || !re->fail) {
+		free(re->lit);
+		free(re->fail);
+		return false;
+	}
+	for (size_t i = 0; i < len; i++)
+		re->lit[i] = (re->cflags & REG_ICASE) ? (unsigned char)tolower(start[i]) : start[i];
+	re->litLen = len;
+
+	// Standard KMP failure function: length of the longest proper prefix of
+	// lit[0..i] that is also a suffix of it.
+	re->fail[0] = 0;
+	for (size_t i = 1, k = 0; i < len; i++) {
+		while (k > 0 && re->lit[i] != re->lit[k])
+			k = re->fail[k - 1];
+		if (re->lit[i] == re->lit[k])
+			k++;
+		re->fail[i] = k;
+	}
+	re->literal = true;
+	return true;
+}
+
+/**
+ * Match a literal pattern against a string on the stack, like regexec() would.
+ * @param stack The stack the string view was popped from.
+ * @param view The string.
+ * @param eflags System flags, as for regexec().
+ * @param match Set to the match on success.
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL FUNGE_ATTR_WARN_UNUSED
+static bool literal_match(const FungeRegex * restrict re,
+                          const funge_stack * restrict stack,
+                          const funge_string_view * restrict view,
+                          int eflags, regmatch_t * restrict match)
+{
+	const size_t m = re->litLen;
+	const bool icase = (re->cflags & REG_ICASE) != 0;
+	const bool newline = (re->cflags & REG_NEWLINE) != 0;
+	size_t len = view->len;
+	size_t j = 0;
+
+	if (m > len)
+		return false;
+	// Without REG_NEWLINE, ^ can only match at the start of the string.
+	if (re->anchorStart && !newline) {
+		if (eflags & REG_NOTBOL)
+			return false;
+		len = m;
+	}
+	for (size_t i = 0; i < len; i++) {
+		unsigned char c = (unsigned char)stack_view_char(stack, *view, i);
+		if (icase)
+			c = (unsigned char)tolower(c);
+		while (j > 0 && c != re->lit[j])
+			j = re->fail[j - 1];
+		if (c == re->lit[j])
+			j++;
+		if (j == m) {
+			size_t so = i + 1 - m;
+			size_t eo = i + 1;
+			bool ok = true;
+			if (re->anchorStart)
+				ok = (so == 0 && !(eflags & REG_NOTBOL))
+				     || (newline && so > 0 && stack_view_char(stack, *view, so - 1) == '\n');
+			if (ok && re->anchorEnd)
+				ok = (eo == view->len && !(eflags & REG_NOTEOL))
+				     || (newline && eo < view->len && stack_view_char(stack, *view, eo) == '\n');
+			if (ok) {
+				match->rm_so = (regoff_t)so;
+				match->rm_eo = (regoff_t)eo;
+				return true;
+			}
+			j = re->fail[j - 1];
+		}
+	}
+	return false;
+}
+
+
+/**********
+ * Cache. *
+ **********/
+
+/// FNV-1a hash of a pattern on the stack.
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL FUNGE_ATTR_PURE FUNGE_ATTR_WARN_UNUSED
+static uint32_t pattern_hash(const funge_stack * restrict stack,
+                             const funge_string_view * restrict view)
+{
+	uint32_t hash = UINT32_C(2166136261);
+	for (size_t i = 0; i < view->len; i++) {
+		hash ^= (unsigned char)stack_view_char(stack, *view, i);
+		hash *= UINT32_C(16777619);
+	}
+	return hash;
+}
+
+/// Find a pattern on the stack in the cache.
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL FUNGE_ATTR_WARN_UNUSED
+static FungeRegex* cache_find(const funge_stack * restrict stack,
+                              const funge_string_view * restrict view,
+                              uint32_t hash, int cflags)
+{
+	for (size_t i = 0; i < cacheCount; i++) {
+		FungeRegex *re = cache[i];
+		size_t j;
+		if (re->hash != hash || re->cflags != cflags || re->len != view->len)
+			continue;
+		for (j = 0; j < view->len; j++) {
+			if (re->pattern[j] != (unsigned char)stack_view_char(stack, *view, j))
+				break;
+		}
+		if (j == view->len)
+			return re;
+	}
+	return NULL;
+}
+
+/// Free an expression, it must not be in the cache.
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL
+static void regex_free(FungeRegex * re)
+{
+	if (re->literal) {
+		free(re->lit);
+		free(re->fail);
+	} else {
+		regfree(&re->regex);
+	}
+	free(re->pattern);
+	free(re);
+}
+
+/// Evict the least recently used entries not in use, until there are fewer
+/// than REXP_CACHE_SIZE of them.
+FUNGE_ATTR_FAST
+static void cache_trim(void)
+{
+	for (;;) {
+		size_t unused = 0;
+		size_t oldest = 0;
+		for (size_t i = 0; i < cacheCount; i++) {
+			if (cache[i]->pins != 0)
+				continue;
+			if (unused == 0 || cache[i]->lastUse < cache[oldest]->lastUse)
+				oldest = i;
+			unused++;
+		}
+		if (unused < REXP_CACHE_SIZE)
+			return;
+		regex_free(cache[oldest]);
+		cache[oldest] = cache[--cacheCount];
+	}
+}
+
+/// Compile a pattern on the stack and add it to the cache.
+/// @return The new entry, or NULL with error set on failure.
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL FUNGE_ATTR_WARN_UNUSED
+static FungeRegex* cache_add(const funge_stack * restrict stack,
+                             const funge_string_view * restrict view,
+                             uint32_t hash, int cflags, int * restrict error)
+{
+	FungeRegex *re;
+
+	*error = FUNGE_REG_ESPACE;
+	cache_trim();
+	if (cacheCount == cacheSize) {
+		size_t newSize = cacheSize ? cacheSize * 2 : REXP_CACHE_SIZE;
+		FungeRegex** newCache = realloc(cache, newSize * sizeof(FungeRegex*));
+		if (!newCache)
+			return NULL;
+		cache = newCache;
+		cacheSize = newSize;
+	}
+	re = calloc(1, sizeof(FungeRegex));
+	if (!re)
+		return NULL;
+	re->pattern = malloc(view->len + 1);
+	if (!re->pattern) {
+		free(re);
+		return NULL;
+	}
+	for (size_t i = 0; i < view->len; i++)
+		re->pattern[i] = (unsigned char)stack_view_char(stack, *view, i);
+	re->pattern[view->len] = '\0';
+	re->len = view->len;
+	re->hash = hash;
+	re->cflags = cflags;
+
+	if (!literal_setup(re)) {
+		int compret = regcomp(&re->regex, (const char*)re->pattern, cflags);
+		if (compret != 0) {
+			*error = translate_return_C(compret);
+			free(re->pattern);
+			free(re);
+			return NULL;
+		}
+	}
+	cache[cacheCount++] = re;
+	return re;
+}
+
+FUNGE_ATTR_FAST
+FungeRegex* finger_REXP_Acquire(funge_stack * restrict stack, funge_cell flags,
+                                int * restrict error)
+{
+	int cflags = translate_flags_C(flags);
+	funge_string_view view = stack_pop_string_view(stack);
+	uint32_t hash = pattern_hash(stack, &view);
+	FungeRegex *re = cache_find(stack, &view, hash, cflags);
+
+	if (!re) {
+		re = cache_add(stack, &view, hash, cflags, error);
+		if (!re)
+			return NULL;
+	}
+	re->pins++;
+	re->lastUse = ++useCounter;
+	return re;
+}
+
+FUNGE_ATTR_FAST
+void finger_REXP_Release(FungeRegex * re)
+{
+	re->pins--;
+}
+
+
+/*************
+ * Matching. *
+ *************/
+
 FUNGE_ATTR_FAST
 static inline void push_results(instructionPointer * restrict ip,
-                                char * restrict str)
+                                size_t nmatch,
+                                const char * restrict str)
 {
-	if (compiled_nosub) {
-		stack_push(ip->stack, 0);
-	} else {
-		int count = 0;
-		for (int i = MATCHSIZE - 1; i >= 0; i--) {
-			if (matches[i].rm_so != -1) {
-				count++;
+	int count = 0;
+	for (size_t i = nmatch; i-- > 0;) {
+		if (matches[i].rm_so != -1) {
+			count++;
+			stack_push(ip->stack, 0);
+			stack_push_string(ip->stack, (const unsigned char*)str + matches[i].rm_so,
+			                  matches[i].rm_eo - matches[i].rm_so - 1);
+		}
+	}
+	stack_push(ip->stack, count);
+}
+
+FUNGE_ATTR_FAST
+bool finger_REXP_Match(instructionPointer * restrict ip, FungeRegex * restrict re,
+                       funge_cell flags, bool results)
+{
+	int eflags = translate_flags_E(flags);
+	bool nosub = (re->cflags & REG_NOSUB) != 0;
+
+	re->lastUse = ++useCounter;
+	if (re->literal) {
+		funge_string_view view = stack_pop_string_view(ip->stack);
+		regmatch_t match;
+		if (!literal_match(re, ip->stack, &view, eflags, &match))
+			return false;
+		if (results) {
+			if (nosub) {
 				stack_push(ip->stack, 0);
-				stack_push_string(ip->stack, (unsigned char*)str + matches[i].rm_so,
-				                  matches[i].rm_eo - matches[i].rm_so - 1);
+			} else {
+				stack_push_string_view(ip->stack, &view, (size_t)match.rm_so,
+				                       (size_t)(match.rm_eo - match.rm_so));
+				stack_push(ip->stack, 1);
 			}
 		}
-		stack_push(ip->stack, count);
+		return true;
+	} else {
+		const char * str = (const char*)stack_pop_string_scratch(ip->stack, NULL);
+		size_t nmatch = 0;
+		// Only ask for the submatches that can exist, the others would be
+		// unset anyway.
+		if (results && !nosub)
+			nmatch = (re->regex.re_nsub + 1 < MATCHSIZE) ? re->regex.re_nsub + 1 : MATCHSIZE;
+		if (!str || regexec(&re->regex, str, nmatch, matches, eflags) != 0)
+			return false;
+		if (results) {
+			if (nosub)
+				stack_push(ip->stack, 0);
+			else
+				push_results(ip, nmatch, str);
+		}
+		return true;
 	}
 }
 
+
+/*****************
+ * Instructions. *
+ *****************/
+
 /// C - Compile a regular expression
 static void finger_REXP_compile(instructionPointer * ip)
 {
-	char * restrict str;
-	int flags;
-	int compret;
+	funge_cell flags;
+	int error;
 
-	// Avoid memory leak.
-	if (compiled_valid)
-		regfree(&compiled_regex);
-
-	flags = translate_flags_C(stack_pop(ip->stack));
-	str = (char*)stack_pop_string(ip->stack, NULL);
-
-	compret = regcomp(&compiled_regex, str, flags);
+	if (current) {
+		finger_REXP_Release(current);
+		current = NULL;
+	}
 
-	if (compret != 0) {
+	flags = stack_pop(ip->stack);
+	current = finger_REXP_Acquire(ip->stack, flags, &error);
+	if (!current) {
 		ip_reverse(ip);
-		stack_push(ip->stack, translate_return_C(compret));
-		compiled_valid = false;
-	} else {
-		compiled_valid = true;
-		compiled_nosub = (flags & REG_NOSUB);
+		stack_push(ip->stack, error);
 	}
-
-	stack_free_string(str);
 }
 
 /// E - Execute regular expression on string
 static void finger_REXP_execute(instructionPointer * ip)
 {
-	char * str;
-	int flags;
-	int execret;
+	funge_cell flags;
 
-	if (!compiled_valid) {
+	if (!current) {
 		ip_reverse(ip);
 		return;
 	}
 
-	flags = translate_flags_E(stack_pop(ip->stack));
-	str = (char*)stack_pop_string(ip->stack, NULL);
-
-	execret = regexec(&compiled_regex, str, MATCHSIZE, matches, flags);
-	if (execret == 0) {
-		push_results(ip, str);
-	} else {
+	flags = stack_pop(ip->stack);
+	if (!finger_REXP_Match(ip, current, flags, true))
 		ip_reverse(ip);
-	}
-	stack_free_string(str);
 }
 
 /// F - Free compiled regex buffer
 static void finger_REXP_free(FUNGE_ATTR_UNUSED instructionPointer * ip)
 {
-	if (compiled_valid) {
-		regfree(&compiled_regex);
-		compiled_valid = false;
+	if (current) {
+		finger_REXP_Release(current);
+		current = NULL;
 	}
 }
 
@@ -27,4 +27,43 @@
 
 bool finger_REXP_load(instructionPointer * ip);
 
+// Used by other fingerprints wanting to use the regex cache, like REXH
+#ifdef FUNGE_EXTENDS_REXP
+/// Error code for out of memory, as returned by REXP C.
+#define FUNGE_REG_ESPACE 13
+
+/// A compiled regular expression in the cache.
+typedef struct FungeRegex FungeRegex;
+
+/**
+ * Pop a 0"gnirts" pattern and get it compiled with the given (Funge) flags,
+ * from the cache if possible. The result must be released with
+ * finger_REXP_Release().
+ * @param stack Stack to pop the pattern from.
+ * @param flags Funge flags, as for REXP C.
+ * @param error Set to the Funge error code on failure.
+ * @return The compiled expression, or NULL on failure.
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL FUNGE_ATTR_WARN_UNUSED
+FungeRegex* finger_REXP_Acquire(funge_stack * restrict stack, funge_cell flags,
+                                int * restrict error);
+
+/// Release an expression from finger_REXP_Acquire(), it stays in the cache
+/// until evicted.
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL
+void finger_REXP_Release(FungeRegex * re);
+
+/**
+ * Pop a 0"gnirts" and match it against a compiled expression.
+ * @param ip IP to pop the string from and push results to.
+ * @param re The expression.
+ * @param flags Funge flags, as for REXP E.
+ * @param results If true, push the matches on success like REXP E.
+ * @return True if the string matched.
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL FUNGE_ATTR_WARN_UNUSED
+bool finger_REXP_Match(instructionPointer * restrict ip, FungeRegex * restrict re,
+                       funge_cell flags, bool results);
+#endif
+
 #endif
@@ -0,0 +1,16 @@
+%fingerprint-spec 1.4
+%fprint:ROPE
+%url:https://github.com/VorpalBlade/cfunge
+%desc:cfunge string handles stored as ropes
+%safe:true
+%begin-instrs
+#I Name              Desc
+A  append            Append two strings into a new string
+C  char_at           Push character at index
+F  free              Free a string handle
+I  index             Find first occurrence of a string in a string
+M  slice             New string of n characters starting at position p
+N  length            Push length of string
+P  push              Push string as a 0gnirts
+S  store             Store a 0gnirts as a new string
+%end
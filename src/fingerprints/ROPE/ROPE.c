@@ -0,0 +1,469 @@
+/* -*- mode: C; coding: utf-8; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*-
+ *
+ * cfunge - A standard-conforming Befunge93/98/109 interpreter in C.
+ * Copyright (C) 2008-2013 Arvid Norlander <VorpalBlade AT users.noreply.github.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at the proxy's option) any later version. Arvid Norlander is a
+ * proxy who can decide which future versions of the GNU General Public
+ * License can be used.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ROPE.h"
+#include "../../stack.h"
+#include "../../diagnostic.h"
+
+#include "../../../lib/fungestring/funge_string.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Strings are stored as ropes: immutable, reference counted binary trees where
+ * the leaves hold the characters and an inner node is the concatenation of its
+ * children. Nodes are shared between strings. The trees are kept balanced in
+ * the same way as AVL trees, so append, slice and indexing are O(log n).
+ *
+ * Strings are only created from 0"gnirts" so they never contain 0, which
+ * means funge_strstr() can be used for searching.
+ */
+
+/// Maximum number of characters in a leaf.
+#define ROPE_LEAF_MAX 128
+/// How many handles to allocate in one go.
+#define ALLOCCHUNK 16
+
+typedef struct rope_node {
+	size_t refcount;
+	size_t len;                ///< Number of characters.
+	unsigned int height;       ///< 0 for leaves.
+	struct rope_node *left;    ///< Start of the string, only for inner nodes.
+	struct rope_node *right;   ///< End of the string, only for inner nodes.
+	funge_cell cells[];        ///< Characters, only for leaves.
+} rope_node;
+
+/// Strings, indexed by handle. NULL for free handles.
+static rope_node **handles = NULL;
+/// Size of handles.
+static size_t maxHandle = 0;
+/// All handles below this are in use.
+static size_t firstFreeHandle = 0;
+
+
+/************************
+ * Rope data structure. *
+ ************************/
+
+/// Create a leaf for len characters, the characters are not initialised.
+FUNGE_ATTR_FAST FUNGE_ATTR_WARN_UNUSED
+static rope_node *rope_new_leaf(size_t len)
+{
+	rope_node *node = malloc(sizeof(rope_node) + len * sizeof(funge_cell));
+	if (FUNGE_UNLIKELY(!node))
+		DIAG_OOM("Could not allocate rope leaf");
+	node->refcount = 1;
+	node->len = len;
+	node->height = 0;
+	node->left = NULL;
+	node->right = NULL;
+	return node;
+}
+
+/// Create an inner node, takes over the references to left and right.
+FUNGE_ATTR_FAST FUNGE_ATTR_WARN_UNUSED
+static rope_node *rope_new_node(rope_node *left, rope_node *right)
+{
+	rope_node *node = malloc(sizeof(rope_node));
+	if (FUNGE_UNLIKELY(!node))
+		DIAG_OOM("Could not allocate rope node");
+	node->refcount = 1;
+	node->len = left->len + right->len;
+	node->height = ((left->height > right->height) ? left->height : right->height) + 1;
+	node->left = left;
+	node->right = right;
+	return node;
+}
+
+FUNGE_ATTR_FAST
+static inline rope_node *rope_ref(rope_node *node)
+{
+	node->refcount++;
+	return node;
+}
+
+FUNGE_ATTR_FAST
+static void rope_unref(rope_node *node)
+{
+	if (--node->refcount > 0)
+		return;
+	if (node->height > 0) {
+		rope_unref(node->left);
+		rope_unref(node->right);
+	}
+	free(node);
+}
+
+/// Get references to the children of an inner node and drop the reference to
+/// the node itself.
+FUNGE_ATTR_FAST
+static inline void rope_open(rope_node *node, rope_node **left, rope_node **right)
+{
+	assert(node->height > 0);
+	*left = rope_ref(node->left);
+	*right = rope_ref(node->right);
+	rope_unref(node);
+}
+
+/// (a, (b, c)) -> ((a, b), c)
+FUNGE_ATTR_FAST FUNGE_ATTR_WARN_UNUSED
+static rope_node *rope_rotate_left(rope_node *node)
+{
+	rope_node *a, *bc, *b, *c;
+	rope_open(node, &a, &bc);
+	rope_open(bc, &b, &c);
+	return rope_new_node(rope_new_node(a, b), c);
+}
+
+/// ((a, b), c) -> (a, (b, c))
+FUNGE_ATTR_FAST FUNGE_ATTR_WARN_UNUSED
+static rope_node *rope_rotate_right(rope_node *node)
+{
+	rope_node *ab, *a, *b, *c;
+	rope_open(node, &ab, &c);
+	rope_open(ab, &a, &b);
+	return rope_new_node(a, rope_new_node(b, c));
+}
+
+FUNGE_ATTR_FAST FUNGE_ATTR_WARN_UNUSED
+static rope_node *rope_concat(rope_node *left, rope_node *right);
+
+/// Concatenate when left is more than one level higher than right.
+FUNGE_ATTR_FAST FUNGE_ATTR_WARN_UNUSED
+static rope_node *rope_join_right(rope_node *left, rope_node *right)
+{
+	rope_node *ll, *lr, *t;
+	rope_open(left, &ll, &lr);
+	if (lr->height <= right->height + 1) {
+		t = rope_concat(lr, right);
+		if (t->height <= ll->height + 1)
+			return rope_new_node(ll, t);
+		return rope_rotate_left(rope_new_node(ll, rope_rotate_right(t)));
+	}
+	t = rope_join_right(lr, right);
+	if (t->height <= ll->height + 1)
+		return rope_new_node(ll, t);
+	return rope_rotate_left(rope_new_node(ll, t));
+}
+
+/// Concatenate when right is more than one level higher than left.
+FUNGE_ATTR_FAST FUNGE_ATTR_WARN_UNUSED
+static rope_node *rope_join_left(rope_node *left, rope_node *right)
+{
+	rope_node *rl, *rr, *t;
+	rope_open(right, &rl, &rr);
+	if (rl->height <= left->height + 1) {
+		t = rope_concat(left, rl);
+		if (t->height <= rr->height + 1)
+			return rope_new_node(t, rr);
+		return rope_rotate_right(rope_new_node(rope_rotate_left(t), rr));
+	}
+	t = rope_join_left(left, rl);
+	if (t->height <= rr->height + 1)
+		return rope_new_node(t, rr);
+	return rope_rotate_right(rope_new_node(t, rr));
+}
+
+/// Concatenate two ropes, takes over the references to both.
+FUNGE_ATTR_FAST FUNGE_ATTR_WARN_UNUSED
+static rope_node *rope_concat(rope_node *left, rope_node *right)
+{
+	if (left->len == 0) {
+		rope_unref(left);
+		return right;
+	}
+	if (right->len == 0) {
+		rope_unref(right);
+		return left;
+	}
+	// Merge small leaves, so that building a string a few characters at a
+	// time doesn't create a node for each piece.
+	if (left->height == 0 && right->height == 0
+	    && left->len + right->len <= ROPE_LEAF_MAX) {
+		rope_node *leaf = rope_new_leaf(left->len + right->len);
+		memcpy(leaf->cells, left->cells, left->len * sizeof(funge_cell));
+		memcpy(leaf->cells + left->len, right->cells, right->len * sizeof(funge_cell));
+		rope_unref(left);
+		rope_unref(right);
+		return leaf;
+	}
+	if (left->height > right->height + 1)
+		return rope_join_right(left, right);
+	if (right->height > left->height + 1)
+		return rope_join_left(left, right);
+	return rope_new_node(left, right);
+}
+
+/// Get a rope with the characters from (inclusive) to to (exclusive).
+FUNGE_ATTR_FAST FUNGE_ATTR_WARN_UNUSED
+static rope_node *rope_sub(rope_node *node, size_t from, size_t to)
+{
+	size_t mid;
+	assert(from <= to && to <= node->len);
+	if (from == 0 && to == node->len)
+		return rope_ref(node);
+	if (node->height == 0) {
+		rope_node *leaf = rope_new_leaf(to - from);
+		memcpy(leaf->cells, node->cells + from, (to - from) * sizeof(funge_cell));
+		return leaf;
+	}
+	mid = node->left->len;
+	if (to <= mid)
+		return rope_sub(node->left, from, to);
+	if (from >= mid)
+		return rope_sub(node->right, from - mid, to - mid);
+	return rope_concat(rope_sub(node->left, from, mid),
+	                   rope_sub(node->right, 0, to - mid));
+}
+
+FUNGE_ATTR_FAST FUNGE_ATTR_WARN_UNUSED FUNGE_ATTR_PURE
+static funge_cell rope_char_at(const rope_node *node, size_t index)
+{
+	assert(index < node->len);
+	while (node->height > 0) {
+		if (index < node->left->len) {
+			node = node->left;
+		} else {
+			index -= node->left->len;
+			node = node->right;
+		}
+	}
+	return node->cells[index];
+}
+
+/// Copy the characters of a rope to out, which must have room for all.
+FUNGE_ATTR_FAST
+static void rope_flatten(const rope_node *node, funge_cell *out)
+{
+	while (node->height > 0) {
+		rope_flatten(node->left, out);
+		out += node->left->len;
+		node = node->right;
+	}
+	memcpy(out, node->cells, node->len * sizeof(funge_cell));
+}
+
+/// Copy the characters of a rope to a new null-terminated array.
+FUNGE_ATTR_FAST FUNGE_ATTR_WARN_UNUSED
+static funge_cell *rope_to_string(const rope_node *node)
+{
+	funge_cell *str = malloc((node->len + 1) * sizeof(funge_cell));
+	if (FUNGE_UNLIKELY(!str))
+		return NULL;
+	rope_flatten(node, str);
+	str[node->len] = 0;
+	return str;
+}
+
+/// Build a balanced rope from characters from (inclusive) to to (exclusive)
+/// of a string view.
+FUNGE_ATTR_FAST FUNGE_ATTR_WARN_UNUSED
+static rope_node *rope_from_view(const funge_stack *stack,
+                                 const funge_string_view *view,
+                                 size_t from, size_t to)
+{
+	size_t leaves, mid;
+	if (to - from <= ROPE_LEAF_MAX) {
+		rope_node *leaf = rope_new_leaf(to - from);
+		for (size_t i = 0; i < to - from; i++)
+			leaf->cells[i] = stack_view_char(stack, *view, from + i);
+		return leaf;
+	}
+	// Split on a leaf boundary, so that all leaves but the last one are full.
+	leaves = (to - from + ROPE_LEAF_MAX - 1) / ROPE_LEAF_MAX;
+	mid = from + (leaves / 2) * ROPE_LEAF_MAX;
+	return rope_new_node(rope_from_view(stack, view, from, mid),
+	                     rope_from_view(stack, view, mid, to));
+}
+
+
+/*******************
+ * Handle helpers. *
+ *******************/
+
+/// Get the string for a handle, or NULL if the handle isn't valid.
+FUNGE_ATTR_FAST FUNGE_ATTR_WARN_UNUSED FUNGE_ATTR_PURE
+static inline rope_node *get_rope(funge_cell h)
+{
+	if ((h < 0) || ((size_t)h >= maxHandle))
+		return NULL;
+	return handles[h];
+}
+
+/// Store a string in a new handle and push the handle. Reflects if there is
+/// no memory for the handle.
+FUNGE_ATTR_FAST
+static void push_rope(instructionPointer * ip, rope_node *rope)
+{
+	size_t h = firstFreeHandle;
+	while (h < maxHandle && handles[h] != NULL)
+		h++;
+	if (h == maxHandle) {
+		rope_node **newlist = (rope_node**)realloc(handles, (maxHandle + ALLOCCHUNK) * sizeof(rope_node*));
+		if (FUNGE_UNLIKELY(!newlist)) {
+			rope_unref(rope);
+			ip_reverse(ip);
+			return;
+		}
+		handles = newlist;
+		for (size_t i = maxHandle; i < maxHandle + ALLOCCHUNK; i++)
+			handles[i] = NULL;
+		maxHandle += ALLOCCHUNK;
+	}
+	handles[h] = rope;
+	firstFreeHandle = h + 1;
+	stack_push(ip->stack, (funge_cell)h);
+}
+
+
+/*****************
+ * Instructions. *
+ *****************/
+
+/// A - Append two strings into a new string
+static void finger_ROPE_append(instructionPointer * ip)
+{
+	rope_node *b = get_rope(stack_pop(ip->stack));
+	rope_node *a = get_rope(stack_pop(ip->stack));
+	if (!a || !b) {
+		ip_reverse(ip);
+		return;
+	}
+	push_rope(ip, rope_concat(rope_ref(a), rope_ref(b)));
+}
+
+/// C - Push character at index
+static void finger_ROPE_char_at(instructionPointer * ip)
+{
+	funge_cell i = stack_pop(ip->stack);
+	rope_node *rope = get_rope(stack_pop(ip->stack));
+	if (!rope || i < 0 || (size_t)i >= rope->len) {
+		ip_reverse(ip);
+		return;
+	}
+	stack_push(ip->stack, rope_char_at(rope, (size_t)i));
+}
+
+/// F - Free a string handle
+static void finger_ROPE_free(instructionPointer * ip)
+{
+	funge_cell h = stack_pop(ip->stack);
+	rope_node *rope = get_rope(h);
+	if (!rope) {
+		ip_reverse(ip);
+		return;
+	}
+	rope_unref(rope);
+	handles[h] = NULL;
+	if ((size_t)h < firstFreeHandle)
+		firstFreeHandle = (size_t)h;
+}
+
+/// I - Find first occurrence of a string in a string
+static void finger_ROPE_index(instructionPointer * ip)
+{
+	funge_cell *haystack, *needle;
+	const funge_cell *found;
+	rope_node *b = get_rope(stack_pop(ip->stack));
+	rope_node *a = get_rope(stack_pop(ip->stack));
+	if (!a || !b) {
+		ip_reverse(ip);
+		return;
+	}
+	haystack = rope_to_string(a);
+	needle = rope_to_string(b);
+	if (FUNGE_UNLIKELY(!haystack || !needle)) {
+		free(haystack);
+		free(needle);
+		ip_reverse(ip);
+		return;
+	}
+	found = funge_strstr(haystack, needle);
+	stack_push(ip->stack, found ? (funge_cell)(found - haystack) : -1);
+	free(haystack);
+	free(needle);
+}
+
+/// M - New string of n characters starting at position p
+static void finger_ROPE_slice(instructionPointer * ip)
+{
+	funge_cell n = stack_pop(ip->stack);
+	funge_cell p = stack_pop(ip->stack);
+	rope_node *rope = get_rope(stack_pop(ip->stack));
+	if (!rope || p < 0 || n < 0 || (size_t)p > rope->len) {
+		ip_reverse(ip);
+		return;
+	}
+	if ((size_t)n > rope->len - (size_t)p)
+		n = (funge_cell)(rope->len - (size_t)p);
+	push_rope(ip, rope_sub(rope, (size_t)p, (size_t)p + (size_t)n));
+}
+
+/// N - Push length of string
+static void finger_ROPE_length(instructionPointer * ip)
+{
+	rope_node *rope = get_rope(stack_pop(ip->stack));
+	if (!rope) {
+		ip_reverse(ip);
+		return;
+	}
+	stack_push(ip->stack, (funge_cell)rope->len);
+}
+
+/// P - Push string as a 0gnirts
+static void finger_ROPE_push(instructionPointer * ip)
+{
+	funge_cell *str;
+	rope_node *rope = get_rope(stack_pop(ip->stack));
+	if (!rope) {
+		ip_reverse(ip);
+		return;
+	}
+	str = rope_to_string(rope);
+	if (FUNGE_UNLIKELY(!str)) {
+		ip_reverse(ip);
+		return;
+	}
+	stack_push_string_multibyte(ip->stack, str, rope->len);
+	free(str);
+}
+
+/// S - Store a 0gnirts as a new string
+static void finger_ROPE_store(instructionPointer * ip)
+{
+	funge_string_view view = stack_pop_string_view(ip->stack);
+	push_rope(ip, rope_from_view(ip->stack, &view, 0, view.len));
+}
+
+bool finger_ROPE_load(instructionPointer * ip)
+{
+	manager_add_opcode(ROPE, 'A', append);
+	manager_add_opcode(ROPE, 'C', char_at);
+	manager_add_opcode(ROPE, 'F', free);
+	manager_add_opcode(ROPE, 'I', index);
+	manager_add_opcode(ROPE, 'M', slice);
+	manager_add_opcode(ROPE, 'N', length);
+	manager_add_opcode(ROPE, 'P', push);
+	manager_add_opcode(ROPE, 'S', store);
+	return true;
+}
@@ -20,6 +20,7 @@
  */
 
 #include "SCKE.h"
+#include "../../replay.h"
 #include "../../stack.h"
 
 #define FUNGE_EXTENDS_SOCK
@@ -41,12 +42,12 @@
 /// H - Get address by hostname
 static void finger_SCKE_gethostbyname(instructionPointer * ip)
 {
-	char * restrict str = NULL;
+	const char * restrict str = NULL;
 	struct addrinfo hints;
 	struct addrinfo *result = NULL;
 	int retval;
 
-	str = (char*)stack_pop_string(ip->stack, NULL);
+	str = (const char*)stack_pop_string_scratch(ip->stack, NULL);
 
 	memset(&hints, 0, sizeof(struct addrinfo));
 	hints.ai_family = AF_INET;
@@ -70,7 +71,6 @@ static void finger_SCKE_gethostbyname(instructionPointer * ip)
 error:
 	ip_reverse(ip);
 end:
-	stack_free_string(str);
 	if (result)
 		freeaddrinfo(result);
 }
@@ -90,17 +90,14 @@ static void finger_SCKE_peek(instructionPointer * ip)
 		fds.events = POLLIN;
 
 		retval = poll(&fds, 1, 0);
+		// Record the outcome: 0 or 1 to push, -1 to reflect.
+		if (retval > 0)
+			retval = ((fds.revents & POLLIN) != 0) ? 1 : -1;
+		retval = (int)replay_value(replay_event_poll, retval);
 
-		if (retval == -1) {
+		if (retval == -1)
 			goto error;
-		} else if (retval == 0) {
-			stack_push(ip->stack, 0);
-		} else {
-			if ((fds.revents & POLLIN) != 0)
-				stack_push(ip->stack, 1);
-			else
-				goto error;
-		}
+		stack_push(ip->stack, retval);
 	}
 
 	return;
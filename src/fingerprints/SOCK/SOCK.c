@@ -23,6 +23,7 @@
 #define FUNGE_EXTENDS_SOCK
 
 #include "SOCK.h"
+#include "../../replay.h"
 #include "../../stack.h"
 
 #include <unistd.h> /* close, fcntl */
@@ -239,16 +240,15 @@ error:
 /// I - Convert an ASCII IP address to a 32 bit address
 static void finger_SOCK_fromascii(instructionPointer * ip)
 {
-	char * restrict str;
+	const char * restrict str;
 	struct in_addr addr;
 
-	str = (char*)stack_pop_string(ip->stack, NULL);
+	str = (const char*)stack_pop_string_scratch(ip->stack, NULL);
 	if (inet_pton(AF_INET, str, &addr) != 1) {
 		ip_reverse(ip);
 	} else {
 		stack_push(ip->stack, (funge_cell)addr.s_addr);
 	}
-	stack_free_string(str);
 
 }
 
@@ -340,11 +340,16 @@ static void finger_SOCK_receive(instructionPointer * ip)
 	v.x += ip->storageOffset.x;
 	v.y += ip->storageOffset.y;
 
-	buffer = malloc((size_t)len * sizeof(unsigned char));
-	if (FUNGE_UNLIKELY(!buffer))
-		goto error;
+	if (FUNGE_UNLIKELY(replay_playing())) {
+		got = replay_read_bytes(replay_event_recv, &buffer);
+	} else {
+		buffer = malloc((size_t)len * sizeof(unsigned char));
+		if (FUNGE_UNLIKELY(!buffer))
+			goto error;
 
-	got = recv(sockets[s]->fd, buffer, (size_t)len, 0);
+		got = recv(sockets[s]->fd, buffer, (size_t)len, 0);
+		replay_write_bytes(replay_event_recv, buffer, got);
+	}
 
 	stack_push(ip->stack, (funge_cell)got);
 
@@ -0,0 +1,12 @@
+%fingerprint-spec 1.4
+%fprint:STAT
+%url:https://github.com/VorpalBlade/cfunge
+%condition:!defined(DISABLE_STATS)
+%desc:cfunge runtime statistics
+%safe:true
+%begin-instrs
+#I Name              Desc
+C  counter           Push value of statistic n
+N  count             Push number of statistics
+R  reset             Reset the counters to zero
+%end
@@ -0,0 +1,63 @@
+/* -*- mode: C; coding: utf-8; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*-
+ *
+ * cfunge - A standard-conforming Befunge93/98/109 interpreter in C.
+ * Copyright (C) 2008-2013 Arvid Norlander <VorpalBlade AT users.noreply.github.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at the proxy's option) any later version. Arvid Norlander is a
+ * proxy who can decide which future versions of the GNU General Public
+ * License can be used.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "STAT.h"
+#if !defined(DISABLE_STATS)
+#include "../../stack.h"
+#include "../../stats.h"
+
+/// C - Push value of statistic n
+static void finger_STAT_counter(instructionPointer * ip)
+{
+	funge_cell n = stack_pop(ip->stack);
+	uint64_t value;
+
+	if (n < 0 || n >= stat_count) {
+		ip_reverse(ip);
+		return;
+	}
+	value = stats_get((fungeStat)n);
+	// Saturate rather than wrap to negative values.
+	if (value > FUNGECELL_MAX)
+		value = FUNGECELL_MAX;
+	stack_push(ip->stack, (funge_cell)value);
+}
+
+/// N - Push number of statistics
+static void finger_STAT_count(instructionPointer * ip)
+{
+	stack_push(ip->stack, stat_count);
+}
+
+/// R - Reset the counters to zero
+static void finger_STAT_reset(FUNGE_ATTR_UNUSED instructionPointer * ip)
+{
+	stats_reset();
+}
+
+bool finger_STAT_load(instructionPointer * ip)
+{
+	manager_add_opcode(STAT, 'C', counter);
+	manager_add_opcode(STAT, 'N', count);
+	manager_add_opcode(STAT, 'R', reset);
+	return true;
+}
+#endif /* !defined(DISABLE_STATS) */
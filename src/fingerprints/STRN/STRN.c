@@ -22,6 +22,7 @@
 #include "STRN.h"
 #include "../../stack.h"
 #include "../../input.h"
+#include "../../output.h"
 
 #include <stdlib.h> /* atoi */
 #include <string.h>
@@ -33,83 +34,61 @@
 /// A - Append bottom string to upper string
 static void finger_STRN_append(instructionPointer * ip)
 {
-	funge_cell * top;
-	funge_cell * restrict bottom;
-	funge_cell * c = NULL;
-	size_t top_len;
-	size_t bottom_len;
+	static const funge_cell zero = 0;
+	size_t top_len = stack_strlen(ip->stack);
 
-	top = stack_pop_string_multibyte(ip->stack, &top_len);
-	bottom = stack_pop_string_multibyte(ip->stack, &bottom_len);
-	if (FUNGE_UNLIKELY(!top || !bottom)) {
-		goto error;
+	// On the stack the result looks like the bottom string with the upper
+	// string above it, so just remove the 0 between them.
+	if (top_len < ip->stack->top) {
+		funge_cell terminator;
+		stack_remove(ip->stack, top_len, &terminator, 1);
 	}
-
-	c = realloc(top, (top_len + bottom_len + 1) * sizeof(funge_cell));
-	if (FUNGE_UNLIKELY(!c)) {
-		goto error;
-	}
-	memcpy(c + top_len, bottom, bottom_len * sizeof(funge_cell));
-	c[top_len + bottom_len] = '\0';
-
-	stack_push_string_multibyte(ip->stack, c, bottom_len + top_len);
-
-	stack_free_string(bottom);
-	free(c);
-	return;
-error:
-	ip_reverse(ip);
-	if (top)
-		stack_free_string(top);
-	if (bottom)
-		stack_free_string(bottom);
+	// If the strings reached the bottom of the stack there is no 0 below
+	// them.
+	if (stack_strlen(ip->stack) == ip->stack->top)
+		stack_insert(ip->stack, ip->stack->top, &zero, 1);
 }
 
 /// C - Compare strings
 static void finger_STRN_compare(instructionPointer * ip)
 {
-	funge_cell * restrict a;
-	funge_cell * restrict b;
-	size_t alen = 0, blen = 0, minlen;
+	funge_string_view a, b;
+	size_t minlen;
 	funge_cell comparsion = 0;
 
-	a = stack_pop_string_multibyte(ip->stack, &alen);
-	b = stack_pop_string_multibyte(ip->stack, &blen);
+	a = stack_pop_string_view(ip->stack);
+	b = stack_pop_string_view(ip->stack);
 
-	if (FUNGE_UNLIKELY(!a || !b)) {
-		// Ok even if NULL.
-		stack_free_string(a);
-		stack_free_string(b);
-		ip_reverse(ip);
-		return;
-	}
-
-	minlen = (alen < blen) ? alen : blen;
+	minlen = (a.len < b.len) ? a.len : b.len;
 
-	for (size_t i = 0; i < minlen + 1; i++) {
-		funge_cell diff = a[i] - b[i];
+	for (size_t i = 0; i < minlen; i++) {
+		funge_cell diff = stack_view_char(ip->stack, a, i) - stack_view_char(ip->stack, b, i);
 		if (diff != 0) {
 			comparsion = diff;
 			break;
 		}
 	}
+	// Compare against the 0 at the end of the shorter string.
+	if (comparsion == 0 && a.len != b.len) {
+		if (a.len > b.len)
+			comparsion = stack_view_char(ip->stack, a, minlen);
+		else
+			comparsion = 0 - stack_view_char(ip->stack, b, minlen);
+	}
 
 	stack_push(ip->stack, comparsion);
-	stack_free_string(a);
-	stack_free_string(b);
 }
 
 /// D - Display a string
 static void finger_STRN_display(instructionPointer * ip)
 {
-	unsigned char * restrict s;
-	s = stack_pop_string(ip->stack, NULL);
+	const unsigned char * restrict s;
+	s = stack_pop_string_scratch(ip->stack, NULL);
 	if (FUNGE_UNLIKELY(!s)) {
 		ip_reverse(ip);
 		return;
 	}
-	fputs((char*)s, stdout);
-	stack_free_string(s);
+	output_string((const char*)s);
 }
 
 /// F - Search for bottom string in upper string
@@ -205,48 +184,38 @@ static void finger_STRN_input(instructionPointer * ip)
 static void finger_STRN_left(instructionPointer * ip)
 {
 	funge_cell n;
-	size_t len;
-	funge_cell *s;
+	funge_string_view s;
 	n = stack_pop(ip->stack);
-	s = stack_pop_string_multibyte(ip->stack, &len);
+	s = stack_pop_string_view(ip->stack);
 	if (n < 0) {
-		stack_free_string(s);
 		ip_reverse(ip);
 		return;
 	}
-	if (n == 0) {
-		stack_push(ip->stack, '\0');
-		stack_free_string(s);
-		return;
-	}
-	if (len < (size_t)n) {
-		n = len;
+	if (s.len < (size_t)n) {
+		n = (funge_cell)s.len;
 	}
-	stack_push(ip->stack, '\0');
-	stack_push_string_multibyte(ip->stack, s, (size_t)(n - 1));
-	stack_free_string(s);
+	stack_push_string_view(ip->stack, &s, 0, (size_t)n);
 }
 
 /// M - n characters starting at position p
 static void finger_STRN_slice(instructionPointer * ip)
 {
 	funge_cell n, p;
-	funge_cell *s;
-	size_t slen;
+	funge_string_view s;
+	size_t rest;
 	n = stack_pop(ip->stack);
 	p = stack_pop(ip->stack);
-	s = stack_pop_string_multibyte(ip->stack, &slen);
-	if (p < 0 || n < 0 || slen < (size_t)p) {
-		stack_free_string(s);
+	s = stack_pop_string_view(ip->stack);
+	if (p < 0 || n < 0 || s.len < (size_t)p) {
 		ip_reverse(ip);
 		return;
 	}
-	if (slen < (size_t)(p + n)) {
-		n = slen - p;
-	}
-	s[p + n] = '\0';
-	stack_push_string_multibyte(ip->stack, s + p, slen - p);
-	stack_free_string(s);
+	rest = s.len - (size_t)p;
+	stack_push_string_view(ip->stack, &s, (size_t)p, rest);
+	// The rest of the string after the slice is left below it, cut it off
+	// with a 0.
+	if ((size_t)n < rest)
+		ip->stack->entries[ip->stack->top - 1 - (size_t)n] = '\0';
 }
 
 /// N - Get length of string
@@ -277,20 +246,17 @@ static void finger_STRN_put(instructionPointer * ip)
 static void finger_STRN_right(instructionPointer * ip)
 {
 	funge_cell n;
-	size_t len;
-	funge_cell *s;
+	funge_string_view s;
 	n = stack_pop(ip->stack);
-	s = stack_pop_string_multibyte(ip->stack, &len);
+	s = stack_pop_string_view(ip->stack);
 	if (n < 0) {
-		stack_free_string(s);
 		ip_reverse(ip);
 		return;
 	}
-	if (len < (size_t)n) {
-		n = len;
+	if (s.len < (size_t)n) {
+		n = (funge_cell)s.len;
 	}
-	stack_push_string_multibyte(ip->stack, s + (len - (size_t)n), (size_t)n);
-	stack_free_string(s);
+	stack_push_string_view(ip->stack, &s, s.len - (size_t)n, (size_t)n);
 }
 
 /// S - String representation of a number
@@ -314,14 +280,13 @@ static void finger_STRN_itoa(instructionPointer * ip)
 /// V - Retrieve value from string
 static void finger_STRN_atoi(instructionPointer * ip)
 {
-	unsigned char *s;
-	s = stack_pop_string(ip->stack, NULL);
+	const unsigned char *s;
+	s = stack_pop_string_scratch(ip->stack, NULL);
 	if (FUNGE_UNLIKELY(!s)) {
 		ip_reverse(ip);
 		return;
 	}
-	stack_push(ip->stack, FUNGE_ATOI((char*)s));
-	stack_free_string(s);
+	stack_push(ip->stack, FUNGE_ATOI((const char*)s));
 }
 
 bool finger_STRN_load(instructionPointer * ip)
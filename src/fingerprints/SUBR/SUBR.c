@@ -38,7 +38,7 @@ static void finger_SUBR_call(instructionPointer * ip)
 {
 	funge_cell n;
 	funge_vector pos;
-	funge_stack *tmpstack;
+	funge_cell frame[4];
 
 	n = stack_pop(ip->stack);
 	if (n < 0) {
@@ -53,17 +53,12 @@ static void finger_SUBR_call(instructionPointer * ip)
 		pos.y += ip->storageOffset.y;
 	}
 
-	// FIXME: Use a faster bulk copy for stack below.
-	tmpstack = stack_create();
-
-	for (funge_cell i = 0; i < n; ++i)
-		stack_push(tmpstack, stack_pop(ip->stack));
-
-	stack_push_vector(ip->stack, &ip->position);
-	stack_push_vector(ip->stack, &ip->delta);
-	while (n--)
-		stack_push(ip->stack, stack_pop(tmpstack));
-	stack_free(tmpstack);
+	// Put the return position and delta below the arguments.
+	frame[0] = ip->position.x;
+	frame[1] = ip->position.y;
+	frame[2] = ip->delta.x;
+	frame[3] = ip->delta.y;
+	stack_insert(ip->stack, (size_t)n, frame, 4);
 
 	ip_set_position(ip, &pos);
 	ip->delta = SUBRnewDelta;
@@ -97,8 +92,7 @@ static void finger_SUBR_return(instructionPointer * ip)
 {
 	funge_cell n;
 	funge_vector pos;
-	funge_vector vec;
-	funge_stack *tmpstack;
+	funge_cell frame[4];
 
 	n = stack_pop(ip->stack);
 	if (n < 0) {
@@ -106,21 +100,13 @@ static void finger_SUBR_return(instructionPointer * ip)
 		return;
 	}
 
-	// FIXME: Use a faster bulk copy for stack below.
-	tmpstack = stack_create();
-
-	for (funge_cell i = 0; i < n; ++i)
-		stack_push(tmpstack, stack_pop(ip->stack));
-
-	vec = stack_pop_vector(ip->stack);
-	pos = stack_pop_vector(ip->stack);
+	// Get the return position and delta from below the return values.
+	stack_remove(ip->stack, (size_t)n, frame, 4);
+	pos.x = frame[0];
+	pos.y = frame[1];
 	ip_set_position(ip, &pos);
-	ip->delta = vec;
-
-	while (n--)
-		stack_push(ip->stack, stack_pop(tmpstack));
-
-	stack_free(tmpstack);
+	ip->delta.x = frame[2];
+	ip->delta.y = frame[3];
 }
 
 
@@ -25,6 +25,7 @@
 
 #if defined(HAVE_NCURSES)
 
+#include "../../output.h"
 #include "../../stack.h"
 
 #include <unistd.h>
@@ -60,10 +61,21 @@ static bool term_initialised = false;
 
 #define valid(s) (((s) != 0) && (s) != (char *)-1)
 
+/// Output function for tputs(), goes through the output buffer so escape
+/// sequences stay in order with other output.
+static int term_putc(int c)
+{
+	output_putchar(c);
+	return c;
+}
+
+/// Like putp(), but using the output buffer.
+#define term_putp(m_str) tputs((m_str), 1, term_putc)
+
 /// C - Clear screen
 static void finger_TERM_clear_screen(FUNGE_ATTR_UNUSED instructionPointer * ip)
 {
-	putp(clear_screen);
+	term_putp(clear_screen);
 }
 
 /// D - Move cursor down n lines
@@ -75,10 +87,10 @@ static void finger_TERM_go_down(instructionPointer * ip)
 	}
 	if (n < 0) {
 		while (n++)
-			putp(cursor_up);
+			term_putp(cursor_up);
 	} else {
 		while (n--)
-			putp(cursor_down);
+			term_putp(cursor_down);
 	}
 }
 
@@ -94,25 +106,25 @@ static void finger_TERM_goto_xy(instructionPointer * ip)
 		ip_reverse(ip);
 		return;
 	}
-	putp(s);
+	term_putp(s);
 }
 
 /// H - Move cursor to home
 static void finger_TERM_go_home(FUNGE_ATTR_UNUSED instructionPointer * ip)
 {
-	putp(cursor_home);
+	term_putp(cursor_home);
 }
 
 /// L - Clear from cursor to end of line
 static void finger_TERM_clear_to_eol(FUNGE_ATTR_UNUSED instructionPointer * ip)
 {
-	putp(clr_eol);
+	term_putp(clr_eol);
 }
 
 /// S - Clear from cursor to end of screen
 static void finger_TERM_clear_to_eos(FUNGE_ATTR_UNUSED instructionPointer * ip)
 {
-	putp(clr_eos);
+	term_putp(clr_eos);
 }
 
 /// U - Move cursor up n lines
@@ -124,10 +136,10 @@ static void finger_TERM_go_up(instructionPointer * ip)
 	}
 	if (n < 0) {
 		while (n++)
-			putp(cursor_down);
+			term_putp(cursor_down);
 	} else {
 		while (n--)
-			putp(cursor_up);
+			term_putp(cursor_up);
 	}
 }
 
@@ -144,7 +156,7 @@ static void finalise(void)
 			return;
 	// Make some static analysers less confused.
 	assert(cur_term != NULL);
-	putp(exit_ca_mode);
+	term_putp(exit_ca_mode);
 	del_curterm(cur_term);
 }
 #endif
@@ -161,7 +173,7 @@ static inline bool initialise(void)
 			return false;
 	}
 #ifdef TERM_CAP_CORRECT
-	putp(enter_ca_mode);
+	term_putp(enter_ca_mode);
 	atexit(finalise);
 #endif
 	term_initialised = true;
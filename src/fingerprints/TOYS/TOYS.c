@@ -322,8 +322,7 @@ static void finger_TOYS_barstool(instructionPointer * ip)
 /// U - tumbler (Like ? but replaces instruction with said random choice)
 static void finger_TOYS_tumbler(instructionPointer * ip)
 {
-	funge_unsigned_cell rnd = prng_generate_unsigned(4);
-	switch (rnd) {
+	switch (prng_generate_direction()) {
 		case 0: fungespace_set('^', &ip->position); ip_go_north(ip); break;
 		case 1: fungespace_set('>', &ip->position); ip_go_east(ip); break;
 		case 2: fungespace_set('v', &ip->position); ip_go_south(ip); break;
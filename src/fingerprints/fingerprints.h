@@ -33,6 +33,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "3DPT/3DPT.h"
 #include "3DSP/3DSP.h"
 #include "BASE/BASE.h"
 #include "BOOL/BOOL.h"
@@ -42,9 +43,11 @@
 #include "FILE/FILE.h"
 #include "FING/FING.h"
 #include "FIXP/FIXP.h"
+#include "FPAR/FPAR.h"
 #include "FPDP/FPDP.h"
 #include "FPSP/FPSP.h"
 #include "FRTH/FRTH.h"
+#include "HMAP/HMAP.h"
 #include "HRTI/HRTI.h"
 #include "INDV/INDV.h"
 #include "JSTR/JSTR.h"
@@ -54,10 +57,13 @@
 #include "ORTH/ORTH.h"
 #include "PERL/PERL.h"
 #include "REFC/REFC.h"
+#include "REXH/REXH.h"
 #include "REXP/REXP.h"
 #include "ROMA/ROMA.h"
+#include "ROPE/ROPE.h"
 #include "SCKE/SCKE.h"
 #include "SOCK/SOCK.h"
+#include "STAT/STAT.h"
 #include "STRN/STRN.h"
 #include "SUBR/SUBR.h"
 #include "TERM/TERM.h"
@@ -70,127 +76,152 @@ typedef struct s_ImplementedFingerprintEntry {
 	const char            * uri;      /**< URI, used for Funge-109. */
 	const fingerprintLoader loader;   /**< Loader function pointer. */
 	const char            * opcodes;  /**< Sorted string with all implemented opcodes. */
+	const uint32_t          opcodemask; /**< Same as opcodes, bit n is set for instruction 'A' + n. */
 	const char            * url;      /**< URL, used to show links for more info about fingerprints. */
 	const bool              safe;     /**< If true, this fingerprint is safe in sandbox mode. */
 } ImplementedFingerprintEntry;
 
 // Implemented fingerprints
-// NOTE: Keep sorted!
+// NOTE: Keep sorted! Lookup is a binary search on fprint.
 // Also note that this table is processed by scripts, so keep the .loader and
 // .opcodes entries on the same line! As well as in current format.
 static const ImplementedFingerprintEntry ImplementedFingerprints[] = {
+#if !defined(CFUN_NO_FLOATS)
+	// 3DPT - cfunge transforms of many 3DSP points at once
+	{ .fprint = 0x33445054, .uri = NULL, .loader = &finger_3DPT_load, .opcodes = "TVX",
+	  .opcodemask = 0x0a80000, .url = "https://github.com/VorpalBlade/cfunge", .safe = true },
+#endif
 #if !defined(CFUN_NO_FLOATS)
 	// 3DSP - 3D space manipulation extension
 	{ .fprint = 0x33445350, .uri = NULL, .loader = &finger_3DSP_load, .opcodes = "ABCDLMNPRSTUVXYZ",
-	  .url = "http://rcfunge98.com/rcsfingers.html#3DSP", .safe = true },
+	  .opcodemask = 0x3beb80f, .url = "http://rcfunge98.com/rcsfingers.html#3DSP", .safe = true },
 #endif
 #if !defined(CFUN_NO_FLOATS)
 	// BASE - I/O for numbers in other bases
 	{ .fprint = 0x42415345, .uri = NULL, .loader = &finger_BASE_load, .opcodes = "BHINO",
-	  .url = "http://rcfunge98.com/rcsfingers.html#BASE", .safe = true },
+	  .opcodemask = 0x0006182, .url = "http://rcfunge98.com/rcsfingers.html#BASE", .safe = true },
 #endif
 	// BOOL - Logic Functions
 	{ .fprint = 0x424f4f4c, .uri = NULL, .loader = &finger_BOOL_load, .opcodes = "ANOX",
-	  .url = "http://rcfunge98.com/rcsfingers.html#BOOL", .safe = true },
+	  .opcodemask = 0x0806001, .url = "http://rcfunge98.com/rcsfingers.html#BOOL", .safe = true },
 #if !defined(CFUN_NO_FLOATS)
 	// CPLI - Complex Integer extension
 	{ .fprint = 0x43504c49, .uri = NULL, .loader = &finger_CPLI_load, .opcodes = "ADMOSV",
-	  .url = "http://rcfunge98.com/rcsfingers.html#CPLI", .safe = true },
+	  .opcodemask = 0x0245009, .url = "http://rcfunge98.com/rcsfingers.html#CPLI", .safe = true },
 #endif
 #if !defined(CFUN_NO_FLOATS)
 	// DATE - Date Functions
 	{ .fprint = 0x44415445, .uri = NULL, .loader = &finger_DATE_load, .opcodes = "ACDJTWY",
-	  .url = "http://rcfunge98.com/rcsfingers.html#DATE", .safe = true },
+	  .opcodemask = 0x148020d, .url = "http://rcfunge98.com/rcsfingers.html#DATE", .safe = true },
 #endif
 	// DIRF - Directory functions extension
 	{ .fprint = 0x44495246, .uri = NULL, .loader = &finger_DIRF_load, .opcodes = "CMR",
-	  .url = "http://rcfunge98.com/rcsfingers.html", .safe = false },
+	  .opcodemask = 0x0021004, .url = "http://rcfunge98.com/rcsfingers.html", .safe = false },
 	// FILE - File I/O functions
 	{ .fprint = 0x46494c45, .uri = NULL, .loader = &finger_FILE_load, .opcodes = "CDGLOPRSW",
-	  .url = "http://rcfunge98.com/rcsfingers.html", .safe = false },
+	  .opcodemask = 0x046c84c, .url = "http://rcfunge98.com/rcsfingers.html", .safe = false },
 	// FING - Operate on single fingerprint semantics
 	{ .fprint = 0x46494e47, .uri = NULL, .loader = &finger_FING_load, .opcodes = "XYZ",
-	  .url = "http://rcfunge98.com/rcsfingers.html#FING", .safe = true },
+	  .opcodemask = 0x3800000, .url = "http://rcfunge98.com/rcsfingers.html#FING", .safe = true },
 #if !defined(CFUN_NO_FLOATS)
 	// FIXP - Some useful math functions
 	{ .fprint = 0x46495850, .uri = NULL, .loader = &finger_FIXP_load, .opcodes = "ABCDIJNOPQRSTUVX",
-	  .url = "http://rcfunge98.com/rcsfingers.html#FIXP", .safe = true },
+	  .opcodemask = 0x0bfe30f, .url = "http://rcfunge98.com/rcsfingers.html#FIXP", .safe = true },
+#endif
+#if !defined(CFUN_NO_FLOATS)
+	// FPAR - cfunge arrays of double precision floating point numbers
+	{ .fprint = 0x46504152, .uri = NULL, .loader = &finger_FPAR_load, .opcodes = "ABCDEFIKLMNPQSUXY",
+	  .opcodemask = 0x195bd3f, .url = "https://github.com/VorpalBlade/cfunge", .safe = true },
 #endif
 #if !defined(CFUN_NO_FLOATS)
 	// FPDP - Double precision floating point
 	{ .fprint = 0x46504450, .uri = NULL, .loader = &finger_FPDP_load, .opcodes = "ABCDEFGHIKLMNPQRSTVXY",
-	  .url = "http://rcfunge98.com/rcsfingers.html#FPDP", .safe = true },
+	  .opcodemask = 0x1afbdff, .url = "http://rcfunge98.com/rcsfingers.html#FPDP", .safe = true },
 #endif
 #if !defined(CFUN_NO_FLOATS)
 	// FPSP - Single precision floating point
 	{ .fprint = 0x46505350, .uri = NULL, .loader = &finger_FPSP_load, .opcodes = "ABCDEFGHIKLMNPQRSTVXY",
-	  .url = "http://rcfunge98.com/rcsfingers.html#FPSP", .safe = true },
+	  .opcodemask = 0x1afbdff, .url = "http://rcfunge98.com/rcsfingers.html#FPSP", .safe = true },
 #endif
 	// FRTH - Some common forth commands
 	{ .fprint = 0x46525448, .uri = NULL, .loader = &finger_FRTH_load, .opcodes = "DLOPR",
-	  .url = "http://rcfunge98.com/rcsfingers.html", .safe = true },
+	  .opcodemask = 0x002c808, .url = "http://rcfunge98.com/rcsfingers.html", .safe = true },
+	// HMAP - cfunge hash maps from cells to cells
+	{ .fprint = 0x484d4150, .uri = NULL, .loader = &finger_HMAP_load, .opcodes = "DFGHILNS",
+	  .opcodemask = 0x00429e8, .url = "https://github.com/VorpalBlade/cfunge", .safe = true },
 	// HRTI - High-Resolution Timer Interface
 	{ .fprint = 0x48525449, .uri = NULL, .loader = &finger_HRTI_load, .opcodes = "EGMST",
-	  .url = "http://catseye.tc/projects/funge98/library/HRTI.html", .safe = true },
+	  .opcodemask = 0x00c1050, .url = "http://catseye.tc/projects/funge98/library/HRTI.html", .safe = true },
 	// INDV - Pointer functions
 	{ .fprint = 0x494e4456, .uri = NULL, .loader = &finger_INDV_load, .opcodes = "GPVW",
-	  .url = "http://rcfunge98.com/rcsfingers.html", .safe = true },
+	  .opcodemask = 0x0608040, .url = "http://rcfunge98.com/rcsfingers.html", .safe = true },
 	// JSTR - Read and write strings in Funge-Space
 	{ .fprint = 0x4a535452, .uri = NULL, .loader = &finger_JSTR_load, .opcodes = "GP",
-	  .url = "http://www.imaginaryrobots.net/projects/funge/myexts.txt", .safe = true },
+	  .opcodemask = 0x0008040, .url = "http://www.imaginaryrobots.net/projects/funge/myexts.txt", .safe = true },
 	// MODU - Modulo Arithmetic
 	{ .fprint = 0x4d4f4455, .uri = NULL, .loader = &finger_MODU_load, .opcodes = "MRU",
-	  .url = "http://catseye.tc/projects/funge98/library/MODU.html", .safe = true },
+	  .opcodemask = 0x0121000, .url = "http://catseye.tc/projects/funge98/library/MODU.html", .safe = true },
 #if defined(HAVE_NCURSES)
 	// NCRS - ncurses extension
 	{ .fprint = 0x4e435253, .uri = NULL, .loader = &finger_NCRS_load, .opcodes = "BCEGIKMNPRSU",
-	  .url = "http://www.imaginaryrobots.net/projects/funge/myexts.txt", .safe = true },
+	  .opcodemask = 0x016b556, .url = "http://www.imaginaryrobots.net/projects/funge/myexts.txt", .safe = true },
 #endif
 	// NULL - Null Fingerprint
 	{ .fprint = 0x4e554c4c, .uri = NULL, .loader = &finger_NULL_load, .opcodes = "ABCDEFGHIJKLMNOPQRSTUVWXYZ",
-	  .url = "http://catseye.tc/projects/funge98/library/NULL.html", .safe = true },
+	  .opcodemask = 0x3ffffff, .url = "http://catseye.tc/projects/funge98/library/NULL.html", .safe = true },
 	// ORTH - Orthogonal Easement Library
 	{ .fprint = 0x4f525448, .uri = NULL, .loader = &finger_ORTH_load, .opcodes = "AEGOPSVWXYZ",
-	  .url = "http://catseye.tc/projects/funge98/library/ORTH.html", .safe = true },
+	  .opcodemask = 0x3e4c051, .url = "http://catseye.tc/projects/funge98/library/ORTH.html", .safe = true },
 	// PERL - Generic Interface to the Perl Language
 	{ .fprint = 0x5045524c, .uri = NULL, .loader = &finger_PERL_load, .opcodes = "EIS",
-	  .url = "http://catseye.tc/projects/funge98/library/PERL.html", .safe = false },
+	  .opcodemask = 0x0040110, .url = "http://catseye.tc/projects/funge98/library/PERL.html", .safe = false },
 	// REFC - Referenced Cells Extension
 	{ .fprint = 0x52454643, .uri = NULL, .loader = &finger_REFC_load, .opcodes = "DR",
-	  .url = "http://catseye.tc/projects/funge98/library/REFC.html", .safe = true },
+	  .opcodemask = 0x0020008, .url = "http://catseye.tc/projects/funge98/library/REFC.html", .safe = true },
+	// REXH - cfunge handles to compiled regular expressions
+	{ .fprint = 0x52455848, .uri = NULL, .loader = &finger_REXH_load, .opcodes = "CEFT",
+	  .opcodemask = 0x0080034, .url = "https://github.com/VorpalBlade/cfunge", .safe = true },
 	// REXP - Regular Expression Matching
 	{ .fprint = 0x52455850, .uri = NULL, .loader = &finger_REXP_load, .opcodes = "CEF",
-	  .url = "http://rcfunge98.com/rcsfingers.html#REXP", .safe = true },
+	  .opcodemask = 0x0000034, .url = "http://rcfunge98.com/rcsfingers.html#REXP", .safe = true },
 	// ROMA - Roman Numerals
 	{ .fprint = 0x524f4d41, .uri = NULL, .loader = &finger_ROMA_load, .opcodes = "CDILMVX",
-	  .url = "http://catseye.tc/projects/funge98/library/ROMA.html", .safe = true },
+	  .opcodemask = 0x0a0190c, .url = "http://catseye.tc/projects/funge98/library/ROMA.html", .safe = true },
+	// ROPE - cfunge string handles stored as ropes
+	{ .fprint = 0x524f5045, .uri = NULL, .loader = &finger_ROPE_load, .opcodes = "ACFIMNPS",
+	  .opcodemask = 0x004b125, .url = "https://github.com/VorpalBlade/cfunge", .safe = true },
 	// SCKE - TCP/IP async socket and dns resolving extension
 	{ .fprint = 0x53434b45, .uri = NULL, .loader = &finger_SCKE_load, .opcodes = "HP",
-	  .url = "http://glfunge98.sourceforge.net/", .safe = false },
+	  .opcodemask = 0x0008080, .url = "http://glfunge98.sourceforge.net/", .safe = false },
 	// SOCK - TCP/IP socket extension
 	{ .fprint = 0x534f434b, .uri = NULL, .loader = &finger_SOCK_load, .opcodes = "ABCIKLORSW",
-	  .url = "http://rcfunge98.com/rcsfingers.html#SOCK", .safe = false },
+	  .opcodemask = 0x0464d07, .url = "http://rcfunge98.com/rcsfingers.html#SOCK", .safe = false },
+#if !defined(DISABLE_STATS)
+	// STAT - cfunge runtime statistics
+	{ .fprint = 0x53544154, .uri = NULL, .loader = &finger_STAT_load, .opcodes = "CNR",
+	  .opcodemask = 0x0022004, .url = "https://github.com/VorpalBlade/cfunge", .safe = true },
+#endif
 	// STRN - String functions
 	{ .fprint = 0x5354524e, .uri = NULL, .loader = &finger_STRN_load, .opcodes = "ACDFGILMNPRSV",
-	  .url = "http://rcfunge98.com/rcsfingers.html", .safe = true },
+	  .opcodemask = 0x026b96d, .url = "http://rcfunge98.com/rcsfingers.html", .safe = true },
 	// SUBR - Subroutine extension
 	{ .fprint = 0x53554252, .uri = NULL, .loader = &finger_SUBR_load, .opcodes = "ACJOR",
-	  .url = "http://rcfunge98.com/rcsfingers.html", .safe = true },
+	  .opcodemask = 0x0024205, .url = "http://rcfunge98.com/rcsfingers.html", .safe = true },
 #if defined(HAVE_NCURSES)
 	// TERM - Terminal control functions
 	{ .fprint = 0x5445524d, .uri = NULL, .loader = &finger_TERM_load, .opcodes = "CDGHLSU",
-	  .url = "http://rcfunge98.com/rcsfingers.html", .safe = true },
+	  .opcodemask = 0x01408cc, .url = "http://rcfunge98.com/rcsfingers.html", .safe = true },
 #endif
 	// TIME - Time and Date functions
 	{ .fprint = 0x54494d45, .uri = NULL, .loader = &finger_TIME_load, .opcodes = "DFGHLMOSWY",
-	  .url = "http://rcfunge98.com/rcsfingers.html", .safe = true },
+	  .opcodemask = 0x14458e8, .url = "http://rcfunge98.com/rcsfingers.html", .safe = true },
 	// TOYS - Funge-98 Standard Toys
 	{ .fprint = 0x544f5953, .uri = NULL, .loader = &finger_TOYS_load, .opcodes = "ABCDEFGHIJKLMNOPQRSTUVWXYZ",
-	  .url = "http://catseye.tc/projects/funge98/library/TOYS.html", .safe = true },
+	  .opcodemask = 0x3ffffff, .url = "http://catseye.tc/projects/funge98/library/TOYS.html", .safe = true },
 #if !defined(CFUN_NO_FLOATS) && !defined(CFUN_NO_TURT)
 	// TURT - Simple Turtle Graphics Library
 	{ .fprint = 0x54555254, .uri = NULL, .loader = &finger_TURT_load, .opcodes = "ABCDEFHILNPQRTU",
-	  .url = "http://catseye.tc/projects/funge98/library/TURT.html", .safe = true },
+	  .opcodemask = 0x01ba9bf, .url = "http://catseye.tc/projects/funge98/library/TURT.html", .safe = true },
 #endif
 };
 
@@ -22,7 +22,10 @@
 #include "../global.h"
 #include "manager.h"
 #include "../ip.h"
+#include "../image.h"
+#include "../interpreter.h"
 #include "../settings.h"
+#include "../stats.h"
 #include "../diagnostic.h"
 
 #include <assert.h>
@@ -30,7 +33,7 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h> /* exit */
-#include <string.h> /* memcpy, strlen */
+#include <string.h> /* memcpy, memset */
 
 
 #define ALLOCCHUNKSIZE 2
@@ -45,27 +48,102 @@
  * Opcode Stack functions *
  **************************/
 
+/**
+ * Run for instructions A-Z when no fingerprint provides them.
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL
+static inline void opcode_unknown(instructionPointer * restrict ip, unsigned char opcode)
+{
+	warn_unknown_instr((funge_cell)opcode, ip);
+	ip_reverse(ip);
+}
+
+/// Generate the stub for an instruction, used in ip->fingerTop for empty
+/// opcode stacks.
+#define OPCODE_UNKNOWN_STUB(m_opcode) \
+	static void opcode_unknown_ ## m_opcode(instructionPointer * ip) \
+	{ \
+		opcode_unknown(ip, (unsigned char)(#m_opcode)[0]); \
+	}
+
+OPCODE_UNKNOWN_STUB(A) OPCODE_UNKNOWN_STUB(B) OPCODE_UNKNOWN_STUB(C)
+OPCODE_UNKNOWN_STUB(D) OPCODE_UNKNOWN_STUB(E) OPCODE_UNKNOWN_STUB(F)
+OPCODE_UNKNOWN_STUB(G) OPCODE_UNKNOWN_STUB(H) OPCODE_UNKNOWN_STUB(I)
+OPCODE_UNKNOWN_STUB(J) OPCODE_UNKNOWN_STUB(K) OPCODE_UNKNOWN_STUB(L)
+OPCODE_UNKNOWN_STUB(M) OPCODE_UNKNOWN_STUB(N) OPCODE_UNKNOWN_STUB(O)
+OPCODE_UNKNOWN_STUB(P) OPCODE_UNKNOWN_STUB(Q) OPCODE_UNKNOWN_STUB(R)
+OPCODE_UNKNOWN_STUB(S) OPCODE_UNKNOWN_STUB(T) OPCODE_UNKNOWN_STUB(U)
+OPCODE_UNKNOWN_STUB(V) OPCODE_UNKNOWN_STUB(W) OPCODE_UNKNOWN_STUB(X)
+OPCODE_UNKNOWN_STUB(Y) OPCODE_UNKNOWN_STUB(Z)
+
+/// The stubs, indexed by instruction - 'A'.
+static const fingerprintOpcode opcode_unknown_stubs[FINGEROPCODECOUNT] = {
+	&opcode_unknown_A, &opcode_unknown_B, &opcode_unknown_C, &opcode_unknown_D,
+	&opcode_unknown_E, &opcode_unknown_F, &opcode_unknown_G, &opcode_unknown_H,
+	&opcode_unknown_I, &opcode_unknown_J, &opcode_unknown_K, &opcode_unknown_L,
+	&opcode_unknown_M, &opcode_unknown_N, &opcode_unknown_O, &opcode_unknown_P,
+	&opcode_unknown_Q, &opcode_unknown_R, &opcode_unknown_S, &opcode_unknown_T,
+	&opcode_unknown_U, &opcode_unknown_V, &opcode_unknown_W, &opcode_unknown_X,
+	&opcode_unknown_Y, &opcode_unknown_Z
+};
+
+/**
+ * Update ip->fingerTop after the opcode stack at index changed.
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL
+static inline void opcode_stack_sync_top(instructionPointer * restrict ip, size_t index)
+{
+	const fungeOpcodeStacks * stacks = &ip->fingerOpcodes;
+	size_t top = stacks->top[index];
+	if ((top > 0) && stacks->entries[index * stacks->stride + top - 1])
+		ip->fingerTop[index] = stacks->entries[index * stacks->stride + top - 1];
+	else
+		ip->fingerTop[index] = opcode_unknown_stubs[index];
+}
+
+/**
+ * Make room for more entries in each opcode stack. This moves all the stacks
+ * to a new array with twice the stride.
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL FUNGE_ATTR_WARN_UNUSED
+static bool opcode_stacks_grow(fungeOpcodeStacks * restrict stacks)
+{
+	size_t newstride = stacks->stride ? stacks->stride * 2 : ALLOCCHUNKSIZE;
+	fingerprintOpcode *newentries;
+
+	if (FUNGE_UNLIKELY(newstride > SIZE_MAX / (FINGEROPCODECOUNT * sizeof(fingerprintOpcode))))
+		return false;
+	newentries = malloc(newstride * FINGEROPCODECOUNT * sizeof(fingerprintOpcode));
+	if (FUNGE_UNLIKELY(!newentries))
+		return false;
+	if (stacks->entries) {
+		for (size_t i = 0; i < FINGEROPCODECOUNT; i++)
+			memcpy(&newentries[i * newstride], &stacks->entries[i * stacks->stride],
+			       stacks->top[i] * sizeof(fingerprintOpcode));
+		free(stacks->entries);
+	}
+	stacks->entries = newentries;
+	stacks->stride = newstride;
+	return true;
+}
+
 #ifdef CONCURRENT_FUNGE
 /**
- * Duplicate an opcode stack, used for split (t).
+ * Duplicate the opcode stacks, used for split (t).
  */
 FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL
-static inline void opcode_stack_duplicate(const fungeOpcodeStack * restrict old,
-                                          fungeOpcodeStack * restrict new)
+static inline void opcode_stacks_duplicate(const fungeOpcodeStacks * restrict old,
+                                           fungeOpcodeStacks * restrict new)
 {
-	if (old->top) {
-		new->entries = (fingerprintOpcode*)malloc((old->top + 1) * sizeof(fingerprintOpcode));
+	*new = *old;
+	if (old->entries) {
+		size_t length = old->stride * FINGEROPCODECOUNT * sizeof(fingerprintOpcode);
+		new->entries = (fingerprintOpcode*)malloc(length);
 		if (FUNGE_UNLIKELY(!new->entries)) {
 			DIAG_OOM("Couldn't allocate for fingerprint stack");
 		}
-		new->size = old->top + 1;
-		new->top = old->top;
 		// Copy the pointers.
-		memcpy(new->entries, old->entries, new->top * sizeof(fingerprintOpcode));
-	} else {
-		new->entries = NULL;
-		new->top = 0;
-		new->size = 0;
+		memcpy(new->entries, old->entries, length);
 	}
 }
 #endif
@@ -74,32 +152,31 @@ static inline void opcode_stack_duplicate(const fungeOpcodeStack * restrict old,
 FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL FUNGE_ATTR_WARN_UNUSED
 bool opcode_stack_push(instructionPointer * restrict ip, unsigned char opcode, fingerprintOpcode func)
 {
-	fungeOpcodeStack * stack = &ip->fingerOpcodes[opcode - 'A'];
-	// Check if we need to realloc. It may also be that stack->entries is NULL
-	// (both stack->top and stack->size are 0 then.
-	if (stack->top == stack->size) {
-		fingerprintOpcode* newstack = realloc(stack->entries, (stack->size + ALLOCCHUNKSIZE) * sizeof(fingerprintOpcode));
-		if (FUNGE_UNLIKELY(!newstack))
+	fungeOpcodeStacks * stacks = &ip->fingerOpcodes;
+	size_t index = (size_t)(opcode - 'A');
+	// Check if we need to grow. It may also be that stacks->entries is NULL
+	// (stacks->stride is 0 then).
+	if (stacks->top[index] == stacks->stride) {
+		if (FUNGE_UNLIKELY(!opcode_stacks_grow(stacks)))
 			return false;
-		stack->entries = newstack;
-		stack->entries[stack->top] = func;
-		stack->top++;
-		stack->size += ALLOCCHUNKSIZE;
-	} else {
-		stack->entries[stack->top] = func;
-		stack->top++;
 	}
+	stacks->entries[index * stacks->stride + stacks->top[index]] = func;
+	stacks->top[index]++;
+	opcode_stack_sync_top(ip, index);
 	return true;
 }
 
 FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL
 fingerprintOpcode opcode_stack_pop(instructionPointer * restrict ip, unsigned char opcode)
 {
-	fungeOpcodeStack * stack = &ip->fingerOpcodes[opcode - 'A'];
-	if (stack->top == 0) {
+	fungeOpcodeStacks * stacks = &ip->fingerOpcodes;
+	size_t index = (size_t)(opcode - 'A');
+	if (stacks->top[index] == 0) {
 		return NULL;
 	} else {
-		return stack->entries[--stack->top];
+		fingerprintOpcode func = stacks->entries[index * stacks->stride + --stacks->top[index]];
+		opcode_stack_sync_top(ip, index);
+		return func;
 	}
 }
 
@@ -107,12 +184,14 @@ fingerprintOpcode opcode_stack_pop(instructionPointer * restrict ip, unsigned ch
  * Pop a function pointer from an opcode stack, discarding it.
  */
 FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL
-static inline void opcode_stack_drop(fungeOpcodeStack * restrict stack)
+static inline void opcode_stack_drop(instructionPointer * restrict ip, size_t index)
 {
-	if (stack->top == 0) {
+	fungeOpcodeStacks * stacks = &ip->fingerOpcodes;
+	if (stacks->top[index] == 0) {
 		return;
 	} else {
-		stack->top--;
+		stacks->top[index]--;
+		opcode_stack_sync_top(ip, index);
 	}
 }
 
@@ -120,14 +199,21 @@ static inline void opcode_stack_drop(fungeOpcodeStack * restrict stack)
  * Opcode Manager functions *
  ****************************/
 
+FUNGE_ATTR_FAST void manager_create(instructionPointer * restrict ip)
+{
+	// The stacks are never used if fingerprints are disabled.
+	if (FUNGE_LIKELY(!setting_disable_fingerprints)) {
+		memset(&ip->fingerOpcodes, 0, sizeof(fungeOpcodeStacks));
+	}
+	memcpy(ip->fingerTop, opcode_unknown_stubs, sizeof(fingerprintOpcode) * FINGEROPCODECOUNT);
+}
+
 /// Clean up the fingerprint stacks for an IP.
 FUNGE_ATTR_FAST void manager_free(instructionPointer * restrict ip)
 {
 	if (FUNGE_UNLIKELY(!ip))
 		return;
-	for (int i = 0; i < FINGEROPCODECOUNT; i++) {
-		free(ip->fingerOpcodes[i].entries);
-	}
+	free(ip->fingerOpcodes.entries);
 }
 
 #ifdef CONCURRENT_FUNGE
@@ -135,13 +221,83 @@ FUNGE_ATTR_FAST void manager_free(instructionPointer * restrict ip)
 FUNGE_ATTR_FAST void manager_duplicate(const instructionPointer * restrict oldip,
                                        instructionPointer * restrict newip)
 {
-	for (int i = 0; i < FINGEROPCODECOUNT; i++) {
-		opcode_stack_duplicate(&oldip->fingerOpcodes[i], &newip->fingerOpcodes[i]);
-	}
+	opcode_stacks_duplicate(&oldip->fingerOpcodes, &newip->fingerOpcodes);
 }
 #endif
 
 
+/*********************************
+ * Opcode origins, used by images *
+ *********************************/
+
+/**
+ * Where a fingerprint opcode function came from. Function pointers can't be
+ * stored in images, so they are saved as the fingerprint and instruction they
+ * were loaded as instead.
+ */
+typedef struct s_opcodeOrigin {
+	fingerprintOpcode func;   ///< The function.
+	funge_cell        fprint; ///< Fingerprint it was loaded from.
+	unsigned char     opcode; ///< Instruction (A-Z) it was loaded as.
+} opcodeOrigin;
+
+/// Known origins, in the order they were found.
+static opcodeOrigin *opcodeOrigins = NULL;
+static size_t opcodeOriginsTop = 0;
+static size_t opcodeOriginsSize = 0;
+/// Have the origins of a fingerprint (by index) been recorded yet?
+static bool opcodeOriginsRecorded[FPRINT_ARRAY_SIZE];
+
+/// Used for opcodes of unknown origin when loading an image.
+static void manager_reflect(instructionPointer * ip)
+{
+	ip_reverse(ip);
+}
+
+/**
+ * Record the origin of the top entry of each opcode that fingerprint index
+ * has, after it was just loaded into ip.
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL
+static void record_origins(const instructionPointer * restrict ip, size_t index)
+{
+	const char *opcodes = ImplementedFingerprints[index].opcodes;
+
+	opcodeOriginsRecorded[index] = true;
+	for (size_t i = 0; opcodes[i] != '\0'; i++) {
+		const fungeOpcodeStacks *stacks = &ip->fingerOpcodes;
+		size_t opcode = (size_t)(opcodes[i] - 'A');
+		fingerprintOpcode func;
+		bool known = false;
+
+		if (stacks->top[opcode] == 0)
+			continue;
+		func = stacks->entries[opcode * stacks->stride + stacks->top[opcode] - 1];
+		// The first origin found for a function wins.
+		for (size_t j = 0; j < opcodeOriginsTop; j++) {
+			if (opcodeOrigins[j].func == func) {
+				known = true;
+				break;
+			}
+		}
+		if (known)
+			continue;
+		if (opcodeOriginsTop == opcodeOriginsSize) {
+			opcodeOrigin *tmp = realloc(opcodeOrigins, (opcodeOriginsSize + 32) * sizeof(opcodeOrigin));
+			if (FUNGE_UNLIKELY(!tmp)) {
+				// Images will just treat these as unknown.
+				return;
+			}
+			opcodeOrigins = tmp;
+			opcodeOriginsSize += 32;
+		}
+		opcodeOrigins[opcodeOriginsTop].func = func;
+		opcodeOrigins[opcodeOriginsTop].fprint = ImplementedFingerprints[index].fprint;
+		opcodeOrigins[opcodeOriginsTop].opcode = (unsigned char)opcodes[i];
+		opcodeOriginsTop++;
+	}
+}
+
 #define FPRINT_NOTFOUND -1
 /**
  * Return value is index into ImplementedFingerprints array.
@@ -150,17 +306,21 @@ FUNGE_ATTR_FAST void manager_duplicate(const instructionPointer * restrict oldip
 FUNGE_ATTR_FAST FUNGE_ATTR_WARN_UNUSED
 static inline ssize_t find_fingerprint(const funge_cell fingerprint)
 {
-	for (size_t i = 0; i < FPRINT_ARRAY_SIZE; i++) {
-		if (fingerprint <= ImplementedFingerprints[i].fprint) {
-			// Then it is larger... as in "not found"
-			if (fingerprint != ImplementedFingerprints[i].fprint)
-				return FPRINT_NOTFOUND;
+	// Binary search, the table is sorted on fprint.
+	size_t low = 0;
+	size_t high = FPRINT_ARRAY_SIZE;
+
+	while (low < high) {
+		size_t mid = low + (high - low) / 2;
+		if (ImplementedFingerprints[mid].fprint < fingerprint) {
+			low = mid + 1;
+		} else if (ImplementedFingerprints[mid].fprint > fingerprint) {
+			high = mid;
+		} else {
 			// If we run in a sandbox, can fingerprint be loaded?
-			// If not: break, as we know we found the right fingerprint,
-			// so no need to search more.
-			if (setting_enable_sandbox && !ImplementedFingerprints[i].safe)
+			if (setting_enable_sandbox && !ImplementedFingerprints[mid].safe)
 				return FPRINT_NOTFOUND;
-			return (ssize_t)i;
+			return (ssize_t)mid;
 		}
 	}
 	return FPRINT_NOTFOUND;
@@ -174,6 +334,9 @@ FUNGE_ATTR_FAST bool manager_load(instructionPointer * restrict ip, funge_cell f
 	} else {
 		bool gotLoaded = ImplementedFingerprints[index].loader(ip);
 		if (FUNGE_LIKELY(gotLoaded)) {
+			STATS_INC(stat_fingerprint_loads);
+			if (FUNGE_UNLIKELY(!opcodeOriginsRecorded[index]))
+				record_origins(ip, (size_t)index);
 			stack_push(ip->stack, fingerprint);
 			stack_push(ip->stack, 1);
 			return true;
@@ -186,13 +349,116 @@ FUNGE_ATTR_FAST bool manager_load(instructionPointer * restrict ip, funge_cell f
 FUNGE_ATTR_FAST bool manager_unload(instructionPointer * restrict ip, funge_cell fingerprint)
 {
 	ssize_t index = find_fingerprint(fingerprint);
-	size_t max_len;
+	uint32_t mask;
 
 	if (index == FPRINT_NOTFOUND)
 		return false;
-	max_len = strlen(ImplementedFingerprints[index].opcodes);
-	for (size_t i = 0; i < max_len; i++)
-		opcode_stack_drop(&ip->fingerOpcodes[ImplementedFingerprints[index].opcodes[i] - 'A']);
+	mask = ImplementedFingerprints[index].opcodemask;
+	for (size_t i = 0; mask != 0; i++, mask >>= 1) {
+		if (mask & 1)
+			opcode_stack_drop(ip, i);
+	}
+	return true;
+}
+
+/**
+ * Look up a recorded opcode origin.
+ * @return The function, or NULL if not recorded.
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_PURE FUNGE_ATTR_WARN_UNUSED
+static inline fingerprintOpcode lookup_origin(funge_cell fprint, unsigned char opcode)
+{
+	for (size_t i = 0; i < opcodeOriginsTop; i++) {
+		if ((opcodeOrigins[i].fprint == fprint) && (opcodeOrigins[i].opcode == opcode))
+			return opcodeOrigins[i].func;
+	}
+	return NULL;
+}
+
+FUNGE_ATTR_FAST bool manager_opcode_origin(fingerprintOpcode func, funge_cell * restrict fprint,
+                                           unsigned char * restrict opcode)
+{
+	for (size_t i = 0; i < opcodeOriginsTop; i++) {
+		if (opcodeOrigins[i].func == func) {
+			*fprint = opcodeOrigins[i].fprint;
+			*opcode = opcodeOrigins[i].opcode;
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * Find the function for an opcode origin. If the fingerprint wasn't loaded in
+ * this process yet it is loaded into a scratch IP to find it.
+ * @return The function, or manager_reflect() if not found.
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_WARN_UNUSED
+static fingerprintOpcode find_origin(funge_cell fprint, unsigned char opcode)
+{
+	fingerprintOpcode func = lookup_origin(fprint, opcode);
+	ssize_t index;
+
+	if (func)
+		return func;
+	index = find_fingerprint(fprint);
+	if ((index != FPRINT_NOTFOUND) && !opcodeOriginsRecorded[index]) {
+		instructionPointer scratch;
+		memset(&scratch, 0, sizeof(instructionPointer));
+		manager_create(&scratch);
+		if (ImplementedFingerprints[index].loader(&scratch))
+			record_origins(&scratch, (size_t)index);
+		else
+			opcodeOriginsRecorded[index] = true;
+		manager_free(&scratch);
+		free(scratch.fingerHRTItimestamp);
+		func = lookup_origin(fprint, opcode);
+	}
+	return func ? func : &manager_reflect;
+}
+
+FUNGE_ATTR_FAST bool manager_save_image(FILE * restrict file, const instructionPointer * restrict ip)
+{
+	for (int i = 0; i < FINGEROPCODECOUNT; i++) {
+		const fungeOpcodeStacks *stacks = &ip->fingerOpcodes;
+		uint64_t count = setting_disable_fingerprints ? 0 : stacks->top[i];
+
+		if (!image_write_value(file, count))
+			return false;
+		for (size_t j = 0; j < count; j++) {
+			funge_cell fprint = 0;
+			unsigned char opcode = 0;
+			if (!manager_opcode_origin(stacks->entries[(size_t)i * stacks->stride + j], &fprint, &opcode)) {
+				// Unknown, will reflect when loaded.
+				fprint = 0;
+				opcode = 0;
+			}
+			if (!image_write_value(file, fprint) || !image_write_value(file, opcode))
+				return false;
+		}
+	}
+	return true;
+}
+
+FUNGE_ATTR_FAST bool manager_load_image(FILE * restrict file, instructionPointer * restrict ip)
+{
+	for (int i = 0; i < FINGEROPCODECOUNT; i++) {
+		uint64_t count;
+
+		if (!image_read_value(file, count))
+			return false;
+		for (uint64_t j = 0; j < count; j++) {
+			funge_cell fprint;
+			unsigned char opcode;
+			if (!image_read_value(file, fprint) || !image_read_value(file, opcode))
+				return false;
+			// Still need to read them, but there is nowhere to put them.
+			if (setting_disable_fingerprints)
+				continue;
+			if (!opcode_stack_push(ip, (unsigned char)('A' + i), find_origin(fprint, opcode)))
+				return false;
+		}
+	}
 	return true;
 }
 
@@ -32,6 +32,7 @@
 #include <sys/types.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdio.h>
 
 /// Forward decl, see ../ip.h
 struct s_instructionPointer;
@@ -39,22 +40,27 @@ struct s_instructionPointer;
 /// Function prototype for a fingerprint instruction.
 typedef void (*fingerprintOpcode)(struct s_instructionPointer * ip);
 
+/// This is for size of opcode array.
+#define FINGEROPCODECOUNT 26
+
 /**
- * An opcode stack.
+ * The opcode stacks (one for each of A-Z) of an IP.
+ * All stacks share one array, to keep the number of allocations per IP down.
+ * Stack n uses entries[n * stride] up to entries[n * stride + top[n] - 1].
  * @warning
  * Fingerprints should not directly touch these, use the functions below for that.
  */
-typedef struct s_fungeOpcodeStack {
-	/// This is current size of the array entries
-	size_t             size;
-	/// This is current top item in stack (may not be last item)
-	/// Note: One-indexed, as 0 = empty stack.
-	size_t             top;
-	/// Pointer to entries of the stack. Is initialised on demand and may thus
-	/// be NULL before any fingerprint has been loaded that uses this opcode.
-	/// In that case, both size and top are 0.
+typedef struct s_fungeOpcodeStacks {
+	/// Storage for all the stacks. Is initialised on demand and may thus be
+	/// NULL before any fingerprint has been loaded. In that case, stride and
+	/// all of top are 0.
 	fingerprintOpcode *entries;
-} fungeOpcodeStack;
+	/// Number of entries reserved for each stack in entries.
+	size_t             stride;
+	/// This is current top item in each stack.
+	/// Note: One-indexed, as 0 = empty stack.
+	size_t             top[FINGEROPCODECOUNT];
+} fungeOpcodeStacks;
 
 /**
  * Function prototype for fingerprint loader. It should load a fingerprint
@@ -84,6 +90,15 @@ bool opcode_stack_push(struct s_instructionPointer * restrict ip, unsigned char
 FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL
 fingerprintOpcode opcode_stack_pop(struct s_instructionPointer * restrict ip, unsigned char opcode);
 
+/**
+ * Initialise opcode stacks for a new IP. This must be called even when
+ * fingerprints are disabled, to set up the instruction stubs.
+ * @warning Don't call this directly from fingerprints.
+ * @param ip IP to operate on.
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL
+void manager_create(struct s_instructionPointer * restrict ip);
+
 /**
  * Free opcode stacks for IP
  * @warning Don't call this directly from fingerprints.
@@ -125,6 +140,43 @@ bool manager_load(struct s_instructionPointer * restrict ip, funge_cell fingerpr
 FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL FUNGE_ATTR_WARN_UNUSED
 bool manager_unload(struct s_instructionPointer * restrict ip, funge_cell fingerprint);
 
+/**
+ * Write the opcode stacks of an IP to an image. Each entry is stored as the
+ * fingerprint and instruction it was originally loaded as.
+ * @warning Don't call this directly from fingerprints.
+ * @param file Image file to write to.
+ * @param ip IP to write opcode stacks for.
+ * @return True if successful, otherwise false.
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL FUNGE_ATTR_WARN_UNUSED
+bool manager_save_image(FILE * restrict file,
+                        const struct s_instructionPointer * restrict ip);
+
+/**
+ * Restore the opcode stacks of an IP from an image. Fingerprints are loaded
+ * again as needed to find the functions, any internal state they had when
+ * the image was written (such as open files) is not restored.
+ * @warning Don't call this directly from fingerprints.
+ * @param file Image file to read from.
+ * @param ip IP to restore opcode stacks for, must have empty opcode stacks.
+ * @return True if successful, otherwise false.
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL FUNGE_ATTR_WARN_UNUSED
+bool manager_load_image(FILE * restrict file,
+                        struct s_instructionPointer * restrict ip);
+
+/**
+ * Find what fingerprint and instruction a fingerprint function was loaded as.
+ * Only fingerprints that have been loaded by this process are known.
+ * @param func The function to look up.
+ * @param fprint Out parameter for the fingerprint.
+ * @param opcode Out parameter for the instruction (A-Z).
+ * @return True if found, otherwise false.
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL FUNGE_ATTR_WARN_UNUSED
+bool manager_opcode_origin(fingerprintOpcode func, funge_cell * restrict fprint,
+                           unsigned char * restrict opcode);
+
 /**
  * Print out list of supported fingerprints
  */
@@ -31,6 +31,8 @@
 #include "../global.h"
 #include "funge-space.h"
 #include "../diagnostic.h"
+#include "../image.h"
+#include "../stats.h"
 #include "../../lib/libghthash/ght_hash_table.h"
 #define CFUNGE_MEMPOOL_HASHLIB
 #include "../../lib/mempool/cfunge_mempool.h"
@@ -97,8 +99,13 @@ static fungeSpace fspace = {
 // Note that this must be true to not break code below:
 //  (FUNGESPACE_STATIC_X * FUNGESPACE_STATIC_Y * sizeof(funge_cell)) % 128 == 0
 // Further cfun_static_space must be aligned on 16 byte boundary.
+// For images to be mmap()ed into place the size must also be a multiple of
+// the page size.
 #define FUNGESPACE_STATIC_X 512
 #define FUNGESPACE_STATIC_Y 1024
+/// Alignment of cfun_static_space. Page aligned so that image_load() can
+/// mmap() the static area of an image over it.
+#define FUNGESPACE_STATIC_ALIGN IMAGE_STATIC_ALIGN
 
 #define FUNGESPACE_RANGE_CHECK(rx, ry) \
 	(((rx) < FUNGESPACE_STATIC_X) && ((ry) < FUNGESPACE_STATIC_Y))
@@ -114,7 +121,18 @@ static funge_cell cfun_static_space[FUNGESPACE_STATIC_X * FUNGESPACE_STATIC_Y]
 #ifdef CFUNGE_COMP_GCC_COMPAT
 __asm__("cfun_static_space")
 #endif
-FUNGE_ATTR_ALIGNED(16);
+FUNGE_ATTR_ALIGNED(FUNGESPACE_STATIC_ALIGN);
+
+/// Size in bytes of the tiles the static area is divided into when tracking
+/// changes for incremental images.
+#define FUNGESPACE_TILE_SIZE 4096
+/// Number of tiles in the static area.
+#define FUNGESPACE_TILE_COUNT (sizeof(cfun_static_space) / FUNGESPACE_TILE_SIZE)
+/// Tile that a STATIC_COORD() is in.
+#define STATIC_TILE(m_coord) (((m_coord) * sizeof(funge_cell)) / FUNGESPACE_TILE_SIZE)
+
+/// Tiles of the static area changed since fungespace_image_mark_clean().
+static unsigned char cfun_static_dirty[FUNGESPACE_TILE_COUNT];
 
 #ifdef CFUN_EXACT_BOUNDS
 /// Non-Space counts for each column.
@@ -181,6 +199,31 @@ static const v4si fspace_vector_init = {0x20, 0x0, 0x20, 0x0};
  * Setup and teardown code here. *
  *********************************/
 
+/**
+ * Create the hash tables and memory pools. Used by both fungespace_create()
+ * and fungespace_load_image().
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_WARN_UNUSED
+static bool fungespace_create_tables(void)
+{
+	fspace.entries = ght_fspace_create(FUNGESPACE_INITIAL_SIZE);
+	if (FUNGE_UNLIKELY(!fspace.entries))
+		return false;
+	ght_fspace_set_rehash(fspace.entries, true);
+#ifdef CFUN_EXACT_BOUNDS
+	fspace.col_count = ght_fspacecount_create(FUNGECOUNT_COL_INITIAL_SIZE);
+	fspace.row_count = ght_fspacecount_create(FUNGECOUNT_ROW_INITIAL_SIZE);
+	if (FUNGE_UNLIKELY(!fspace.col_count || !fspace.row_count))
+		return false;
+	ght_fspacecount_set_rehash(fspace.col_count, true);
+	ght_fspacecount_set_rehash(fspace.row_count, true);
+	// Set up mempool for hash library.
+	if (FUNGE_UNLIKELY(!cf_mempool_fspacecount_setup()))
+		return false;
+#endif
+	return cf_mempool_fspace_setup();
+}
+
 bool fungespace_create(void)
 {
 	// Fill static array with spaces.
@@ -214,22 +257,7 @@ bool fungespace_create(void)
 	for (size_t i = 0; i < sizeof(cfun_static_space) / sizeof(funge_cell); i++)
 		cfun_static_space[i] = ' ';
 #endif
-	fspace.entries = ght_fspace_create(FUNGESPACE_INITIAL_SIZE);
-	if (FUNGE_UNLIKELY(!fspace.entries))
-		return false;
-	ght_fspace_set_rehash(fspace.entries, true);
-#ifdef CFUN_EXACT_BOUNDS
-	fspace.col_count = ght_fspacecount_create(FUNGECOUNT_COL_INITIAL_SIZE);
-	fspace.row_count = ght_fspacecount_create(FUNGECOUNT_ROW_INITIAL_SIZE);
-	if (FUNGE_UNLIKELY(!fspace.col_count || !fspace.row_count))
-		return false;
-	ght_fspacecount_set_rehash(fspace.col_count, true);
-	ght_fspacecount_set_rehash(fspace.row_count, true);
-	// Set up mempool for hash library.
-	if (FUNGE_UNLIKELY(!cf_mempool_fspacecount_setup()))
-		return false;
-#endif
-	return cf_mempool_fspace_setup();
+	return fungespace_create_tables();
 }
 
 
@@ -456,6 +484,25 @@ fungespace_get_bounds_rect(fungeRect * restrict rect)
 	rect->h = fspace.bottomRightCorner.y - fspace.topLeftCorner.y;
 }
 
+FUNGE_ATTR_FAST void
+fungespace_get_hash_stats(fungeHashStats * restrict stats)
+{
+	stats->items = fspace.entries->i_items;
+	stats->buckets = fspace.entries->i_size;
+	stats->used_buckets = 0;
+	stats->longest_chain = 0;
+	for (size_t i = 0; i < fspace.entries->i_size; i++) {
+		size_t length = 0;
+		for (const ght_fspace_hash_entry_t *entry = fspace.entries->pp_entries[i];
+		     entry; entry = entry->p_next)
+			length++;
+		if (length)
+			stats->used_buckets++;
+		if (length > stats->longest_chain)
+			stats->longest_chain = length;
+	}
+}
+
 /**
  * Check if position is in range.
  */
@@ -483,9 +530,12 @@ fungespace_get(const funge_vector * restrict position)
 	funge_unsigned_cell y = (funge_unsigned_cell)position->y + FUNGESPACE_STATIC_OFFSET_Y;
 
 	if (FUNGESPACE_RANGE_CHECK(x, y)) {
+		STATS_INC(stat_static_gets);
 		return cfun_static_space[STATIC_COORD(x, y)];
 	} else {
-		funge_cell *tmp = (funge_cell*)ght_fspace_get(fspace.entries, position);
+		funge_cell *tmp;
+		STATS_INC(stat_hash_gets);
+		tmp = (funge_cell*)ght_fspace_get(fspace.entries, position);
 		if (!tmp)
 			return (funge_cell)' ';
 		else
@@ -512,8 +562,10 @@ fungespace_get_offset(const funge_vector * restrict position,
 	y = (funge_unsigned_cell)tmp.y + FUNGESPACE_STATIC_OFFSET_Y;
 
 	if (FUNGESPACE_RANGE_CHECK(x, y)) {
+		STATS_INC(stat_static_gets);
 		return cfun_static_space[STATIC_COORD(x, y)];
 	} else {
+		STATS_INC(stat_hash_gets);
 		result = (funge_cell*)ght_fspace_get(fspace.entries, &tmp);
 		if (!result)
 			return (funge_cell)' ';
@@ -539,7 +591,9 @@ fungespace_set_no_bounds_update(funge_cell value,
 #ifdef CFUN_EXACT_BOUNDS
 		funge_cell prev = cfun_static_space[STATIC_COORD(x, y)];
 #endif
+		STATS_INC(stat_static_sets);
 		cfun_static_space[STATIC_COORD(x, y)] = value;
+		cfun_static_dirty[STATIC_TILE(STATIC_COORD(x, y))] = 1;
 #ifdef CFUN_EXACT_BOUNDS
 		if (value != prev) {
 			if ((prev == ' ') || (value == ' '))
@@ -548,7 +602,9 @@ fungespace_set_no_bounds_update(funge_cell value,
 #endif
 	} else {
 #ifdef CFUN_EXACT_BOUNDS
-		funge_cell* prev = ght_fspace_get(fspace.entries, position);
+		funge_cell* prev;
+		STATS_INC(stat_hash_sets);
+		prev = ght_fspace_get(fspace.entries, position);
 		if (!prev) {
 			if (value == ' ')
 				return;
@@ -565,6 +621,7 @@ fungespace_set_no_bounds_update(funge_cell value,
 			}
 		}
 #else
+		STATS_INC(stat_hash_sets);
 		if (value == ' ') {
 			ght_fspace_remove(fspace.entries, position);
 		} else {
@@ -643,6 +700,132 @@ fungespace_set_offset(funge_cell value,
 }
 
 
+FUNGE_ATTR_FAST void
+fungespace_get_row(funge_cell * restrict buffer,
+                   const funge_vector * restrict position,
+                   size_t count)
+{
+	funge_vector pos = *position;
+	size_t i = 0;
+
+	while (i < count) {
+		funge_unsigned_cell x = (funge_unsigned_cell)pos.x + FUNGESPACE_STATIC_OFFSET_X;
+		funge_unsigned_cell y = (funge_unsigned_cell)pos.y + FUNGESPACE_STATIC_OFFSET_Y;
+		size_t n = 1;
+		if (FUNGESPACE_RANGE_CHECK(x, y)) {
+			// Copy the part of the row that is in the static area at once.
+			n = FUNGESPACE_STATIC_X - (size_t)x;
+			if (n > count - i)
+				n = count - i;
+			memcpy(buffer + i, &cfun_static_space[STATIC_COORD(x, y)], n * sizeof(funge_cell));
+			STATS_ADD(stat_static_gets, n);
+		} else {
+			buffer[i] = fungespace_get(&pos);
+		}
+		i += n;
+		pos.x = (funge_cell)((funge_unsigned_cell)pos.x + n);
+	}
+}
+
+
+FUNGE_ATTR_FAST void
+fungespace_set_row(const funge_cell * restrict buffer,
+                   const funge_vector * restrict position,
+                   size_t count)
+{
+	funge_vector pos = *position;
+	funge_cell minx = 0, maxx = 0;
+	bool found = false;
+	size_t i = 0;
+
+	while (i < count) {
+		funge_unsigned_cell x = (funge_unsigned_cell)pos.x + FUNGESPACE_STATIC_OFFSET_X;
+		funge_unsigned_cell y = (funge_unsigned_cell)pos.y + FUNGESPACE_STATIC_OFFSET_Y;
+		size_t n = 1;
+		if (FUNGESPACE_RANGE_CHECK(x, y)) {
+			// Write the part of the row that is in the static area at once.
+			size_t coord = STATIC_COORD(x, y);
+			size_t first = 0, last;
+			n = FUNGESPACE_STATIC_X - (size_t)x;
+			if (n > count - i)
+				n = count - i;
+			while (first < n && buffer[i + first] == ' ')
+				first++;
+			if (first < n) {
+				last = n - 1;
+				while (buffer[i + last] == ' ')
+					last--;
+				if (!found) {
+					minx = (funge_cell)(pos.x + (funge_cell)first);
+					maxx = (funge_cell)(pos.x + (funge_cell)last);
+					found = true;
+				} else {
+					if (minx > pos.x + (funge_cell)first)
+						minx = (funge_cell)(pos.x + (funge_cell)first);
+					if (maxx < pos.x + (funge_cell)last)
+						maxx = (funge_cell)(pos.x + (funge_cell)last);
+				}
+			}
+#ifdef CFUN_EXACT_BOUNDS
+			for (size_t j = 0; j < n; j++) {
+				funge_cell prev = cfun_static_space[coord + j];
+				funge_cell value = buffer[i + j];
+				if ((value != prev) && ((prev == ' ') || (value == ' ')))
+					fungespace_count((value != ' '),
+					                 vector_create_ref(pos.x + (funge_cell)j, pos.y));
+			}
+#endif
+			memcpy(&cfun_static_space[coord], buffer + i, n * sizeof(funge_cell));
+			memset(&cfun_static_dirty[STATIC_TILE(coord)], 1,
+			       STATIC_TILE(coord + n - 1) - STATIC_TILE(coord) + 1);
+			STATS_ADD(stat_static_sets, n);
+		} else {
+			fungespace_set(buffer[i], &pos);
+		}
+		i += n;
+		pos.x = (funge_cell)((funge_unsigned_cell)pos.x + n);
+	}
+	if (found) {
+		if (fspace.bottomRightCorner.y < pos.y)
+			fspace.bottomRightCorner.y = pos.y;
+		if (fspace.topLeftCorner.y > pos.y)
+			fspace.topLeftCorner.y = pos.y;
+		if (fspace.bottomRightCorner.x < maxx)
+			fspace.bottomRightCorner.x = maxx;
+		if (fspace.topLeftCorner.x > minx)
+			fspace.topLeftCorner.x = minx;
+	}
+}
+
+
+FUNGE_ATTR_FAST void
+fungespace_get_rect(funge_cell * restrict buffer, const fungeRect * restrict rect)
+{
+	funge_vector pos = { rect->x, rect->y };
+
+	assert(rect->w >= 0 && rect->h >= 0);
+	for (funge_cell y = 0; y < rect->h; y++) {
+		fungespace_get_row(buffer, &pos, (size_t)rect->w);
+		buffer += rect->w;
+		pos.y = (funge_cell)((funge_unsigned_cell)pos.y + 1);
+	}
+}
+
+
+FUNGE_ATTR_FAST void
+fungespace_set_rect(const funge_cell * restrict buffer, const fungeRect * restrict rect)
+{
+	funge_vector pos = { rect->x, rect->y };
+
+	assert(rect->w >= 0 && rect->h >= 0);
+	for (funge_cell y = 0; y < rect->h; y++) {
+		fungespace_set_row(buffer, &pos, (size_t)rect->w);
+		buffer += rect->w;
+		pos.y = (funge_cell)((funge_unsigned_cell)pos.y + 1);
+	}
+}
+
+
 /*****************
  * Wrapping code *
  *****************/
@@ -715,6 +898,7 @@ fungespace_wrap(funge_vector * restrict position,
 		fungespace_minimize_bounds();
 #endif
 	if (!fungespace_in_range(position)) {
+		STATS_INC(stat_wraps);
 		// Quick and dirty if cardinal.
 		if (FUNGE_LIKELY(fspace_vector_is_cardinal(delta))) {
 			// FIXME, HACK: Why are the +1/-1 needed?
@@ -1080,6 +1264,216 @@ error:
 }
 
 
+/*******************
+ * Image save/load *
+ *******************/
+
+#ifdef CFUN_EXACT_BOUNDS
+/**
+ * Write one of the row/column count hash tables as a count followed by
+ * key/value pairs.
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL FUNGE_ATTR_WARN_UNUSED
+static bool fungespace_save_image_counts(FILE * restrict file,
+                                         ght_fspacecount_hash_table_t * restrict table)
+{
+	ght_fspacecount_iterator_t iterator;
+	const funge_cell *p_key;
+	funge_unsigned_cell *p;
+	uint64_t count = ght_size(table);
+
+	if (!image_write_value(file, count))
+		return false;
+	for (p = ght_fspacecount_first(table, &iterator, &p_key);
+	     p; p = ght_fspacecount_next(&iterator, &p_key)) {
+		if (!image_write_value(file, *p_key) || !image_write_value(file, *p))
+			return false;
+	}
+	return true;
+}
+
+/**
+ * Read back a table written by fungespace_save_image_counts().
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL FUNGE_ATTR_WARN_UNUSED
+static bool fungespace_load_image_counts(FILE * restrict file,
+                                         ght_fspacecount_hash_table_t * restrict table)
+{
+	uint64_t count;
+
+	if (!image_read_value(file, count))
+		return false;
+	for (uint64_t i = 0; i < count; i++) {
+		funge_cell key;
+		funge_unsigned_cell value;
+		if (!image_read_value(file, key) || !image_read_value(file, value))
+			return false;
+		if (FUNGE_UNLIKELY(ght_fspacecount_insert(table, value, &key) == -1))
+			return false;
+	}
+	return true;
+}
+#endif
+
+/**
+ * Write the tiles of the static area that changed since the last call to
+ * fungespace_image_mark_clean() to their places in an existing image.
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL FUNGE_ATTR_WARN_UNUSED
+static bool fungespace_update_image_static(FILE * restrict file,
+                                           const imageHeader * restrict header)
+{
+	const unsigned char *area = (const unsigned char*)cfun_static_space;
+	size_t i = 0;
+
+	while (i < FUNGESPACE_TILE_COUNT) {
+		size_t end = i;
+		if (!cfun_static_dirty[i]) {
+			i++;
+			continue;
+		}
+		// Write runs of dirty tiles in one go.
+		while ((end < FUNGESPACE_TILE_COUNT) && cfun_static_dirty[end])
+			end++;
+		if (fseeko(file, (off_t)(header->static_start + i * FUNGESPACE_TILE_SIZE), SEEK_SET) != 0)
+			return false;
+		if (!image_write(file, area + i * FUNGESPACE_TILE_SIZE, (end - i) * FUNGESPACE_TILE_SIZE))
+			return false;
+		i = end;
+	}
+	return fseeko(file, (off_t)(header->static_start + header->static_length), SEEK_SET) == 0;
+}
+
+FUNGE_ATTR_FAST void fungespace_image_mark_clean(void)
+{
+	memset(cfun_static_dirty, 0, sizeof(cfun_static_dirty));
+}
+
+FUNGE_ATTR_FAST bool
+fungespace_save_image(FILE * restrict file, imageHeader * restrict header,
+                      bool incremental)
+{
+	uint64_t count;
+	ght_fspace_iterator_t iterator;
+	const funge_vector *p_key;
+	funge_cell *p;
+
+	assert(file != NULL);
+	assert(header != NULL);
+
+	header->static_x        = FUNGESPACE_STATIC_X;
+	header->static_y        = FUNGESPACE_STATIC_Y;
+	header->static_offset_x = FUNGESPACE_STATIC_OFFSET_X;
+	header->static_offset_y = FUNGESPACE_STATIC_OFFSET_Y;
+	header->static_start    = IMAGE_STATIC_ALIGN;
+	header->static_length   = sizeof(cfun_static_space);
+
+	if (incremental) {
+		if (!fungespace_update_image_static(file, header))
+			return false;
+	} else {
+		if (fseeko(file, (off_t)header->static_start, SEEK_SET) != 0)
+			return false;
+		if (!image_write(file, cfun_static_space, sizeof(cfun_static_space)))
+			return false;
+	}
+
+	if (!image_write_value(file, fspace.topLeftCorner)
+	    || !image_write_value(file, fspace.bottomRightCorner)
+	    || !image_write_value(file, fspace.boundsvalid))
+		return false;
+#ifdef CFUN_EXACT_BOUNDS
+	if (!image_write_value(file, fspace.boundsexact)
+	    || !image_write_value(file, cfun_static_use_count_col)
+	    || !image_write_value(file, cfun_static_use_count_row)
+	    || !fungespace_save_image_counts(file, fspace.col_count)
+	    || !fungespace_save_image_counts(file, fspace.row_count))
+		return false;
+#endif
+
+	count = ght_size(fspace.entries);
+	if (!image_write_value(file, count))
+		return false;
+	for (p = ght_fspace_first(fspace.entries, &iterator, &p_key);
+	     p; p = ght_fspace_next(&iterator, &p_key)) {
+		if (!image_write_value(file, *p_key) || !image_write_value(file, *p))
+			return false;
+	}
+	return true;
+}
+
+FUNGE_ATTR_FAST bool
+fungespace_load_image(FILE * restrict file, const imageHeader * restrict header)
+{
+	uint64_t count;
+	bool mapped = false;
+	long pagesize = sysconf(_SC_PAGESIZE);
+
+	assert(file != NULL);
+	assert(header != NULL);
+
+	if ((header->static_x != FUNGESPACE_STATIC_X)
+	    || (header->static_y != FUNGESPACE_STATIC_Y)
+	    || (header->static_offset_x != FUNGESPACE_STATIC_OFFSET_X)
+	    || (header->static_offset_y != FUNGESPACE_STATIC_OFFSET_Y)
+	    || (header->static_length != sizeof(cfun_static_space))) {
+		errno = EINVAL;
+		return false;
+	}
+
+	if (FUNGE_UNLIKELY(!fungespace_create_tables()))
+		return false;
+
+	// Try to map the static area copy-on-write straight from the file. This
+	// makes restoring it independent of its size: pages are only read in as
+	// they are touched.
+	if ((pagesize > 0)
+	    && ((uintptr_t)cfun_static_space % (uintptr_t)pagesize == 0)
+	    && (sizeof(cfun_static_space) % (size_t)pagesize == 0)
+	    && (header->static_start % (uint64_t)pagesize == 0)) {
+		void *addr = mmap(cfun_static_space, sizeof(cfun_static_space),
+		                  PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED,
+		                  fileno(file), (off_t)header->static_start);
+		mapped = (addr != MAP_FAILED);
+	}
+	if (fseeko(file, (off_t)header->static_start, SEEK_SET) != 0)
+		return false;
+	if (mapped) {
+		if (fseeko(file, (off_t)header->static_length, SEEK_CUR) != 0)
+			return false;
+	} else {
+		// Fall back to reading it.
+		if (!image_read(file, cfun_static_space, sizeof(cfun_static_space)))
+			return false;
+	}
+
+	if (!image_read_value(file, fspace.topLeftCorner)
+	    || !image_read_value(file, fspace.bottomRightCorner)
+	    || !image_read_value(file, fspace.boundsvalid))
+		return false;
+#ifdef CFUN_EXACT_BOUNDS
+	if (!image_read_value(file, fspace.boundsexact)
+	    || !image_read_value(file, cfun_static_use_count_col)
+	    || !image_read_value(file, cfun_static_use_count_row)
+	    || !fungespace_load_image_counts(file, fspace.col_count)
+	    || !fungespace_load_image_counts(file, fspace.row_count))
+		return false;
+#endif
+
+	if (!image_read_value(file, count))
+		return false;
+	for (uint64_t i = 0; i < count; i++) {
+		funge_vector key;
+		funge_cell value;
+		if (!image_read_value(file, key) || !image_read_value(file, value))
+			return false;
+		if (FUNGE_UNLIKELY(ght_fspace_insert(fspace.entries, value, &key) == -1))
+			return false;
+	}
+	return true;
+}
+
+
 /*************
  * Debugging *
  *************/
@@ -32,6 +32,10 @@
 #include "../rect.h"
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdio.h>
+
+/// Forward decl, see image.h
+struct s_imageHeader;
 
 /// DO NOT CHANGE unless you are 100 sure of what you are doing!
 /// Yes I mean you!
@@ -83,6 +87,46 @@ FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL
 void fungespace_set_offset(funge_cell value,
                            const funge_vector * restrict position,
                            const funge_vector * restrict offset);
+/**
+ * Get count cells, starting at position and going east. Same as calling
+ * fungespace_get() for each cell, but faster.
+ * @param buffer Where to store the cells.
+ * @param position The place in Funge-Space of the first cell.
+ * @param count Number of cells to get.
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL
+void fungespace_get_row(funge_cell * restrict buffer,
+                        const funge_vector * restrict position,
+                        size_t count);
+/**
+ * Set count cells, starting at position and going east. Same as calling
+ * fungespace_set() for each cell.
+ * @param buffer The values to set.
+ * @param position The place in Funge-Space of the first cell.
+ * @param count Number of cells to set.
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL
+void fungespace_set_row(const funge_cell * restrict buffer,
+                        const funge_vector * restrict position,
+                        size_t count);
+/**
+ * Get the cells in a rectangle, row by row. Same as calling fungespace_get()
+ * for each cell, but faster.
+ * @param buffer Where to store the rect->w * rect->h cells.
+ * @param rect The rectangle to get, width and height must not be negative.
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL
+void fungespace_get_rect(funge_cell * restrict buffer,
+                         const fungeRect * restrict rect);
+/**
+ * Set the cells in a rectangle, row by row. Same as calling fungespace_set()
+ * for each cell.
+ * @param buffer The rect->w * rect->h values to set.
+ * @param rect The rectangle to set, width and height must not be negative.
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL
+void fungespace_set_rect(const funge_cell * restrict buffer,
+                         const fungeRect * restrict rect);
 /**
  * Calculate the new position after adding a delta to a position, considering
  * any needed wrapping. Used for IP wrapping.
@@ -148,6 +192,37 @@ bool fungespace_save_to_file(const char         * restrict filename,
                              const funge_vector * restrict size,
                              bool textfile);
 
+/**
+ * Write the complete state of Funge-Space to an image. Fills in the static
+ * area fields in the header, but does not write the header itself.
+ * @param file Image file to write to.
+ * @param header Image header to fill in.
+ * @param incremental If true, file is an existing image written by this
+ * process, and only the parts of the static area changed since the last call
+ * to fungespace_image_mark_clean() are written.
+ * @return True if successful, otherwise false.
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL FUNGE_ATTR_WARN_UNUSED
+bool fungespace_save_image(FILE * restrict file,
+                           struct s_imageHeader * restrict header,
+                           bool incremental);
+/**
+ * Forget about changes to the static area, used after an image was written.
+ */
+FUNGE_ATTR_FAST
+void fungespace_image_mark_clean(void);
+/**
+ * Create Funge-Space from an image. The static area is mmap()ed from the file
+ * when possible. Used instead of fungespace_create().
+ * @warning Should only be called from internal setup code.
+ * @param file Image file to read from.
+ * @param header The already validated header of the image.
+ * @return True if successful, otherwise false.
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL FUNGE_ATTR_WARN_UNUSED
+bool fungespace_load_image(FILE * restrict file,
+                           const struct s_imageHeader * restrict header);
+
 /**
  * Get the bounding rectangle for the part of Funge-Space that isn't empty.
  * @note It won't be too small, but it may be too big.
@@ -156,4 +231,20 @@ bool fungespace_save_to_file(const char         * restrict filename,
 FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL
 void fungespace_get_bounds_rect(fungeRect * restrict rect);
 
+/// Statistics about the hash table used outside the static area.
+typedef struct s_fungeHashStats {
+	size_t items;         ///< Number of cells stored.
+	size_t buckets;       ///< Number of buckets.
+	size_t used_buckets;  ///< Number of buckets with at least one cell.
+	size_t longest_chain; ///< Number of cells in the fullest bucket.
+} fungeHashStats;
+
+/**
+ * Get statistics about the hash table. This walks all the buckets, so it is
+ * not cheap.
+ * @param stats Out parameter for the statistics.
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL
+void fungespace_get_hash_stats(fungeHashStats * restrict stats);
+
 #endif
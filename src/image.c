@@ -0,0 +1,199 @@
+/* -*- mode: C; coding: utf-8; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*-
+ *
+ * cfunge - A standard-conforming Befunge93/98/109 interpreter in C.
+ * Copyright (C) 2008-2013 Arvid Norlander <VorpalBlade AT users.noreply.github.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at the proxy's option) any later version. Arvid Norlander is a
+ * proxy who can decide which future versions of the GNU General Public
+ * License can be used.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "global.h"
+#include "image.h"
+
+#include "diagnostic.h"
+#include "ip.h"
+#include "prng.h"
+#include "funge-space/funge-space.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h> /* memcmp, memcpy, memset, strerror */
+#include <unistd.h> /* ftruncate */
+
+FUNGE_ATTR_FAST bool image_write(FILE * restrict file, const void * restrict data, size_t size)
+{
+	return fwrite(data, 1, size, file) == size;
+}
+
+FUNGE_ATTR_FAST bool image_read(FILE * restrict file, void * restrict data, size_t size)
+{
+	return fread(data, 1, size, file) == size;
+}
+
+/// Flags describing the layout this binary uses.
+#ifdef CFUN_EXACT_BOUNDS
+#  define IMAGE_FLAGS_EB IMAGE_FLAG_EXACT_BOUNDS
+#else
+#  define IMAGE_FLAGS_EB 0
+#endif
+#ifdef CONCURRENT_FUNGE
+#  define IMAGE_FLAGS (IMAGE_FLAGS_EB | IMAGE_FLAG_CONCURRENT)
+#else
+#  define IMAGE_FLAGS IMAGE_FLAGS_EB
+#endif
+
+/**
+ * Fill in the build dependent part of a header.
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL
+static inline void image_header_init(imageHeader * restrict header)
+{
+	memset(header, 0, sizeof(imageHeader));
+	memcpy(header->magic, IMAGE_MAGIC, sizeof(header->magic));
+	header->version   = IMAGE_VERSION;
+	header->byteorder = IMAGE_BYTEORDER;
+	header->cellsize  = sizeof(funge_cell);
+	header->flags     = IMAGE_FLAGS;
+}
+
+/**
+ * Check that an image was created by a binary with the same configuration.
+ * The static area fields are checked by fungespace_load_image().
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL FUNGE_ATTR_PURE FUNGE_ATTR_WARN_UNUSED
+static inline bool image_header_valid(const imageHeader * restrict header)
+{
+	return (memcmp(header->magic, IMAGE_MAGIC, sizeof(header->magic)) == 0)
+	       && (header->version == IMAGE_VERSION)
+	       && (header->byteorder == IMAGE_BYTEORDER)
+	       && (header->cellsize == sizeof(funge_cell))
+	       && (header->flags == IMAGE_FLAGS);
+}
+
+/// Type of the IPs argument to image_save() and image_update().
+#ifdef CONCURRENT_FUNGE
+typedef ipList imageIPs;
+#else
+typedef instructionPointer imageIPs;
+#endif
+
+/**
+ * Write everything but the header, then the header.
+ * @param incremental See fungespace_save_image().
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL FUNGE_ATTR_WARN_UNUSED
+static bool image_write_state(FILE * restrict file, const imageIPs * restrict ips,
+                              bool incremental)
+{
+	imageHeader header;
+	off_t length;
+
+	image_header_init(&header);
+	if (!fungespace_save_image(file, &header, incremental))
+		return false;
+#ifdef CONCURRENT_FUNGE
+	if (!iplist_save_image(file, ips))
+#else
+	if (!ip_save_image(file, ips))
+#endif
+		return false;
+	if (!prng_save_image(file))
+		return false;
+	// An updated image may be shorter than the old one.
+	length = ftello(file);
+	if ((length == -1) || (fflush(file) != 0) || (ftruncate(fileno(file), length) != 0))
+		return false;
+	// The header is written last, so an interrupted save can't result in a
+	// file that looks valid.
+	if (fseeko(file, 0, SEEK_SET) != 0)
+		return false;
+	return image_write_value(file, header);
+}
+
+/// Close file, keeping errno from the error that got us here.
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL
+static inline void image_close_on_error(FILE * file)
+{
+	int saved_errno = errno;
+	fclose(file);
+	errno = saved_errno;
+}
+
+FUNGE_ATTR_FAST bool image_save(const char * restrict filename, const imageIPs * restrict ips)
+{
+	FILE *file;
+
+	file = fopen(filename, "wb");
+	if (!file)
+		return false;
+	if (!image_write_state(file, ips, false)) {
+		image_close_on_error(file);
+		return false;
+	}
+	return fclose(file) == 0;
+}
+
+FUNGE_ATTR_FAST bool image_update(const char * restrict filename, const imageIPs * restrict ips)
+{
+	static const char invalid_magic[sizeof(IMAGE_MAGIC) - 1] = { 0 };
+	FILE *file;
+
+	file = fopen(filename, "r+b");
+	if (!file)
+		return false;
+	// Parts of the file are overwritten in place. Mark it as invalid first, so
+	// that it won't be loaded if we don't get to finish.
+	if (!image_write(file, invalid_magic, sizeof(invalid_magic))
+	    || (fflush(file) != 0)
+	    || !image_write_state(file, ips, true)) {
+		image_close_on_error(file);
+		return false;
+	}
+	return fclose(file) == 0;
+}
+
+#ifdef CONCURRENT_FUNGE
+FUNGE_ATTR_FAST ipList * image_load(const char * restrict filename)
+{
+	ipList *ips;
+#else
+FUNGE_ATTR_FAST instructionPointer * image_load(const char * restrict filename)
+{
+	instructionPointer *ips;
+#endif
+	imageHeader header;
+	FILE *file;
+
+	file = fopen(filename, "rb");
+	if (FUNGE_UNLIKELY(!file)) {
+		diag_fatal_format("Failed to open image \"%s\": %s", filename, strerror(errno));
+	}
+	if (FUNGE_UNLIKELY(!image_read_value(file, header) || !image_header_valid(&header))) {
+		diag_fatal_format("\"%s\" is not an image created by this cfunge build.", filename);
+	}
+	if (FUNGE_UNLIKELY(!fungespace_load_image(file, &header))) {
+		diag_fatal_format("Failed to restore Funge-Space from image \"%s\" (corrupt image or out of memory).", filename);
+	}
+#ifdef CONCURRENT_FUNGE
+	ips = iplist_load_image(file);
+#else
+	ips = ip_load_image(file);
+#endif
+	if (FUNGE_UNLIKELY(!ips || !prng_load_image(file))) {
+		diag_fatal_format("Failed to restore IPs from image \"%s\" (corrupt image or out of memory).", filename);
+	}
+	fclose(file);
+	return ips;
+}
@@ -0,0 +1,169 @@
+/* -*- mode: C; coding: utf-8; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*-
+ *
+ * cfunge - A standard-conforming Befunge93/98/109 interpreter in C.
+ * Copyright (C) 2008-2013 Arvid Norlander <VorpalBlade AT users.noreply.github.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at the proxy's option) any later version. Arvid Norlander is a
+ * proxy who can decide which future versions of the GNU General Public
+ * License can be used.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file
+ * Binary images of the complete interpreter state (Funge-Space and IPs).
+ *
+ * An image file consists of:
+ * - A fixed size header (imageHeader).
+ * - Padding up to IMAGE_STATIC_ALIGN.
+ * - The raw static area of Funge-Space, so it can be mmap()ed straight back
+ *   into place on load.
+ * - The remaining state: bounds, row/column counts, hash table cells, the IPs
+ *   with their stack-stacks and loaded fingerprints and finally the PRNG
+ *   state.
+ *
+ * All values are stored in native byte order and with the native cell size.
+ * An image can only be loaded by a cfunge binary built with the same
+ * configuration, anything else is rejected when loading.
+ */
+
+#ifndef FUNGE_HAD_SRC_IMAGE_H
+#define FUNGE_HAD_SRC_IMAGE_H
+
+#include "global.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "ip.h"
+
+/// Magic string at the start of every image.
+#define IMAGE_MAGIC "CFUNIMG\0"
+/// Format version, bump on any incompatible change.
+#define IMAGE_VERSION 2
+/// Written in native byte order, used to detect images from other platforms.
+#define IMAGE_BYTEORDER 0x01020304
+/// File offset alignment of the static area. This is the largest page size
+/// we care about, so it is suitable for mmap() everywhere.
+#define IMAGE_STATIC_ALIGN 0x10000
+
+/// @defgroup imageflags Image build flags
+/// Compile time options that change the layout of the image.
+/*@{*/
+#define IMAGE_FLAG_EXACT_BOUNDS 0x1 ///< CFUN_EXACT_BOUNDS
+#define IMAGE_FLAG_CONCURRENT   0x2 ///< CONCURRENT_FUNGE
+/*@}*/
+
+/// Header at the start of an image file.
+typedef struct s_imageHeader {
+	char     magic[8];        ///< Always IMAGE_MAGIC.
+	uint32_t version;         ///< Always IMAGE_VERSION.
+	uint32_t byteorder;       ///< Always IMAGE_BYTEORDER.
+	uint32_t cellsize;        ///< sizeof(funge_cell).
+	uint32_t flags;           ///< See @ref imageflags.
+	uint32_t static_x;        ///< Width of the static area.
+	uint32_t static_y;        ///< Height of the static area.
+	uint32_t static_offset_x; ///< Offset of 0,0 in the static area.
+	uint32_t static_offset_y; ///< Offset of 0,0 in the static area.
+	uint64_t static_start;    ///< File offset of static area.
+	uint64_t static_length;   ///< Length of static area in bytes.
+} imageHeader;
+
+/**
+ * Write a block of data to an image.
+ * @param file File to write to.
+ * @param data Data to write.
+ * @param size Size of data in bytes.
+ * @return True if successful, otherwise false.
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL FUNGE_ATTR_WARN_UNUSED
+bool image_write(FILE * restrict file, const void * restrict data, size_t size);
+/**
+ * Read a block of data from an image.
+ * @param file File to read from.
+ * @param data Buffer to read into.
+ * @param size Size of data in bytes.
+ * @return True if successful, otherwise false.
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL FUNGE_ATTR_WARN_UNUSED
+bool image_read(FILE * restrict file, void * restrict data, size_t size);
+
+/// Write a single variable to an image.
+#define image_write_value(m_file, m_value) \
+	image_write((m_file), &(m_value), sizeof(m_value))
+/// Read a single variable from an image.
+#define image_read_value(m_file, m_value) \
+	image_read((m_file), &(m_value), sizeof(m_value))
+
+#ifdef CONCURRENT_FUNGE
+/**
+ * Save Funge-Space and all IPs to an image file.
+ * @param filename File to write the image to.
+ * @param ips IP list to save.
+ * @return True if successful, otherwise false (errno will be set).
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL FUNGE_ATTR_WARN_UNUSED
+bool image_save(const char * restrict filename, const ipList * restrict ips);
+/**
+ * Update an image previously written by this process with image_save().
+ * Only the parts of the static area of Funge-Space that changed since
+ * fungespace_image_mark_clean() was last called are written, the rest of the
+ * state is rewritten in full.
+ * @param filename File to update.
+ * @param ips IP list to save.
+ * @return True if successful, otherwise false (errno will be set).
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL FUNGE_ATTR_WARN_UNUSED
+bool image_update(const char * restrict filename, const ipList * restrict ips);
+/**
+ * Load Funge-Space and IPs from an image file. This replaces both
+ * fungespace_create() and fungespace_load().
+ * @param filename File to read the image from.
+ * @return The restored IP list. Errors are fatal.
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL FUNGE_ATTR_WARN_UNUSED
+ipList * image_load(const char * restrict filename);
+#else
+/**
+ * Save Funge-Space and the IP to an image file.
+ * @param filename File to write the image to.
+ * @param ip IP to save.
+ * @return True if successful, otherwise false (errno will be set).
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL FUNGE_ATTR_WARN_UNUSED
+bool image_save(const char * restrict filename,
+                const instructionPointer * restrict ip);
+/**
+ * Update an image previously written by this process with image_save().
+ * Only the parts of the static area of Funge-Space that changed since
+ * fungespace_image_mark_clean() was last called are written, the rest of the
+ * state is rewritten in full.
+ * @param filename File to update.
+ * @param ip IP to save.
+ * @return True if successful, otherwise false (errno will be set).
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL FUNGE_ATTR_WARN_UNUSED
+bool image_update(const char * restrict filename,
+                  const instructionPointer * restrict ip);
+/**
+ * Load Funge-Space and the IP from an image file. This replaces both
+ * fungespace_create() and fungespace_load().
+ * @param filename File to read the image from.
+ * @return The restored IP. Errors are fatal.
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL FUNGE_ATTR_WARN_UNUSED
+instructionPointer * image_load(const char * restrict filename);
+#endif
+
+#endif
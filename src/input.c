@@ -21,77 +21,188 @@
 
 #include "global.h"
 #include "input.h"
+#include "output.h"
+#include "replay.h"
 
 #include <assert.h>
 #include <ctype.h>  /* isdigit, isxdigit */
+#include <errno.h>
+#include <poll.h>
 #include <stdbool.h>
 #include <stddef.h> /* ptrdiff_t */
 #include <stdlib.h>
+#include <string.h> /* memchr, memcpy, memmove */
+#include <sys/stat.h>
+#include <unistd.h> /* read */
 
-// We use static buffer for input to save input
-// from one read to the next if there was any
-// left.
-static char*  lastline = NULL;
-// Size of buffer, may be grown by cf_getline()
-static size_t linesize = 0;
-// Length of current string in buffer. Needed in case of \0 bytes in it
-static size_t linelength = 0;
-// Pointer to how far we consumed the current line.
-static char*  lastline_current = NULL;
+/// Initial size of the input buffer, it is grown for longer lines.
+#define INPUT_BUFFER_SIZE (64 * 1024)
 
-#define IS_LINE_END(ptr) ((size_t)((ptr)-lastline) >= linelength)
+// Input is read with read() in large blocks into this buffer, which is kept
+// for the whole run. The instructions still work on one line at a time: the
+// current line is the part of the buffer from input_pos to line_end.
+static char*  input_buffer = NULL;
+// Allocated size of input_buffer.
+static size_t input_size = 0;
+// Number of bytes read into input_buffer.
+static size_t input_fill = 0;
+// Position of the next unread byte of the current line.
+static size_t input_pos = 0;
+// End of the current line (after the newline, if any).
+static size_t line_end = 0;
+// Did we get end of file (or an error) on stdin?
+static bool input_eof = false;
 
+/// What kind of file stdin is, decides when output must be flushed.
+static enum {
+	stdin_unknown,
+	stdin_file,     ///< Regular file, reads never block.
+	stdin_terminal, ///< Terminal, always flush before reading.
+	stdin_other     ///< Pipe, socket or similar, flush if a read would block.
+} input_kind = stdin_unknown;
+
+#define IS_LINE_END(pos) ((pos) >= line_end)
+
+/**
+ * Flush output if the user (or other end of the pipe) may be waiting for it
+ * before sending more input.
+ */
+static void flush_before_read(void)
+{
+	if (FUNGE_UNLIKELY(input_kind == stdin_unknown)) {
+		struct stat st;
+		if (isatty(STDIN_FILENO))
+			input_kind = stdin_terminal;
+		else if (fstat(STDIN_FILENO, &st) == 0 && S_ISREG(st.st_mode))
+			input_kind = stdin_file;
+		else
+			input_kind = stdin_other;
+	}
+	if (input_kind == stdin_file)
+		return;
+	if (input_kind == stdin_other) {
+		struct pollfd pfd = { .fd = STDIN_FILENO, .events = POLLIN, .revents = 0 };
+		if (poll(&pfd, 1, 0) > 0)
+			return;
+	}
+	output_flush();
+}
+
+/**
+ * Read more data into the buffer, making room for it first.
+ * @return False on end of file or error.
+ */
+static bool fill_buffer(void)
+{
+	ssize_t retval;
+	// Move the unread part to the start of the buffer, or grow the buffer
+	// if the unread part already fills it.
+	if (input_pos > 0) {
+		memmove(input_buffer, input_buffer + input_pos, input_fill - input_pos);
+		input_fill -= input_pos;
+		input_pos = 0;
+	}
+	if (input_fill == input_size) {
+		size_t newsize = input_size ? input_size * 2 : INPUT_BUFFER_SIZE;
+		char *newbuffer = realloc(input_buffer, newsize);
+		if (FUNGE_UNLIKELY(!newbuffer))
+			return false;
+		input_buffer = newbuffer;
+		input_size = newsize;
+	}
+	flush_before_read();
+	do {
+		retval = read(STDIN_FILENO, input_buffer + input_fill, input_size - input_fill);
+	} while (retval == -1 && errno == EINTR);
+	if (retval <= 0)
+		return false;
+	input_fill += (size_t)retval;
+	return true;
+}
+
+/**
+ * Make sure there is a current line with unread data in it.
+ * @return False on end of file.
+ */
 FUNGE_ATTR_WARN_UNUSED
 static inline bool get_line(void)
 {
-	if (!lastline || !lastline_current || IS_LINE_END(lastline_current)) {
+	const char *newline;
+	if (FUNGE_LIKELY(input_pos < line_end))
+		return true;
+	if (FUNGE_UNLIKELY(replay_playing())) {
+		unsigned char *data;
 		ssize_t retval;
-		fflush(stdout);
-		retval = cf_getline(&lastline, &linesize, stdin);
+		output_flush();
+		retval = replay_read_bytes(replay_event_input, &data);
 		if (retval == -1)
 			return false;
-		lastline_current = lastline;
-		linelength = retval;
+		free(input_buffer);
+		input_buffer = (char*)data;
+		input_size = (size_t)retval + 1;
+		input_fill = line_end = (size_t)retval;
+		input_pos = 0;
+		return true;
 	}
+	// Find the end of the next line, reading more as needed.
+	while (!(newline = memchr(input_buffer + input_pos, '\n', input_fill - input_pos))) {
+		if (input_eof || !fill_buffer()) {
+			input_eof = true;
+			break;
+		}
+	}
+	if (newline)
+		line_end = (size_t)(newline - input_buffer) + 1;
+	else
+		line_end = input_fill;
+	if (input_pos == line_end) {
+		replay_write_bytes(replay_event_input, NULL, -1);
+		return false;
+	}
+	replay_write_bytes(replay_event_input, input_buffer + input_pos, (ssize_t)(line_end - input_pos));
 	return true;
 }
 
 static inline void discard_line(void)
 {
-	if (lastline != NULL)
-		free(lastline);
-	lastline = NULL;
-	linelength = 0;
-	linesize = 0;
-	lastline_current = NULL;
+	input_pos = line_end;
 }
 
 
 FUNGE_ATTR_FAST bool input_getchar(funge_cell * restrict chr)
 {
-	unsigned char tmp;
 	if (!get_line())
 		return false;
-	tmp = *((unsigned char*)lastline_current);
-	lastline_current++;
-	if (lastline_current && IS_LINE_END(lastline_current))
-		discard_line();
-	*chr = (funge_cell)tmp;
+	*chr = (funge_cell)(unsigned char)input_buffer[input_pos++];
 	return true;
 }
 
 FUNGE_ATTR_FAST bool input_getline(unsigned char ** str)
 {
+	size_t length;
 	if (!get_line())
 		return false;
-	// TODO: How to handle zero bytes?
-	*str = (unsigned char*)strdup(lastline_current);
+	length = line_end - input_pos;
+	*str = malloc(length + 1);
+	if (FUNGE_UNLIKELY(!*str))
+		return false;
+	memcpy(*str, input_buffer + input_pos, length);
+	(*str)[length] = '\0';
 	discard_line();
 	return true;
 }
 
 
-static const char digits[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+/// Value of c as a digit, or 36 if it isn't one.
+FUNGE_ATTR_FAST FUNGE_ATTR_CONST
+static inline funge_cell digit_value(unsigned char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'z')
+		return c - 'a' + 10;
+	return 36;
+}
 
 // Start of s as if it is in base.
 // Unlike strtoll this does not clamp on overflow but stop reading just before
@@ -99,10 +210,10 @@ static const char digits[] = "0123456789abcdefghijklmnopqrstuvwxyz";
 // Converted value is returned in *value.
 // Return value is last index used in string.
 FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL FUNGE_ATTR_WARN_UNUSED
-static inline ptrdiff_t parse_int(const char * restrict s,
-                                  funge_cell * restrict value,
-                                  funge_cell base,
-                                  const size_t length)
+static inline size_t parse_int(const char * restrict s,
+                               funge_cell * restrict value,
+                               funge_cell base,
+                               const size_t length)
 {
 	funge_cell result = 0;
 	size_t i;
@@ -110,64 +221,54 @@ static inline ptrdiff_t parse_int(const char * restrict s,
 	assert(s != NULL);
 	assert(value != NULL);
 
-	for (i = 0; i <= length; i++) {
+	for (i = 0; i < length; i++) {
+		funge_cell tmp;
 		// Will it overflow?
 		if (result > (FUNGECELL_MAX / base))
 			break;
-		{
-			funge_cell tmp;
-			char c = s[i];
-			// Pointer into digits.
-			const char *p = strchr(digits, c);
-			// Still a digit?
-			if (!p || ((p - digits) >= (ptrdiff_t) base))
-				break;
-
-			tmp = (funge_cell) (p - digits);
-			// Break if it will overflow!
-			if ((result * base) > (FUNGECELL_MAX - tmp))
-				break;
-			result = (result * base) + tmp;
-		}
+		// Still a digit?
+		tmp = digit_value((unsigned char)s[i]);
+		if (tmp >= base)
+			break;
+		// Break if it will overflow!
+		if ((result * base) > (FUNGECELL_MAX - tmp))
+			break;
+		result = (result * base) + tmp;
 	}
 	*value = result;
-	return (ptrdiff_t)i;
+	return i;
 }
 
-// Note, no need to optimise really, this is user input
-// bound anyway.
 FUNGE_ATTR_FAST ret_getint input_getint(funge_cell * restrict value, int base)
 {
-	bool found = false;
-	char * endptr = NULL;
+	size_t end;
 	assert(value != NULL);
 
 	if (!get_line())
 		return rgi_eof;
 	// Find first char that is a number, then convert number.
-	do {
+	for (; input_pos < line_end; input_pos++) {
+		const unsigned char c = (unsigned char)input_buffer[input_pos];
 		if (base == 10) {
-			if (!isdigit(*lastline_current))
+			if (!isdigit(c))
 				continue;
 		} else if (base == 16) {
-			if (!isxdigit(*lastline_current))
-				continue;
-		} else {
-			const char * p = strchr(digits, *lastline_current);
-			if (!p || ((p - digits) >= (ptrdiff_t)base))
+			if (!isxdigit(c))
 				continue;
+		} else if (digit_value(c) >= base) {
+			continue;
 		}
-		found = true;
-		// Ok, we found it, lets convert it.
-		endptr = lastline_current
-		         + parse_int(lastline_current, value, (funge_cell)base,
-		                     lastline_current - lastline + linelength);
 		break;
-	} while ((size_t)((lastline_current++) - lastline) < linelength);
+	}
+	if (input_pos == line_end)
+		return rgi_noint;
+	// Ok, we found it, lets convert it.
+	end = input_pos + parse_int(input_buffer + input_pos, value, (funge_cell)base,
+	                            line_end - input_pos);
 	// Discard rest of line if it is just newline, otherwise keep it.
-	if (endptr && ((*endptr == '\n') || (*endptr == '\r') || IS_LINE_END(endptr)))
+	if (IS_LINE_END(end) || (input_buffer[end] == '\n') || (input_buffer[end] == '\r'))
 		discard_line();
 	else
-		lastline_current = endptr;
-	return found ? rgi_success : rgi_noint;
+		input_pos = end;
+	return rgi_success;
 }
@@ -23,6 +23,7 @@
 #include "execute.h"
 #include "../stack.h"
 #include "../ip.h"
+#include "../output.h"
 #include "../settings.h"
 
 #include <assert.h>
@@ -44,18 +45,19 @@ FUNGE_ATTR_FAST void run_system_execute(instructionPointer * restrict ip)
 	}
 
 	{
-		char * restrict command;
+		const char * restrict command;
 		int retval;
 		// Pop stuff.
-		command = (char*)stack_pop_string(ip->stack, NULL);
+		command = (const char*)stack_pop_string_scratch(ip->stack, NULL);
 
 		// Sanity test!
 		if (!command || (*command == '\0')) {
-			stack_free_string(command);
 			stack_push(ip->stack, FUNGE_NOCOMMAND);
 			return;
 		}
 
+		// Keep our output before that of the command.
+		output_flush();
 		retval = system(command);
 		// POSIX says we may only use WEXITSTATUS if WIFEXITED returns true...
 		if (WIFEXITED(retval)) {
@@ -63,6 +65,5 @@ FUNGE_ATTR_FAST void run_system_execute(instructionPointer * restrict ip)
 		} else {
 			stack_push(ip->stack, (funge_cell)retval);
 		}
-		stack_free_string(command);
 	}
 }
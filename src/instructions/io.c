@@ -41,17 +41,16 @@ FUNGE_ATTR_FAST void run_file_input(instructionPointer * restrict ip)
 	}
 
 	{
-		char * restrict filename;
+		const char * restrict filename;
 		bool binary;
 		funge_vector offset;
 		funge_vector size;
 
 		// Pop stuff.
-		filename = (char*)stack_pop_string(ip->stack, NULL);
+		filename = (const char*)stack_pop_string_scratch(ip->stack, NULL);
 
 		// Sanity test!
 		if (!filename || *filename == '\0') {
-			stack_free_string(filename);
 			ip_reverse(ip);
 			return;
 		}
@@ -67,7 +66,6 @@ FUNGE_ATTR_FAST void run_file_input(instructionPointer * restrict ip)
 			stack_push_vector(ip->stack, &size);
 			stack_push_vector(ip->stack, &offset);
 		}
-		stack_free_string(filename);
 	}
 }
 
@@ -81,20 +79,19 @@ FUNGE_ATTR_FAST void run_file_output(instructionPointer * restrict ip)
 	}
 
 	{
-		char * restrict filename;
+		const char * restrict filename;
 		bool textfile;
 		funge_vector offset;
 		funge_vector size;
 
 		// Pop stuff.
-		filename = (char*)stack_pop_string(ip->stack, NULL);
+		filename = (const char*)stack_pop_string_scratch(ip->stack, NULL);
 		textfile = (bool)(stack_pop(ip->stack) & 1);
 		offset = stack_pop_vector(ip->stack);
 		size = stack_pop_vector(ip->stack);
 
 		// Sanity test!
 		if (!filename || *filename == '\0' || size.x < 1 || size.y < 1) {
-			stack_free_string(filename);
 			ip_reverse(ip);
 			return;
 		}
@@ -103,7 +100,6 @@ FUNGE_ATTR_FAST void run_file_output(instructionPointer * restrict ip)
 		                             vector_create_ref(offset.x + ip->storageOffset.x, offset.y + ip->storageOffset.y),
 		                             &size, textfile))
 			ip_reverse(ip);
-		stack_free_string(filename);
 	}
 
 }
@@ -27,6 +27,7 @@
 #include "../ip.h"
 #include "../main.h"                    /* fungeargc, fungeargv */
 #include "../rect.h"
+#include "../replay.h"
 #include "../settings.h"
 #include "../stack.h"
 #include "../vector.h"
@@ -55,8 +56,6 @@ extern char **environ;
 #  endif
 #endif
 
-/// Temp stack for pushing on when needed. Faster.
-static funge_stack* restrict sysinfo_tmp_stack = NULL;
 /// Cache stack for env vars (since we don't implement EVAR this works fine)
 /// and argv.
 static funge_stack* restrict sysinfo_cache_stack = NULL;
@@ -239,7 +238,7 @@ static void push_all(instructionPointer * restrict ip, funge_stack * restrict pu
 
 	PUSH_REQ_18(pushStack, ip->stackstack);
 	PUSH_REQ_17(pushStack, ip);
-	now = time(NULL);
+	now = (time_t)replay_value(replay_event_time, time(NULL));
 	gmtime_r(&now, &curTime);
 	PUSH_REQ_16(pushStack, curTime);
 	PUSH_REQ_15(pushStack, curTime);
@@ -353,7 +352,7 @@ static void push_yval(funge_cell request, instructionPointer * restrict ip, fung
 		case 20: { // Date ((year - 1900) * 256 * 256) + (month * 256) + (day of month)
 			time_t now;
 			struct tm curTime;
-			now = time(NULL);
+			now = (time_t)replay_value(replay_event_time, time(NULL));
 			gmtime_r(&now, &curTime);
 			PUSH_REQ_15(pushStack, curTime);
 			break;
@@ -361,7 +360,7 @@ static void push_yval(funge_cell request, instructionPointer * restrict ip, fung
 		case 21: { // Time (hour * 256 * 256) + (minute * 256) + (second)
 			time_t now;
 			struct tm curTime;
-			now = time(NULL);
+			now = (time_t)replay_value(replay_event_time, time(NULL));
 			gmtime_r(&now, &curTime);
 			PUSH_REQ_16(pushStack, curTime);
 			break;
@@ -389,25 +388,26 @@ void run_sys_info(instructionPointer *ip)
 		// Simple to get single cell in this range
 	} else if (request < 24) {
 		push_yval(request, ip, ip->stack);
-		// Large positive, hard to calculate in advance, or may even be pick.
+		// Sizes of the other stacks, environment, argv or pick. These are laid
+		// out just as push_all() would, but only the requested cell is read.
 	} else {
-		if (FUNGE_UNLIKELY(!sysinfo_tmp_stack)) {
-			sysinfo_tmp_stack = stack_create();
-			if (FUNGE_UNLIKELY(!sysinfo_tmp_stack))
-				DIAG_OOM("Failed to allocate temp stack for sysinfo!");
+		const size_t stack_count = ip->stackstack->current;
+		size_t index = (size_t)request - 23;
+		if (index <= stack_count) {
+			stack_push(ip->stack, (funge_cell)ip->stackstack->stacks[stack_count - index]->top);
+			return;
 		}
-		// TODO: We can probably skip pushing env and cmd line args every time.
-		push_all(ip, sysinfo_tmp_stack);
-		// Find out if we should act as pick or not...
-		// TODO: We can pre-calculate this really, if we have the env cache
-		// stack size + number of stack-stacks.
-		if (sysinfo_tmp_stack->top >= (size_t)request) {
-			stack_push(ip->stack, sysinfo_tmp_stack->entries[sysinfo_tmp_stack->top - (size_t)request]);
+		index -= stack_count;
+		if (FUNGE_UNLIKELY(!sysinfo_cache_stack))
+			create_cache_stack();
+		assert(sysinfo_cache_stack != NULL);
+		if (index <= sysinfo_cache_stack->top) {
+			stack_push(ip->stack, sysinfo_cache_stack->entries[sysinfo_cache_stack->top - index]);
 		} else {
 			// Act as pick
-			stack_push(ip->stack, stack_get_index(ip->stack, ip->stack->top + 1 - (request - sysinfo_tmp_stack->top)));
+			const size_t total = 23 + stack_count + sysinfo_cache_stack->top;
+			stack_push(ip->stack, stack_get_index(ip->stack, ip->stack->top + 1 - ((size_t)request - total)));
 		}
-		stack_clear(sysinfo_tmp_stack);
 	}
 }
 
@@ -416,8 +416,6 @@ void run_sys_info(instructionPointer *ip)
 FUNGE_ATTR_FAST
 void sysinfo_cleanup(void)
 {
-	if (sysinfo_tmp_stack)
-		stack_free(sysinfo_tmp_stack);
 	if (sysinfo_cache_stack)
 		stack_free(sysinfo_cache_stack);
 }
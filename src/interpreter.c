@@ -22,14 +22,21 @@
 #include "global.h"
 #include "interpreter.h"
 
+#include "checkpoint.h"
 #include "diagnostic.h"
 #include "division.h"
 #include "funge-space/funge-space.h"
+#include "image.h"
 #include "input.h"
 #include "ip.h"
+#include "output.h"
 #include "prng.h"
+#include "profile.h"
+#include "replay.h"
 #include "settings.h"
 #include "stack.h"
+#include "stats.h"
+#include "trace.h"
 #include "vector.h"
 
 #include "fingerprints/manager.h"
@@ -67,11 +74,10 @@ static instructionPointer *IP = NULL;
 #endif
 /*@}*/
 
-/**
- * Print warning on unknown instruction if such warnings are enabled.
- */
-FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL
-static inline void warn_unknown_instr(funge_cell opcode, instructionPointer * restrict ip)
+/// Deltas for ?, indexed by prng_generate_direction().
+static const funge_vector random_deltas[4] = { {0, -1}, {1, 0}, {0, 1}, {-1, 0} };
+
+FUNGE_ATTR_FAST void warn_unknown_instr(funge_cell opcode, instructionPointer * restrict ip)
 {
 	if (FUNGE_UNLIKELY(setting_enable_warnings))
 		diag_warn_format("Unknown instruction at x=%" FUNGECELLPRI " y=%" FUNGECELLPRI ": %c (%" FUNGECELLPRI ")",
@@ -140,20 +146,15 @@ static inline CON_RETTYPE handle_string_mode(funge_cell opcode, instructionPoint
 FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL
 static inline void handle_fprint(funge_cell opcode, instructionPointer * restrict ip)
 {
-	if (FUNGE_UNLIKELY(setting_disable_fingerprints)) {
-		warn_unknown_instr(opcode, ip);
-		ip_reverse(ip);
-	} else {
-		int_fast8_t entry = (int_fast8_t)(opcode - 'A');
-		if ((ip->fingerOpcodes[entry].top > 0)
-		    && ip->fingerOpcodes[entry].entries[ip->fingerOpcodes[entry].top - 1]) {
-			// Call the fingerprint.
-			ip->fingerOpcodes[entry].entries[ip->fingerOpcodes[entry].top - 1](ip);
-		} else {
-			warn_unknown_instr(opcode, ip);
-			ip_reverse(ip);
-		}
+#ifndef DISABLE_PROFILE
+	if (FUNGE_UNLIKELY(setting_profile_file)) {
+		profile_fingerprint(ip, opcode);
+		return;
 	}
+#endif
+	// Instructions without a fingerprint (including when fingerprints are
+	// disabled) have a stub that warns and reflects, so no checks needed.
+	ip->fingerTop[opcode - 'A'](ip);
 }
 
 #ifdef CONCURRENT_FUNGE
@@ -178,6 +179,7 @@ FUNGE_ATTR_FAST CON_RETTYPE execute_instruction(funge_cell opcode, instructionPo
 #endif
 				do {
 					ip_forward(ip);
+					STATS_INC(stat_space_skips);
 #ifdef AFL_FUZZ_TESTING
 					if (!iterations--)
 						exit(123);
@@ -231,18 +233,9 @@ FUNGE_ATTR_FAST CON_RETTYPE execute_instruction(funge_cell opcode, instructionPo
 				ip->needMove = false;
 				break;
 			}
-			case '?': {
-				// May not be perfectly uniform.
-				// If this matters for you, contact me (with a patch).
-				funge_unsigned_cell rnd = prng_generate_unsigned(4);
-				switch (rnd) {
-					case 0: ip_go_north(ip); break;
-					case 1: ip_go_east(ip); break;
-					case 2: ip_go_south(ip); break;
-					case 3: ip_go_west(ip); break;
-				}
+			case '?':
+				ip->delta = random_deltas[prng_generate_direction()];
 				break;
-			}
 			case 'r':
 				ip_reverse(ip);
 				break;
@@ -401,13 +394,13 @@ FUNGE_ATTR_FAST CON_RETTYPE execute_instruction(funge_cell opcode, instructionPo
 			case ',': {
 				funge_cell a = stack_pop(ip->stack);
 				// Reverse on failed output
-				if (FUNGE_UNLIKELY(cf_putchar_unlocked((int)a) != (unsigned char)a))
+				if (FUNGE_UNLIKELY(!output_putchar(a)))
 					ip_reverse(ip);
 				break;
 			}
 			case '.':
 				// Reverse on failed output
-				if (FUNGE_UNLIKELY(printf("%" FUNGECELLPRI " ", stack_pop(ip->stack)) < 0))
+				if (FUNGE_UNLIKELY(!output_number(stack_pop(ip->stack))))
 					ip_reverse(ip);
 				break;
 
@@ -538,7 +531,7 @@ FUNGE_ATTR_FAST CON_RETTYPE execute_instruction(funge_cell opcode, instructionPo
 			case '@':
 #ifdef CONCURRENT_FUNGE
 				if (IPList->top == 0) {
-					fflush(stdout);
+					output_flush();
 					exit(0);
 				} else {
 					*threadindex = iplist_terminate_ip(&IPList, *threadindex);
@@ -593,7 +586,15 @@ static inline void interpreter_main_loop(void)
 #endif
 #ifdef CONCURRENT_FUNGE
 	while (true) {
-		ssize_t i = IPList->top;
+		ssize_t i;
+		// Only between ticks, the list restarts from the top on resume.
+		if (FUNGE_UNLIKELY(checkpoint_requested))
+			checkpoint_write(IPList);
+		if (FUNGE_UNLIKELY(stats_requested)) {
+			stats_requested = 0;
+			stats_print();
+		}
+		i = IPList->top;
 #    ifdef AFL_FUZZ_TESTING
 		long thread_iterations = 1000;
 		// Give up after too many instructions
@@ -608,6 +609,7 @@ static inline void interpreter_main_loop(void)
 				exit(123);
 #    endif
 
+			STATS_INC(stat_instructions);
 #    ifdef LARGE_IPLIST
 			opcode = fungespace_get(&IPList->ips[i]->position);
 #    else
@@ -628,6 +630,8 @@ static inline void interpreter_main_loop(void)
 				} else if (setting_trace_level > 2)
 					fprintf(stderr, "%c", (char)opcode);
 			}
+			if (FUNGE_UNLIKELY(setting_trace_file))
+				trace_record(IPList->ips[i], opcode);
 #    elif !defined(DISABLE_TRACE) && !defined(LARGE_IPLIST)
 			if (FUNGE_UNLIKELY(setting_trace_level != 0)) {
 				if (setting_trace_level > 8) {
@@ -642,18 +646,38 @@ static inline void interpreter_main_loop(void)
 				} else if (setting_trace_level > 2)
 					fprintf(stderr, "%c", (char)opcode);
 			}
+			if (FUNGE_UNLIKELY(setting_trace_file))
+				trace_record(&IPList->ips[i], opcode);
 #    endif /* DISABLE_TRACE */
+#    if !defined(DISABLE_PROFILE) && defined(LARGE_IPLIST)
+			if (FUNGE_UNLIKELY(setting_profile_file))
+				profile_instruction(IPList->ips[i], opcode);
+#    elif !defined(DISABLE_PROFILE)
+			if (FUNGE_UNLIKELY(setting_profile_file))
+				profile_instruction(&IPList->ips[i], opcode);
+#    endif
 
 #    ifdef LARGE_IPLIST
 			retval = execute_instruction(opcode, IPList->ips[i], &i);
+#      ifndef DISABLE_PROFILE
+			if (FUNGE_UNLIKELY(profile_sample_pending))
+				profile_sample(IPList->ips[i]);
+#      endif
 			thread_forward(IPList->ips[i]);
 #    else
 			retval = execute_instruction(opcode, &IPList->ips[i], &i);
+#      ifndef DISABLE_PROFILE
+			if (FUNGE_UNLIKELY(profile_sample_pending))
+				profile_sample(&IPList->ips[i]);
+#      endif
 			thread_forward(&IPList->ips[i]);
 #    endif
 			if (!retval)
 				i--;
 		}
+#    ifndef DISABLE_TRACE
+		trace_tick++;
+#    endif
 	}
 #else /* CONCURRENT_FUNGE */
 	while (true) {
@@ -663,6 +687,13 @@ static inline void interpreter_main_loop(void)
 		if (!iterations--)
 			exit(123);
 #    endif
+		if (FUNGE_UNLIKELY(checkpoint_requested))
+			checkpoint_write(IP);
+		if (FUNGE_UNLIKELY(stats_requested)) {
+			stats_requested = 0;
+			stats_print();
+		}
+		STATS_INC(stat_instructions);
 		opcode = fungespace_get(&IP->position);
 #    ifndef DISABLE_TRACE
 		if (FUNGE_UNLIKELY(setting_trace_level != 0)) {
@@ -676,9 +707,20 @@ static inline void interpreter_main_loop(void)
 			} else if (setting_trace_level > 2)
 				fprintf(stderr, "%c", (char)opcode);
 		}
+		if (FUNGE_UNLIKELY(setting_trace_file))
+			trace_record(IP, opcode);
 #    endif /* DISABLE_TRACE */
+#    ifndef DISABLE_PROFILE
+		if (FUNGE_UNLIKELY(setting_profile_file))
+			profile_instruction(IP, opcode);
+#    endif
 
 		execute_instruction(opcode, IP);
+#    ifndef DISABLE_PROFILE
+		// Before moving, so the sample is for the instruction just executed.
+		if (FUNGE_UNLIKELY(profile_sample_pending))
+			profile_sample(IP);
+#    endif
 		if (IP->needMove)
 			ip_forward(IP);
 		else
@@ -728,33 +770,77 @@ void klee_generate_program(void)
 #endif
 
 
+FUNGE_ATTR_NONNULL FUNGE_ATTR_FAST
+void interpreter_foreach_ip(void (*func)(instructionPointer * ip))
+{
+#ifdef CONCURRENT_FUNGE
+	for (size_t i = 0; i <= IPList->top; i++) {
+#  ifdef LARGE_IPLIST
+		func(IPList->ips[i]);
+#  else
+		func(&IPList->ips[i]);
+#  endif
+	}
+#else
+	func(IP);
+#endif
+}
+
+
 FUNGE_ATTR_NORET FUNGE_ATTR_FAST
 void interpreter_run(const char *filename)
 {
-	if (FUNGE_UNLIKELY(!fungespace_create())) {
+	// Before loading any image, which may restore the PRNG state.
+	prng_init();
+	if (setting_image_load) {
+		// This replaces creating and loading Funge-Space as well as creating
+		// the IPs.
+#ifdef CONCURRENT_FUNGE
+		IPList = image_load(setting_image_load);
+#else
+		IP = image_load(setting_image_load);
+#endif
+	} else if (FUNGE_UNLIKELY(!fungespace_create())) {
 		DIAG_FATAL_FORMAT_LOC("Couldn't create funge space: %s", strerror(errno));
 	}
 #if !defined(NDEBUG) && !defined(CFUN_KLEE_TEST)
 	atexit(&debug_free);
 #endif
-	prng_init();
+	if (!setting_image_load) {
 #ifdef CFUN_KLEE_TEST_PROGRAM
-	klee_generate_program();
+		klee_generate_program();
 #else
-	if (FUNGE_UNLIKELY(!fungespace_load(filename))) {
-		diag_fatal_format("Failed to process file \"%s\": %s", filename, strerror(errno));
-	}
+		if (FUNGE_UNLIKELY(!fungespace_load(filename))) {
+			diag_fatal_format("Failed to process file \"%s\": %s", filename, strerror(errno));
+		}
 #endif
 #ifdef CONCURRENT_FUNGE
-	IPList = iplist_create();
-	if (FUNGE_UNLIKELY(IPList == NULL)) {
-		DIAG_FATAL_LOC("Couldn't create instruction pointer list!?");
-	}
+		IPList = iplist_create();
+		if (FUNGE_UNLIKELY(IPList == NULL)) {
+			DIAG_FATAL_LOC("Couldn't create instruction pointer list!?");
+		}
 #else
-	IP = ip_create();
-	if (FUNGE_UNLIKELY(IP == NULL)) {
-		DIAG_FATAL_LOC("Couldn't create instruction pointer!?");
+		IP = ip_create();
+		if (FUNGE_UNLIKELY(IP == NULL)) {
+			DIAG_FATAL_LOC("Couldn't create instruction pointer!?");
+		}
+#endif
 	}
+	if (setting_image_save) {
+#ifdef CONCURRENT_FUNGE
+		if (FUNGE_UNLIKELY(!image_save(setting_image_save, IPList))) {
+#else
+		if (FUNGE_UNLIKELY(!image_save(setting_image_save, IP))) {
 #endif
+			diag_fatal_format("Failed to write image \"%s\": %s", setting_image_save, strerror(errno));
+		}
+		exit(EXIT_SUCCESS);
+	}
+	output_init(setting_fully_buffered);
+	profile_init();
+	trace_init();
+	stats_init();
+	replay_init();
+	checkpoint_init();
 	interpreter_main_loop();
 }
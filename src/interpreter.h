@@ -48,6 +48,15 @@ void if_east_west(instructionPointer * restrict ip);
 FUNGE_ATTR_NONNULL FUNGE_ATTR_FAST
 void if_north_south(instructionPointer * restrict ip);
 
+/**
+ * Print warning on unknown instruction if such warnings are enabled. Also
+ * used for fingerprint instructions that no loaded fingerprint provides.
+ * @param opcode The instruction.
+ * @param ip The IP that tried to execute it.
+ */
+FUNGE_ATTR_NONNULL FUNGE_ATTR_FAST
+void warn_unknown_instr(funge_cell opcode, instructionPointer * restrict ip);
+
 /**
  * Run instruction. Different prototype depending on if CONCURRENT_FUNGE
  * is defined or not.
@@ -69,6 +78,14 @@ void execute_instruction(funge_cell opcode,
                          instructionPointer * restrict ip);
 #endif
 
+/**
+ * Call a function for each IP that is running. For fingerprints that need to
+ * look at the stacks of all IPs.
+ * @param func Function to call, must not create or terminate IPs.
+ */
+FUNGE_ATTR_NONNULL FUNGE_ATTR_FAST
+void interpreter_foreach_ip(void (*func)(instructionPointer * ip));
+
 /**
  * Start interpreter on a specific filename.
  * @warning MUST only be called from main.c
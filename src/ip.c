@@ -29,9 +29,11 @@
 #endif
 
 #include "diagnostic.h"
+#include "image.h"
 #include "interpreter.h"
 #include "settings.h"
 #include "stack.h"
+#include "stats.h"
 #include "vector.h"
 
 #include "fingerprints/manager.h"
@@ -66,10 +68,7 @@ static inline bool ip_create_in_place(instructionPointer *me)
 		return false;
 	me->stack                = me->stackstack->stacks[me->stackstack->current];
 	me->ID                   = 0;
-	// Zero the opcode stacks if needed.
-	if (FUNGE_LIKELY(!setting_disable_fingerprints)) {
-		memset(me->fingerOpcodes, 0, sizeof(fungeOpcodeStack) * FINGEROPCODECOUNT);
-	}
+	manager_create(me);
 	me->fingerHRTItimestamp  = NULL;
 	return true;
 }
@@ -145,6 +144,88 @@ FUNGE_ATTR_FAST void ip_free(instructionPointer * restrict ip)
 }
 #endif
 
+/**********
+ * Images *
+ **********/
+
+/**
+ * Write the state of a single IP to an image.
+ * @note Loaded fingerprints are saved, but not any fingerprint internal state.
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL FUNGE_ATTR_WARN_UNUSED
+static inline bool ip_save_image_in_place(FILE * restrict file,
+                                          const instructionPointer * restrict me)
+{
+	return image_write_value(file, me->position)
+	       && image_write_value(file, me->delta)
+	       && image_write_value(file, me->storageOffset)
+	       && image_write_value(file, me->mode)
+	       && image_write_value(file, me->needMove)
+	       && image_write_value(file, me->stringLastWasSpace)
+	       && image_write_value(file, me->fingerSUBRisRelative)
+	       && image_write_value(file, me->ID)
+	       && stackstack_save_image(file, me->stackstack)
+	       && manager_save_image(file, me);
+}
+
+/**
+ * Initialise an IP from an image, this is the image equivalent of
+ * ip_create_in_place().
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL FUNGE_ATTR_WARN_UNUSED
+static inline bool ip_load_image_in_place(FILE * restrict file,
+                                          instructionPointer * restrict me)
+{
+	if (!image_read_value(file, me->position)
+	    || !image_read_value(file, me->delta)
+	    || !image_read_value(file, me->storageOffset)
+	    || !image_read_value(file, me->mode)
+	    || !image_read_value(file, me->needMove)
+	    || !image_read_value(file, me->stringLastWasSpace)
+	    || !image_read_value(file, me->fingerSUBRisRelative)
+	    || !image_read_value(file, me->ID))
+		return false;
+	me->stackstack = stackstack_load_image(file);
+	if (FUNGE_UNLIKELY(!me->stackstack))
+		return false;
+	me->stack = me->stackstack->stacks[me->stackstack->current];
+	manager_create(me);
+	me->fingerHRTItimestamp  = NULL;
+	return manager_load_image(file, me);
+}
+
+#ifndef CONCURRENT_FUNGE
+FUNGE_ATTR_FAST bool ip_save_image(FILE * restrict file, const instructionPointer * restrict ip)
+{
+	// Same layout as iplist_save_image() with a single IP.
+	uint64_t count = 1;
+	uint64_t highestID = 0;
+
+	return image_write_value(file, count)
+	       && image_write_value(file, highestID)
+	       && ip_save_image_in_place(file, ip);
+}
+
+FUNGE_ATTR_FAST instructionPointer * ip_load_image(FILE * restrict file)
+{
+	instructionPointer * tmp;
+	uint64_t count;
+	uint64_t highestID;
+
+	if (!image_read_value(file, count) || !image_read_value(file, highestID)
+	    || (count != 1))
+		return NULL;
+	tmp = (instructionPointer*)malloc(sizeof(instructionPointer));
+	if (FUNGE_UNLIKELY(!tmp))
+		return NULL;
+	if (FUNGE_UNLIKELY(!ip_load_image_in_place(file, tmp))) {
+		free(tmp);
+		return NULL;
+	}
+	return tmp;
+}
+#endif
+
 FUNGE_ATTR_FAST inline void ip_set_position(instructionPointer * restrict ip, const funge_vector * restrict position)
 {
 	assert(ip != NULL);
@@ -199,6 +280,70 @@ ipList* iplist_create(void)
 	return list;
 }
 
+FUNGE_ATTR_FAST bool iplist_save_image(FILE * restrict file, const ipList * restrict me)
+{
+	uint64_t count = me->top + 1;
+	uint64_t highestID = me->highestID;
+
+	if (!image_write_value(file, count) || !image_write_value(file, highestID))
+		return false;
+	for (size_t i = 0; i <= me->top; i++) {
+#  ifdef LARGE_IPLIST
+		if (!ip_save_image_in_place(file, me->ips[i]))
+#  else
+		if (!ip_save_image_in_place(file, &me->ips[i]))
+#  endif
+			return false;
+	}
+	return true;
+}
+
+FUNGE_ATTR_FAST ipList* iplist_load_image(FILE * restrict file)
+{
+	ipList *list;
+	uint64_t count;
+	uint64_t highestID;
+	size_t size;
+
+	if (!image_read_value(file, count) || !image_read_value(file, highestID))
+		return NULL;
+	if ((count == 0) || (count > SIZE_MAX / sizeof(instructionPointer) - ALLOCCHUNKSIZE))
+		return NULL;
+	// Round upwards to whole ALLOCCHUNKSIZE sized blocks.
+	size = (size_t)count + ALLOCCHUNKSIZE - ((size_t)count % ALLOCCHUNKSIZE);
+
+#ifdef LARGE_IPLIST
+	list = malloc(sizeof(ipList) + sizeof(instructionPointer*) * size);
+	if (FUNGE_UNLIKELY(!list))
+		return NULL;
+
+	if (FUNGE_UNLIKELY(!cf_mempool_ip_setup())) {
+		free(list);
+		return NULL;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		list->ips[i] = cf_mempool_ip_alloc();
+		if (FUNGE_UNLIKELY(!list->ips[i]))
+			return NULL;
+		if (FUNGE_UNLIKELY(!ip_load_image_in_place(file, list->ips[i])))
+			return NULL;
+	}
+#else
+	list = malloc(sizeof(ipList) + sizeof(instructionPointer) * size);
+	if (FUNGE_UNLIKELY(!list))
+		return NULL;
+	for (size_t i = 0; i < count; i++) {
+		if (FUNGE_UNLIKELY(!ip_load_image_in_place(file, &list->ips[i])))
+			return NULL;
+	}
+#endif
+	list->size = size;
+	list->top = (size_t)count - 1;
+	list->highestID = (size_t)highestID;
+	return list;
+}
+
 #ifndef NDEBUG
 FUNGE_ATTR_FAST void iplist_free(ipList* me)
 {
@@ -226,6 +371,7 @@ FUNGE_ATTR_FAST ssize_t iplist_duplicate_ip(ipList** me, size_t index)
 	assert(*me != NULL);
 	assert(index <= (*me)->top);
 
+	STATS_INC(stat_ip_spawns);
 	list = *me;
 
 	// Grow if needed
@@ -304,6 +450,7 @@ FUNGE_ATTR_FAST ssize_t iplist_terminate_ip(ipList** me, size_t index)
 	assert(me != NULL);
 	assert(*me != NULL);
 
+	STATS_INC(stat_ip_kills);
 	list = *me;
 
 	/*
@@ -32,6 +32,7 @@
 
 #include <sys/types.h>
 #include <stdint.h>
+#include <stdio.h>
 
 #include "stack.h"
 #include "vector.h"
@@ -45,9 +46,6 @@
 /// Type of the ipMode entry.
 typedef uint_fast8_t ipMode;
 
-/// This is for size of opcode array.
-#define FINGEROPCODECOUNT 26
-
 /// Instruction pointer.
 /// @note
 /// Fields of the style fingerXXXX* are for fingerprint per-IP data.
@@ -66,7 +64,11 @@ typedef struct s_instructionPointer {
 	bool               fingerSUBRisRelative; ///< Data for fingerprint SUBR.
 	funge_cell         ID;                   ///< The ID of this IP.
 	funge_stackstack * stackstack;           ///< The stack stack.
-	fungeOpcodeStack   fingerOpcodes[FINGEROPCODECOUNT]; ///< Array of fingerprint opcodes.
+	fungeOpcodeStacks  fingerOpcodes;        ///< Fingerprint opcode stacks.
+	/// Top entry of each of fingerOpcodes, so instructions can be dispatched
+	/// without checks. Empty opcode stacks have a stub that warns and reflects.
+	/// Kept in sync by the fingerprint manager.
+	fingerprintOpcode  fingerTop[FINGEROPCODECOUNT];
 	void             * fingerHRTItimestamp;  ///< Data for fingerprint HRTI.
 	                                         ///  We don't know what type here.
 } instructionPointer;
@@ -96,6 +98,23 @@ typedef struct s_ipList {
  */
 FUNGE_ATTR_MALLOC FUNGE_ATTR_WARN_UNUSED
 instructionPointer * ip_create(void);
+
+/**
+ * Write the instruction pointer to an image.
+ * @param file Image file to write to.
+ * @param ip Instruction pointer to write.
+ * @return True if successful, otherwise false.
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL FUNGE_ATTR_WARN_UNUSED
+bool ip_save_image(FILE * restrict file,
+                   const instructionPointer * restrict ip);
+/**
+ * Create an instruction pointer from an image.
+ * @param file Image file to read from.
+ * @return The new instruction pointer, or NULL on error.
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL FUNGE_ATTR_MALLOC FUNGE_ATTR_WARN_UNUSED
+instructionPointer * ip_load_image(FILE * restrict file);
 #endif
 
 #if !defined(CONCURRENT_FUNGE) && !defined(NDEBUG)
@@ -194,6 +213,23 @@ void ip_set_position(instructionPointer * restrict ip, const funge_vector * rest
 FUNGE_ATTR_MALLOC FUNGE_ATTR_WARN_UNUSED
 ipList* iplist_create(void);
 
+/**
+ * Write all IPs in the list to an image.
+ * @param file Image file to write to.
+ * @param me ipList to write.
+ * @return True if successful, otherwise false.
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL FUNGE_ATTR_WARN_UNUSED
+bool iplist_save_image(FILE * restrict file, const ipList * restrict me);
+/**
+ * Create an IP list from an image.
+ * @warning Should only be called from internal setup code.
+ * @param file Image file to read from.
+ * @return The new ipList, or NULL on error.
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL FUNGE_ATTR_MALLOC FUNGE_ATTR_WARN_UNUSED
+ipList* iplist_load_image(FILE * restrict file);
+
 #ifndef NDEBUG
 /**
  * Free an IP list.
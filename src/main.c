@@ -26,6 +26,7 @@
 #include "global.h"
 #include "main.h"
 
+#include <errno.h>
 #include <stdio.h>  /* fprintf, puts */
 #include <stdlib.h> /* exit */
 #include <signal.h> /* signal */
@@ -47,9 +48,6 @@ int fungeargc = 0;
 
 // Exclude some code if we are building in IFFI.
 #ifndef CFUN_IS_IFFI
-// Use a larger buffer for stdout in fully buffered mode.
-static char cfun_iobuf[BUFSIZ * 4];
-
 // These are NOT worth inlineing, even though only called once.
 FUNGE_ATTR_NOINLINE FUNGE_ATTR_COLD FUNGE_ATTR_NORET
 static void print_features(void)
@@ -62,9 +60,9 @@ static void print_features(void)
 #endif
 
 #ifndef DISABLE_TRACE
-	     " + Tracing using -t <level> option is enabled.\n"
+	     " + Tracing using -t <level> and -T <file> options is enabled.\n"
 #else
-	     " - Tracing using -t <level> option is disabled.\n"
+	     " - Tracing using -t <level> and -T <file> options is disabled.\n"
 #endif
 
 #ifdef CFUN_EXACT_BOUNDS
@@ -73,6 +71,12 @@ static void print_features(void)
 	     " - This binary does not use exact bounds in y.\n"
 #endif
 
+#ifdef PRNG_PCG32
+	     " * Random numbers are generated with PCG32.\n"
+#else
+	     " * Random numbers are generated with xoshiro256**.\n"
+#endif
+
 #ifdef DEBUG
 	     " * This binary is a debug build.\n"
 #endif
@@ -115,19 +119,38 @@ static void print_help(void)
 {
 	puts("Usage: cfunge [OPTIONS] [FILE] [PROGRAM OPTIONS]\n"
 	     "A fast Befunge interpreter in C\n\n"
-	     " -b           Use fully buffered output (default is system default for stdout).\n"
+	     " -b           Use fully buffered output (default is line buffered on terminals).\n"
+	     " -C file      Write a checkpoint image to file on SIGUSR1 (resume with -I).\n"
 	     " -E           Show non-fatal error messages, fatal ones are always shown.\n"
 	     " -F           Disable all fingerprints.\n"
 	     " -f           Show list of features and fingerprints supported in this binary.\n"
 	     " -h           Show this help and exit.\n"
+	     " -I image     Load the initial state from image instead of from FILE.\n"
+	     " -m           Print runtime statistics to stderr on exit and on SIGUSR2.\n"
+	     " -O image     Write an image of the loaded program to image and exit.\n"
+	     " -P file      Profile execution, write a heatmap to file (PGM, or CSV if it\n"
+	     "              ends in .csv) and a histogram to stderr on exit.\n"
+	     " -p file      Sample execution with SIGPROF, write collapsed stacks (for\n"
+	     "              flame graphs) to file on exit.\n"
+	     " -R file      Replay random numbers, input and time recorded with -r from file.\n"
+	     " -r file      Record random numbers, input and time to file, for replay with -R.\n"
 	     " -S           Enable sandbox mode (see README for details).\n"
 	     " -s standard  Use the given standard (one of 93, 98 [default] and 109).\n"
+	     " -T file      Write a binary trace of the last instructions executed to file\n"
+	     "              (decode with tools/cfunge-trace.py).\n"
 	     " -t level     Use given trace level. Default 0.\n"
 	     " -V           Show version and copyright info and exit.\n"
 	     " -v           Show version and build info and exit.\n"
-	     " -W           Show warnings."
+	     " -W           Show warnings.\n"
+	     " -z seed      Seed the random number generator, for repeatable runs."
 #ifdef DISABLE_TRACE
-	     "\nNote that someone disabled trace in this binary, so -t will have no effect."
+	     "\nNote that someone disabled trace in this binary, so -t and -T will have no effect."
+#endif
+#ifdef DISABLE_PROFILE
+	     "\nNote that someone disabled profiling in this binary, so -P and -p will have no effect."
+#endif
+#ifdef DISABLE_STATS
+	     "\nNote that someone disabled statistics in this binary, so -m will print only zeros."
 #endif
 	    );
 	exit(EXIT_SUCCESS);
@@ -147,6 +170,16 @@ static void print_build_info(void)
 #else
 	       "-trace "
 #endif
+#ifndef DISABLE_PROFILE
+	       "+profile "
+#else
+	       "-profile "
+#endif
+#ifndef DISABLE_STATS
+	       "+stats "
+#else
+	       "-stats "
+#endif
 #ifdef CFUN_EXACT_BOUNDS
 	       "+exact-bounds "
 #else
@@ -233,10 +266,13 @@ int main(int argc, char *argv[])
 	// We detect socket issues in other ways.
 	signal(SIGPIPE, SIG_IGN);
 
-	while ((opt = getopt(argc, argv, "+bEFfhSs:t:VvW")) != -1) {
+	while ((opt = getopt(argc, argv, "+bC:EFfhI:mO:P:p:R:r:Ss:T:t:VvWz:")) != -1) {
 		switch (opt) {
 			case 'b':
-				setvbuf(stdout, cfun_iobuf, _IOFBF, sizeof(cfun_iobuf));
+				setting_fully_buffered = true;
+				break;
+			case 'C':
+				setting_checkpoint_file = optarg;
 				break;
 			case 'E':
 				setting_enable_errors = true;
@@ -250,6 +286,27 @@ int main(int argc, char *argv[])
 			case 'h':
 				print_help();
 				break;
+			case 'I':
+				setting_image_load = optarg;
+				break;
+			case 'm':
+				setting_print_stats = true;
+				break;
+			case 'O':
+				setting_image_save = optarg;
+				break;
+			case 'P':
+				setting_profile_file = optarg;
+				break;
+			case 'p':
+				setting_sample_file = optarg;
+				break;
+			case 'R':
+				setting_replay_file = optarg;
+				break;
+			case 'r':
+				setting_record_file = optarg;
+				break;
 			case 'S':
 				setting_enable_sandbox = true;
 				break;
@@ -264,6 +321,9 @@ int main(int argc, char *argv[])
 					diag_fatal_format("%s is not valid for -s.\n", optarg);
 				}
 				break;
+			case 'T':
+				setting_trace_file = optarg;
+				break;
 			case 't':
 				setting_trace_level = (uint_fast16_t)atoi(optarg);
 				break;
@@ -276,13 +336,29 @@ int main(int argc, char *argv[])
 			case 'W':
 				setting_enable_warnings = true;
 				break;
+			case 'z': {
+				char *end;
+				errno = 0;
+				setting_prng_seed = (uint64_t)strtoull(optarg, &end, 0);
+				if (errno != 0 || end == optarg || *end != '\0') {
+					diag_fatal_format("%s is not valid for -z.\n", optarg);
+				}
+				setting_prng_seed_set = true;
+				break;
+			}
 			default:
 				fprintf(stderr, "For help see: %s -h\n", argv[0]);
 				return EXIT_FAILURE;
 		}
 	}
 	if (FUNGE_UNLIKELY(optind >= argc)) {
-		diag_fatal("No file provided.");
+		if (!setting_image_load)
+			diag_fatal("No file provided.");
+		// The program file is optional when loading an image, the image
+		// takes its place as program name for y.
+		fungeargc = 1;
+		fungeargv = (const char * const *)&setting_image_load;
+		interpreter_run(setting_image_load);
 	} else {
 		// Store argument count and a pointer to argv[optind] for later use
 		// by the y instruction.
@@ -0,0 +1,213 @@
+/* -*- mode: C; coding: utf-8; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*-
+ *
+ * cfunge - A standard-conforming Befunge93/98/109 interpreter in C.
+ * Copyright (C) 2008-2013 Arvid Norlander <VorpalBlade AT users.noreply.github.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at the proxy's option) any later version. Arvid Norlander is a
+ * proxy who can decide which future versions of the GNU General Public
+ * License can be used.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "global.h"
+#include "output.h"
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdint.h>   /* uintptr_t */
+#include <stdio.h>    /* vsnprintf */
+#include <stdlib.h>   /* atexit, malloc */
+#include <string.h>   /* memchr, memcpy */
+#include <sys/uio.h>  /* writev */
+#include <unistd.h>   /* isatty, write */
+
+unsigned char output_buffer[OUTPUT_BUFFER_SIZE];
+size_t output_used = 0;
+bool output_line_buffered = false;
+
+/// Digit pairs for output_number().
+static const char output_digits[201] =
+	"00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+	"40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+	"8081828384858687888990919293949596979899";
+
+/**
+ * Write all of the given blocks to stdout, retrying on short writes.
+ * @param iov Blocks to write, modified.
+ * @param count Number of blocks.
+ * @return False if the write failed.
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL
+static bool write_blocks(struct iovec *iov, int count)
+{
+	while (count > 0) {
+		ssize_t written;
+		if (iov->iov_len == 0) {
+			iov++;
+			count--;
+			continue;
+		}
+		if (count == 1)
+			written = write(STDOUT_FILENO, iov->iov_base, iov->iov_len);
+		else
+			written = writev(STDOUT_FILENO, iov, count);
+		if (written < 0) {
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+		// Skip past what was written.
+		while (count > 0 && (size_t)written >= iov->iov_len) {
+			written -= (ssize_t)iov->iov_len;
+			iov++;
+			count--;
+		}
+		if (count > 0) {
+			iov->iov_base = (char*)iov->iov_base + written;
+			iov->iov_len -= (size_t)written;
+		}
+	}
+	return true;
+}
+
+FUNGE_ATTR_FAST
+bool output_flush(void)
+{
+	struct iovec iov;
+	bool success;
+	if (output_used == 0)
+		return true;
+	iov.iov_base = output_buffer;
+	iov.iov_len = output_used;
+	success = write_blocks(&iov, 1);
+	// Like stdio, drop the data on errors rather than trying again and again.
+	output_used = 0;
+	return success;
+}
+
+/// Flush at exit.
+static void output_atexit(void)
+{
+	output_flush();
+}
+
+FUNGE_ATTR_FAST
+void output_init(bool fully_buffered)
+{
+	output_line_buffered = !fully_buffered && isatty(STDOUT_FILENO);
+	atexit(output_atexit);
+}
+
+FUNGE_ATTR_FAST
+bool output_putchar_slow(unsigned char c)
+{
+	if (output_used == OUTPUT_BUFFER_SIZE && !output_flush())
+		return false;
+	output_buffer[output_used++] = c;
+	if (output_line_buffered && c == '\n')
+		return output_flush();
+	return true;
+}
+
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL
+bool output_write(const void * restrict data, size_t length)
+{
+	if (length <= OUTPUT_BUFFER_SIZE - output_used) {
+		memcpy(output_buffer + output_used, data, length);
+		output_used += length;
+		if (output_line_buffered && memchr(data, '\n', length))
+			return output_flush();
+		return true;
+	} else {
+		// Too large to fit, write it directly after what is buffered.
+		struct iovec iov[2];
+		bool success;
+		iov[0].iov_base = output_buffer;
+		iov[0].iov_len = output_used;
+		// writev() doesn't modify the data, it just isn't declared const.
+		iov[1].iov_base = (void*)(uintptr_t)data;
+		iov[1].iov_len = length;
+		success = write_blocks(iov, 2);
+		output_used = 0;
+		return success;
+	}
+}
+
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL
+bool output_string(const char * restrict str)
+{
+	return output_write(str, strlen(str));
+}
+
+FUNGE_ATTR_FAST
+bool output_number(funge_cell value)
+{
+	// Sign, digits and the trailing space.
+	char buf[FUNGE_CELL_BIT / 3 + 4];
+	char *p = buf + sizeof(buf);
+	// Convert to unsigned first so FUNGECELL_MIN works.
+	funge_unsigned_cell n = (value < 0) ? -(funge_unsigned_cell)value : (funge_unsigned_cell)value;
+
+	*--p = ' ';
+	while (n >= 100) {
+		const unsigned int i = (unsigned int)(n % 100) * 2;
+		n /= 100;
+		*--p = output_digits[i + 1];
+		*--p = output_digits[i];
+	}
+	if (n >= 10) {
+		const unsigned int i = (unsigned int)n * 2;
+		*--p = output_digits[i + 1];
+		*--p = output_digits[i];
+	} else {
+		*--p = (char)('0' + n);
+	}
+	if (value < 0)
+		*--p = '-';
+	return output_write(p, (size_t)(buf + sizeof(buf) - p));
+}
+
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL FUNGE_ATTR_FORMAT(printf, 1, 2)
+bool output_printf(const char * restrict format, ...)
+{
+	va_list args;
+	size_t space = OUTPUT_BUFFER_SIZE - output_used;
+	int length;
+	bool success;
+
+	// Try formatting directly into the buffer first.
+	va_start(args, format);
+	length = vsnprintf((char*)output_buffer + output_used, space, format, args);
+	va_end(args);
+	if (length < 0)
+		return false;
+	if ((size_t)length < space) {
+		const unsigned char *start = output_buffer + output_used;
+		output_used += (size_t)length;
+		if (output_line_buffered && memchr(start, '\n', (size_t)length))
+			return output_flush();
+		return true;
+	} else {
+		// Didn't fit, the buffer contents after output_used are just scratch
+		// so use a temporary buffer for this.
+		char *tmp = malloc((size_t)length + 1);
+		if (!tmp)
+			return false;
+		va_start(args, format);
+		vsnprintf(tmp, (size_t)length + 1, format, args);
+		va_end(args);
+		success = output_write(tmp, (size_t)length);
+		free(tmp);
+		return success;
+	}
+}
@@ -0,0 +1,129 @@
+/* -*- mode: C; coding: utf-8; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*-
+ *
+ * cfunge - A standard-conforming Befunge93/98/109 interpreter in C.
+ * Copyright (C) 2008-2013 Arvid Norlander <VorpalBlade AT users.noreply.github.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at the proxy's option) any later version. Arvid Norlander is a
+ * proxy who can decide which future versions of the GNU General Public
+ * License can be used.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file
+ * Buffered program output on stdout.
+ *
+ * All output of the running program (, . and fingerprints) goes through here
+ * rather than stdio. It is collected in one large buffer that is written with
+ * write() when full, before reading input and at exit. When stdout is a
+ * terminal (and -b isn't given) it is also written at each newline. Writes
+ * larger than the free space are passed to writev() together with the
+ * buffered data instead of being copied.
+ *
+ * Other code that writes to stdout through stdio must call output_flush()
+ * first, so the output stays in order.
+ */
+
+#ifndef FUNGE_HAD_SRC_OUTPUT_H
+#define FUNGE_HAD_SRC_OUTPUT_H
+
+#include "global.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/// Size of the output buffer.
+#define OUTPUT_BUFFER_SIZE (64 * 1024)
+
+/// @defgroup OUTPUT_INTERNAL Output buffer state
+/// Only exposed for the inline output_putchar(), don't use directly.
+/*@{*/
+extern unsigned char output_buffer[OUTPUT_BUFFER_SIZE];
+/// Number of bytes in output_buffer.
+extern size_t output_used;
+/// Flush at each newline.
+extern bool output_line_buffered;
+/*@}*/
+
+/**
+ * Set up buffering mode and flushing at exit.
+ * @param fully_buffered If true only flush when the buffer is full, otherwise
+ *                       flush at newlines if stdout is a terminal.
+ */
+FUNGE_ATTR_FAST
+void output_init(bool fully_buffered);
+
+/**
+ * Write all buffered output.
+ * @return False if the write failed, the buffered output is then discarded.
+ */
+FUNGE_ATTR_FAST
+bool output_flush(void);
+
+/**
+ * Slow path of output_putchar(), used when the buffer is full or at a newline
+ * in line buffered mode.
+ */
+FUNGE_ATTR_FAST
+bool output_putchar_slow(unsigned char c);
+
+/**
+ * Output a single byte, as the , instruction.
+ * @param c Value to output, truncated to a byte.
+ * @return False if output failed and the IP should reflect.
+ */
+FUNGE_ATTR_ALWAYS_INLINE
+static inline bool output_putchar(funge_cell c)
+{
+	if (FUNGE_LIKELY(output_used < OUTPUT_BUFFER_SIZE)
+	    && (!output_line_buffered || c != '\n')) {
+		output_buffer[output_used++] = (unsigned char)c;
+		return true;
+	}
+	return output_putchar_slow((unsigned char)c);
+}
+
+/**
+ * Output a block of data.
+ * @param data What to output.
+ * @param length Number of bytes to output.
+ * @return False if output failed.
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL
+bool output_write(const void * restrict data, size_t length);
+
+/**
+ * Output a string.
+ * @param str NUL-terminated string to output.
+ * @return False if output failed.
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL
+bool output_string(const char * restrict str);
+
+/**
+ * Output a number in decimal followed by a space, as the . instruction.
+ * @param value Number to output.
+ * @return False if output failed and the IP should reflect.
+ */
+FUNGE_ATTR_FAST
+bool output_number(funge_cell value);
+
+/**
+ * Output formatted with printf() style format string. For things that
+ * output_number() doesn't handle, like floating point and other bases.
+ * @return False if output failed.
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL FUNGE_ATTR_FORMAT(printf, 1, 2)
+bool output_printf(const char * restrict format, ...);
+
+#endif
@@ -24,119 +24,241 @@
 #include "prng.h"
 
 #include "diagnostic.h"
+#include "image.h"
+#include "replay.h"
+#include "settings.h"
 
-#if defined(CFUN_KLEE_TEST) || defined(AFL_FUZZ_TESTING)
-#  undef HAVE_arc4random_buf
+#include <errno.h>
+#include <fcntl.h>  /* open */
+#include <stdint.h>
+#include <string.h> /* strerror */
+#include <unistd.h> /* close, getpid, read */
+
+#ifdef HAVE_clock_gettime
+#  include <time.h>
+#else
+#  include <sys/time.h>
 #endif
 
-#ifdef HAVE_arc4random_buf
-#  define HAVE_ARC4RANDOM
-#  ifndef ARC4RANDOM_IN_BSD
-#    include <stdlib.h>
-#  else
-// Workaround for broken header
-typedef unsigned char u_char;
-#    include <bsd/stdlib.h>
-#  endif
+/*
+ * Random numbers come from an in-process generator, seeded once in
+ * prng_init(). The generator fills a buffer of 64-bit values at a time, and
+ * ? takes two bits at a time from those values.
+ *
+ * The algorithm is selected at build time with -DPRNG_ALGORITHM:
+ *  - xoshiro256 (default): xoshiro256** by David Blackman and Sebastiano
+ *    Vigna, see http://prng.di.unimi.it/
+ *  - pcg32: PCG-XSH-RR by Melissa O'Neill, see http://www.pcg-random.org/
+ */
+
+/// Number of values generated in one go.
+#define PRNG_BUFFER_SIZE 64
+
+/// All state of the generator, saved as is in images.
+typedef struct s_prngState {
+#ifdef PRNG_PCG32
+	uint64_t pcg_state;
+	uint64_t pcg_increment;
+#else
+	uint64_t xoshiro[4];
 #endif
+	uint64_t buffer[PRNG_BUFFER_SIZE];
+	uint64_t bits;        ///< Unused bits for prng_generate_direction().
+	uint32_t buffer_next; ///< Next unused value in buffer.
+	uint32_t bits_left;   ///< Number of 2 bit values left in bits.
+} prngState;
+
+static prngState prng;
+
+#ifdef PRNG_PCG32
+FUNGE_ATTR_FAST FUNGE_ATTR_WARN_UNUSED
+static inline uint32_t pcg32_next(void)
+{
+	uint64_t old = prng.pcg_state;
+	uint32_t xorshifted = (uint32_t)(((old >> 18u) ^ old) >> 27u);
+	uint32_t rot = (uint32_t)(old >> 59u);
+	prng.pcg_state = old * UINT64_C(6364136223846793005) + prng.pcg_increment;
+	return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+}
 
-#ifndef HAVE_ARC4RANDOM
-#  include <errno.h>
-#  include <stdlib.h>
-#  include <string.h> /* strerror */
+/// Get the next 64-bit value from the generator.
+FUNGE_ATTR_FAST FUNGE_ATTR_WARN_UNUSED
+static inline uint64_t prng_engine_next(void)
+{
+	uint64_t high = pcg32_next();
+	return (high << 32) | pcg32_next();
+}
+#else
+FUNGE_ATTR_FAST FUNGE_ATTR_CONST FUNGE_ATTR_WARN_UNUSED
+static inline uint64_t rotl(uint64_t x, int k)
+{
+	return (x << k) | (x >> (64 - k));
+}
 
-#  ifdef HAVE_clock_gettime
-#    include <time.h>
-#  else
-#    include <sys/time.h>
-#  endif
+/// Get the next 64-bit value from the generator.
+FUNGE_ATTR_FAST FUNGE_ATTR_WARN_UNUSED
+static inline uint64_t prng_engine_next(void)
+{
+	uint64_t *s = prng.xoshiro;
+	const uint64_t result = rotl(s[1] * 5, 7) * 9;
+	const uint64_t t = s[1] << 17;
 
-#  if !defined(HAVE_random) || !defined(HAVE_srandom)
-#    define random rand
-#    define srandom srand
-#  endif
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+	s[2] ^= t;
+	s[3] = rotl(s[3], 45);
 
+	return result;
+}
 #endif
 
-#ifndef HAVE_ARC4RANDOM
-static void setup_libc_random(void)
+/// SplitMix64, used to expand the seed into the state of the generator.
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL FUNGE_ATTR_WARN_UNUSED
+static inline uint64_t splitmix64(uint64_t * restrict x)
 {
-#if defined(CFUN_KLEE_TEST) || defined(AFL_FUZZ_TESTING)
-	// Make klee tests deterministic.
-	srandom(4);
-#elif defined(HAVE_clock_gettime)
-	struct timespec tv;
-	if (FUNGE_UNLIKELY(clock_gettime(CLOCK_REALTIME, &tv))) {
-		diag_fatal_format("clock_gettime() failed (needed for random seed): %s", strerror(errno));
-	}
-	// Set up randomness
-	srandom((unsigned int)tv.tv_nsec);
+	uint64_t z = (*x += UINT64_C(0x9e3779b97f4a7c15));
+	z = (z ^ (z >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+	z = (z ^ (z >> 27)) * UINT64_C(0x94d049bb133111eb);
+	return z ^ (z >> 31);
+}
+
+FUNGE_ATTR_FAST
+static void prng_seed(uint64_t seed)
+{
+#ifdef PRNG_PCG32
+	prng.pcg_increment = splitmix64(&seed) | 1;
+	prng.pcg_state = splitmix64(&seed) + prng.pcg_increment;
 #else
-	struct timeval tv;
-	if (FUNGE_UNLIKELY(gettimeofday(&tv, NULL))) {
-		diag_fatal_format("gettimeofday() failed (needed for random seed): %s", strerror(errno));
-	}
-	// Set up randomness
-	srandom((unsigned int)tv.tv_usec);
+	for (size_t i = 0; i < 4; i++)
+		prng.xoshiro[i] = splitmix64(&seed);
 #endif
+	// Empty the buffers.
+	prng.buffer_next = PRNG_BUFFER_SIZE;
+	prng.bits_left = 0;
 }
-#endif
 
-#ifdef HAVE_ARC4RANDOM
-// This is arc4random_uniform wholesale (BSD license),
-// but adapted to work with more than 32 bits.
-/*
- * Calculate a uniformly distributed random number less than upper_bound
- * avoiding "modulo bias".
- *
- * Uniformity is achieved by generating new random numbers until the one
- * returned is outside the range [0, 2**32 % upper_bound). This
- * guarantees the selected random number will be inside
- * [2**32 % upper_bound, 2**32) which maps back to [0, upper_bound)
- * after reduction modulo upper_bound.
- */
+/// Get a seed that differs between runs.
 FUNGE_ATTR_FAST FUNGE_ATTR_WARN_UNUSED
-static inline funge_unsigned_cell cfun_arc4random_range(funge_unsigned_cell upper_bound)
+static uint64_t prng_random_seed(void)
 {
-	funge_unsigned_cell r, min;
-
-	if (upper_bound < 2)
-		return 0;
-
-	/* 2**n % x == (2**n - x) % x */
-	min = -upper_bound % upper_bound;
-	/*
-	* This could theoretically loop forever but each retry has
-	* p > 0.5 (worst case, usually far better) of selecting a
-	* number inside the range we need, so it should rarely need
-	* to re-roll.
-	*/
-	for (;;) {
-		arc4random_buf(&r, sizeof(funge_unsigned_cell));
-		if (r >= min)
-			break;
+	uint64_t seed = 0;
+	int fd = open("/dev/urandom", O_RDONLY);
+	if (fd != -1) {
+		ssize_t got = read(fd, &seed, sizeof(seed));
+		close(fd);
+		if (got == (ssize_t)sizeof(seed))
+			return seed;
+	}
+	// Fall back on the time and process ID.
+	{
+#ifdef HAVE_clock_gettime
+		struct timespec tv;
+		if (FUNGE_UNLIKELY(clock_gettime(CLOCK_REALTIME, &tv))) {
+			diag_fatal_format("clock_gettime() failed (needed for random seed): %s", strerror(errno));
+		}
+		seed = (uint64_t)tv.tv_sec * UINT64_C(1000000000) + (uint64_t)tv.tv_nsec;
+#else
+		struct timeval tv;
+		if (FUNGE_UNLIKELY(gettimeofday(&tv, NULL))) {
+			diag_fatal_format("gettimeofday() failed (needed for random seed): %s", strerror(errno));
+		}
+		seed = (uint64_t)tv.tv_sec * UINT64_C(1000000) + (uint64_t)tv.tv_usec;
+#endif
 	}
+	return seed ^ ((uint64_t)getpid() << 32);
+}
+
+/// Refill the buffer. Kept out of line so the fast path stays small.
+FUNGE_ATTR_FAST FUNGE_ATTR_NOINLINE
+static void prng_refill(void)
+{
+	for (size_t i = 0; i < PRNG_BUFFER_SIZE; i++)
+		prng.buffer[i] = prng_engine_next();
+	prng.buffer_next = 0;
+}
 
-	return r % upper_bound;
+/// Get the next 64 random bits.
+FUNGE_ATTR_FAST FUNGE_ATTR_WARN_UNUSED
+static inline uint64_t prng_next(void)
+{
+	if (FUNGE_UNLIKELY(prng.buffer_next == PRNG_BUFFER_SIZE))
+		prng_refill();
+	return prng.buffer[prng.buffer_next++];
 }
-#endif
 
-// Sets up random seed from time.
 void prng_init(void)
 {
-#ifdef HAVE_ARC4RANDOM
-	arc4random_stir();
+#if defined(CFUN_KLEE_TEST) || defined(AFL_FUZZ_TESTING)
+	// Make klee tests deterministic.
+	prng_seed(4);
 #else
-	setup_libc_random();
+	if (setting_prng_seed_set)
+		prng_seed(setting_prng_seed);
+	else
+		prng_seed(prng_random_seed());
 #endif
 }
 
 FUNGE_ATTR_FAST
 funge_unsigned_cell prng_generate_unsigned(funge_unsigned_cell max_value)
 {
-#if defined(HAVE_ARC4RANDOM)
-	return cfun_arc4random_range(max_value);
-#else
-	return random() % max_value;
-#endif
+	funge_unsigned_cell value;
+
+	if (FUNGE_UNLIKELY(max_value < 2)) {
+		value = 0;
+	} else if ((max_value & (max_value - 1)) == 0) {
+		// Power of two, no bias possible.
+		value = (funge_unsigned_cell)prng_next() & (max_value - 1);
+	} else {
+		// Reject values below 2**n % max_value to avoid modulo bias, using
+		// 2**n % x == (2**n - x) % x. Each try succeeds with p > 0.5.
+		funge_unsigned_cell min = -max_value % max_value;
+		funge_unsigned_cell r;
+		do {
+			r = (funge_unsigned_cell)prng_next();
+		} while (r < min);
+		value = r % max_value;
+	}
+	if (FUNGE_UNLIKELY(replay_mode != replay_off))
+		value = (funge_unsigned_cell)replay_value(replay_event_random, (int64_t)value);
+	return value;
+}
+
+FUNGE_ATTR_FAST
+unsigned int prng_generate_direction(void)
+{
+	unsigned int value;
+
+	if (FUNGE_UNLIKELY(!prng.bits_left)) {
+		prng.bits = prng_next();
+		prng.bits_left = 32;
+	}
+	value = (unsigned int)(prng.bits & 3);
+	prng.bits >>= 2;
+	prng.bits_left--;
+	if (FUNGE_UNLIKELY(replay_mode != replay_off))
+		value = (unsigned int)replay_value(replay_event_random, value) & 3;
+	return value;
+}
+
+FUNGE_ATTR_FAST bool prng_save_image(FILE * restrict file)
+{
+	uint32_t length = sizeof(prng);
+	return image_write_value(file, length)
+	       && image_write(file, &prng, sizeof(prng));
+}
+
+FUNGE_ATTR_FAST bool prng_load_image(FILE * restrict file)
+{
+	uint32_t length;
+
+	if (!image_read_value(file, length))
+		return false;
+	// An explicit seed (-z) takes precedence over the saved state.
+	if (length == sizeof(prng) && !setting_prng_seed_set)
+		return image_read(file, &prng, sizeof(prng));
+	// Not usable in this binary, keep the seed from prng_init().
+	return fseeko(file, (off_t)length, SEEK_CUR) == 0;
 }
@@ -29,8 +29,12 @@
 
 #include "global.h"
 
+#include <stdbool.h>
+#include <stdio.h>
+
 /**
- * Initialize the PRNG (if it needs it)
+ * Seed the PRNG, from -z if given, otherwise with a seed that differs between
+ * runs.
  */
 void prng_init(void);
 
@@ -43,4 +47,29 @@ void prng_init(void);
 FUNGE_ATTR_FAST FUNGE_ATTR_WARN_UNUSED
 funge_unsigned_cell prng_generate_unsigned(funge_unsigned_cell max_value);
 
+/**
+ * Generate a random number in the range [0,4), for picking a direction.
+ * Faster than prng_generate_unsigned(4), it uses 2 bits at a time of the
+ * generated values.
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_WARN_UNUSED
+unsigned int prng_generate_direction(void);
+
+/**
+ * Write the PRNG state to an image.
+ * @param file Image file to write to.
+ * @return True if successful, otherwise false.
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL FUNGE_ATTR_WARN_UNUSED
+bool prng_save_image(FILE * restrict file);
+
+/**
+ * Restore the PRNG state from an image. Must be called after prng_init().
+ * If the image has no state usable by this binary the current seed is kept.
+ * @param file Image file to read from.
+ * @return True if successful, otherwise false.
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL FUNGE_ATTR_WARN_UNUSED
+bool prng_load_image(FILE * restrict file);
+
 #endif
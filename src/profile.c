@@ -0,0 +1,516 @@
+/* -*- mode: C; coding: utf-8; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*-
+ *
+ * cfunge - A standard-conforming Befunge93/98/109 interpreter in C.
+ * Copyright (C) 2008-2013 Arvid Norlander <VorpalBlade AT users.noreply.github.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at the proxy's option) any later version. Arvid Norlander is a
+ * proxy who can decide which future versions of the GNU General Public
+ * License can be used.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "global.h"
+#include "profile.h"
+
+#include "diagnostic.h"
+#include "output.h"
+#include "settings.h"
+#include "funge-space/funge-space.h"
+#include "fingerprints/manager.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h> /* memset, strerror, strlen */
+
+#include <sys/time.h> /* setitimer */
+
+#ifdef HAVE_clock_gettime
+#  include <time.h>
+#endif
+
+volatile sig_atomic_t profile_sample_pending = 0;
+
+#ifndef DISABLE_PROFILE
+
+/**************************
+ * Counting profiler (-P) *
+ **************************/
+
+/// Don't grow the heatmap beyond this many cells. Instructions executed
+/// outside it are only counted in profile_outside.
+#define PROFILE_MAX_CELLS (4 * 1024 * 1024)
+/// Extra space added in each direction when growing the heatmap.
+#define PROFILE_MARGIN 16
+/// Size of the hash table for fingerprint functions, must be a power of 2.
+#define PROFILE_FPRINT_SLOTS 1024
+
+/// Index in profile_opcodes for instructions outside 0-255.
+#define PROFILE_OTHER 256
+/// Index in profile_opcodes for characters pushed in string mode.
+#define PROFILE_STRING 257
+
+/// Execution counts per instruction.
+static uint64_t profile_opcodes[PROFILE_STRING + 1];
+
+/// Execution counts per cell, covering profile_area.
+static uint64_t *profile_cells = NULL;
+static fungeRect profile_area;
+/// Instructions executed outside profile_area that it couldn't grow to.
+static uint64_t profile_outside = 0;
+
+/// Statistics for one fingerprint function.
+typedef struct s_profileFprint {
+	fingerprintOpcode func;   ///< The function, NULL for unused slots.
+	unsigned char     opcode; ///< Instruction it was last called as.
+	uint64_t          calls;  ///< Number of calls.
+	uint64_t          ns;     ///< Total time spent in it.
+} profileFprint;
+
+static profileFprint profile_fprints[PROFILE_FPRINT_SLOTS];
+
+/// Current time in ns, from an arbitrary starting point.
+FUNGE_ATTR_FAST
+static inline uint64_t profile_now(void)
+{
+#ifdef HAVE_clock_gettime
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+#else
+	struct timeval now;
+	gettimeofday(&now, NULL);
+	return (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_usec * 1000;
+#endif
+}
+
+/**
+ * Make profile_area include position, moving the counts over.
+ * @return False if the area would get too large.
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL FUNGE_ATTR_WARN_UNUSED
+static bool profile_grow(const funge_vector * restrict position)
+{
+	fungeRect area = profile_area;
+	funge_cell right = profile_area.x + profile_area.w;
+	funge_cell bottom = profile_area.y + profile_area.h;
+	uint64_t *cells;
+
+	// Far from the current area (or close to the limits of a cell, where the
+	// calculations below could overflow) is never going to fit.
+	if ((position->x < area.x - PROFILE_MAX_CELLS) || (position->x > right + PROFILE_MAX_CELLS)
+	    || (position->y < area.y - PROFILE_MAX_CELLS) || (position->y > bottom + PROFILE_MAX_CELLS)
+	    || (position->x < FUNGECELL_MIN / 2) || (position->x > FUNGECELL_MAX / 2)
+	    || (position->y < FUNGECELL_MIN / 2) || (position->y > FUNGECELL_MAX / 2))
+		return false;
+	if (position->x < area.x)
+		area.x = position->x - PROFILE_MARGIN;
+	if (position->y < area.y)
+		area.y = position->y - PROFILE_MARGIN;
+	if (position->x >= right)
+		right = position->x + PROFILE_MARGIN;
+	if (position->y >= bottom)
+		bottom = position->y + PROFILE_MARGIN;
+	area.w = right - area.x;
+	area.h = bottom - area.y;
+	if ((size_t)area.w * (size_t)area.h > PROFILE_MAX_CELLS)
+		return false;
+
+	cells = calloc((size_t)area.w * (size_t)area.h, sizeof(uint64_t));
+	if (FUNGE_UNLIKELY(!cells))
+		return false;
+	for (funge_cell y = 0; y < profile_area.h; y++) {
+		memcpy(&cells[(size_t)(profile_area.y - area.y + y) * (size_t)area.w
+		              + (size_t)(profile_area.x - area.x)],
+		       &profile_cells[(size_t)y * (size_t)profile_area.w],
+		       (size_t)profile_area.w * sizeof(uint64_t));
+	}
+	free(profile_cells);
+	profile_cells = cells;
+	profile_area = area;
+	return true;
+}
+
+FUNGE_ATTR_FAST void profile_instruction(const instructionPointer * restrict ip, funge_cell opcode)
+{
+	funge_cell x = ip->position.x - profile_area.x;
+	funge_cell y = ip->position.y - profile_area.y;
+
+	if (ip->mode == ipmSTRING && opcode != '"')
+		profile_opcodes[PROFILE_STRING]++;
+	else if (opcode >= 0 && opcode < 256)
+		profile_opcodes[opcode]++;
+	else
+		profile_opcodes[PROFILE_OTHER]++;
+
+	if (FUNGE_UNLIKELY(x < 0 || y < 0 || x >= profile_area.w || y >= profile_area.h)) {
+		if (!profile_grow(&ip->position)) {
+			profile_outside++;
+			return;
+		}
+		x = ip->position.x - profile_area.x;
+		y = ip->position.y - profile_area.y;
+	}
+	profile_cells[(size_t)y * (size_t)profile_area.w + (size_t)x]++;
+}
+
+FUNGE_ATTR_FAST void profile_fingerprint(instructionPointer * restrict ip, funge_cell opcode)
+{
+	fingerprintOpcode func = ip->fingerTop[opcode - 'A'];
+	size_t slot = ((uintptr_t)func >> 4) & (PROFILE_FPRINT_SLOTS - 1);
+	profileFprint *entry = NULL;
+	uint64_t start;
+
+	// Open addressing, if the table is full the call just isn't counted.
+	for (size_t i = 0; i < PROFILE_FPRINT_SLOTS; i++) {
+		profileFprint *candidate = &profile_fprints[(slot + i) & (PROFILE_FPRINT_SLOTS - 1)];
+		if (candidate->func == func || candidate->func == NULL) {
+			entry = candidate;
+			break;
+		}
+	}
+	if (FUNGE_UNLIKELY(!entry)) {
+		func(ip);
+		return;
+	}
+	entry->func = func;
+	entry->opcode = (unsigned char)opcode;
+	entry->calls++;
+	start = profile_now();
+	func(ip);
+	entry->ns += profile_now() - start;
+}
+
+/// Sort instruction indexes by count, descending.
+static int profile_compare_opcodes(const void *a, const void *b)
+{
+	uint64_t ca = profile_opcodes[*(const int*)a];
+	uint64_t cb = profile_opcodes[*(const int*)b];
+	if (ca != cb)
+		return ca < cb ? 1 : -1;
+	return *(const int*)a - *(const int*)b;
+}
+
+/// Sort fingerprint functions by time spent, descending.
+static int profile_compare_fprints(const void *a, const void *b)
+{
+	const profileFprint *fa = a;
+	const profileFprint *fb = b;
+	if (fa->ns != fb->ns)
+		return fa->ns < fb->ns ? 1 : -1;
+	if (fa->calls != fb->calls)
+		return fa->calls < fb->calls ? 1 : -1;
+	return 0;
+}
+
+/// Write the heatmap, as CSV if the file name ends in .csv, otherwise as PGM.
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL FUNGE_ATTR_WARN_UNUSED
+static bool profile_write_heatmap(FILE * restrict file, bool csv)
+{
+	uint64_t max = 0;
+	size_t count = (size_t)profile_area.w * (size_t)profile_area.h;
+
+	if (csv) {
+		fputs("x,y,count\n", file);
+		for (funge_cell y = 0; y < profile_area.h; y++) {
+			for (funge_cell x = 0; x < profile_area.w; x++) {
+				uint64_t value = profile_cells[(size_t)y * (size_t)profile_area.w + (size_t)x];
+				if (value)
+					fprintf(file, "%" FUNGECELLPRI ",%" FUNGECELLPRI ",%" PRIu64 "\n",
+					        profile_area.x + x, profile_area.y + y, value);
+			}
+		}
+		return !ferror(file);
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		if (profile_cells[i] > max)
+			max = profile_cells[i];
+	}
+	// Plain PGM, scaled linearly so the hottest cell is white.
+	fprintf(file, "P2\n# cfunge profile, top left corner x=%" FUNGECELLPRI " y=%" FUNGECELLPRI
+	        ", hottest cell executed %" PRIu64 " times\n%" FUNGECELLPRI " %" FUNGECELLPRI "\n65535\n",
+	        profile_area.x, profile_area.y, max, profile_area.w, profile_area.h);
+	for (funge_cell y = 0; y < profile_area.h; y++) {
+		for (funge_cell x = 0; x < profile_area.w; x++) {
+			uint64_t value = profile_cells[(size_t)y * (size_t)profile_area.w + (size_t)x];
+			// Scale in floating point: value * 65535 could overflow.
+			fprintf(file, x ? " %u" : "%u",
+			        max ? (unsigned int)((double)value / (double)max * 65535.0 + 0.5) : 0);
+		}
+		fputc('\n', file);
+	}
+	return !ferror(file);
+}
+
+FUNGE_ATTR_COLD
+static void profile_report(void)
+{
+	int order[PROFILE_STRING + 1];
+	uint64_t total = 0;
+	size_t nfprints = 0;
+	size_t length;
+	FILE *file;
+
+	// Make sure the output of the program comes before the report.
+	output_flush();
+
+	for (int i = 0; i <= PROFILE_STRING; i++) {
+		order[i] = i;
+		total += profile_opcodes[i];
+	}
+	qsort(order, PROFILE_STRING + 1, sizeof(int), &profile_compare_opcodes);
+
+	fprintf(stderr, "\ncfunge profile: %" PRIu64 " instructions executed\n\n", total);
+	fputs("       count       %  instruction\n", stderr);
+	for (int i = 0; i <= PROFILE_STRING && profile_opcodes[order[i]]; i++) {
+		uint64_t value = profile_opcodes[order[i]];
+		fprintf(stderr, "%12" PRIu64 " %6.2f%%  ", value, (double)value * 100.0 / (double)total);
+		if (order[i] == PROFILE_STRING)
+			fputs("(string mode)\n", stderr);
+		else if (order[i] == PROFILE_OTHER)
+			fputs("(other)\n", stderr);
+		else if (order[i] > 32 && order[i] < 127)
+			fprintf(stderr, "%c\n", order[i]);
+		else
+			fprintf(stderr, "(%d)\n", order[i]);
+	}
+
+	// Compact the used slots to the start of the table for sorting.
+	for (size_t i = 0; i < PROFILE_FPRINT_SLOTS; i++) {
+		if (profile_fprints[i].func)
+			profile_fprints[nfprints++] = profile_fprints[i];
+	}
+	if (nfprints) {
+		qsort(profile_fprints, nfprints, sizeof(profileFprint), &profile_compare_fprints);
+		fputs("\n       calls    total ms    ns/call  fingerprint instruction\n", stderr);
+		for (size_t i = 0; i < nfprints; i++) {
+			const profileFprint *entry = &profile_fprints[i];
+			funge_cell fprint;
+			unsigned char opcode;
+			fprintf(stderr, "%12" PRIu64 " %11.3f %10.1f  ", entry->calls,
+			        (double)entry->ns / 1e6, (double)entry->ns / (double)entry->calls);
+			if (manager_opcode_origin(entry->func, &fprint, &opcode)) {
+				char name[sizeof(funge_cell) + 1];
+				size_t n = 0;
+				// Print the fingerprint as text where possible.
+				for (int shift = (int)sizeof(funge_cell) * 8 - 8; shift >= 0; shift -= 8) {
+					char c = (char)((fprint >> shift) & 0xff);
+					if (c > 32 && c < 127)
+						name[n++] = c;
+				}
+				name[n] = '\0';
+				fprintf(stderr, "%s %c", name, opcode);
+				if (opcode != entry->opcode)
+					fprintf(stderr, " (as %c)", entry->opcode);
+				fputc('\n', stderr);
+			} else {
+				fprintf(stderr, "? %c\n", entry->opcode);
+			}
+		}
+	}
+	if (profile_outside)
+		fprintf(stderr, "\n%" PRIu64 " instructions were executed outside the heatmap area.\n",
+		        profile_outside);
+
+	file = fopen(setting_profile_file, "w");
+	length = strlen(setting_profile_file);
+	if (!file
+	    || !profile_write_heatmap(file, length >= 4 && strcmp(setting_profile_file + length - 4, ".csv") == 0)) {
+		diag_warn_format("Failed to write profile heatmap \"%s\": %s", setting_profile_file, strerror(errno));
+	}
+	if (file)
+		fclose(file);
+}
+
+/**************************
+ * Sampling profiler (-p) *
+ **************************/
+
+/// Sampling interval in microseconds of CPU time.
+#define SAMPLE_INTERVAL 1000
+/// Rows are grouped in bands of this many rows in the output.
+#define SAMPLE_BAND 16
+/// Initial size of the sample table, must be a power of 2.
+#define SAMPLE_INITIAL_SLOTS 1024
+
+/// Samples for one IP at one cell.
+typedef struct s_profileSample {
+	funge_cell   id;       ///< ID of the IP.
+	funge_vector position; ///< Cell it was executing.
+	uint64_t     count;    ///< Number of samples, 0 for unused slots.
+} profileSample;
+
+static profileSample *sample_table = NULL;
+static size_t sample_slots = 0;
+static size_t sample_used = 0;
+
+static void profile_sigprof_handler(int signum)
+{
+	(void)signum;
+	profile_sample_pending = 1;
+}
+
+/// Find the slot for a sample in table (which has slots entries).
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL FUNGE_ATTR_PURE FUNGE_ATTR_WARN_UNUSED
+static inline profileSample *sample_find(profileSample * restrict table, size_t slots, funge_cell id,
+                                         const funge_vector * restrict position)
+{
+	size_t hash = ((size_t)position->x * 31 + (size_t)position->y) * 31 + (size_t)id;
+	size_t slot = (hash ^ (hash >> 16)) & (slots - 1);
+
+	while (table[slot].count
+	       && (table[slot].id != id
+	           || table[slot].position.x != position->x
+	           || table[slot].position.y != position->y))
+		slot = (slot + 1) & (slots - 1);
+	return &table[slot];
+}
+
+/// Double the size of the sample table.
+FUNGE_ATTR_FAST FUNGE_ATTR_WARN_UNUSED
+static bool sample_grow(void)
+{
+	size_t slots = sample_slots * 2;
+	profileSample *table = calloc(slots, sizeof(profileSample));
+
+	if (FUNGE_UNLIKELY(!table))
+		return false;
+	for (size_t i = 0; i < sample_slots; i++) {
+		if (sample_table[i].count)
+			*sample_find(table, slots, sample_table[i].id, &sample_table[i].position) = sample_table[i];
+	}
+	free(sample_table);
+	sample_table = table;
+	sample_slots = slots;
+	return true;
+}
+
+FUNGE_ATTR_FAST void profile_sample(const instructionPointer * restrict ip)
+{
+	profileSample *entry;
+
+	profile_sample_pending = 0;
+	// Keep the load factor at most 1/2. If memory runs out, keep going with
+	// the table we have as long as there is room.
+	if ((sample_used + 1) * 2 > sample_slots && !sample_grow() && sample_used + 1 >= sample_slots)
+		return;
+	entry = sample_find(sample_table, sample_slots, ip->ID, &ip->position);
+	if (!entry->count) {
+		entry->id = ip->ID;
+		entry->position = ip->position;
+		sample_used++;
+	}
+	entry->count++;
+}
+
+/// Write the samples in collapsed stack format, one line per IP and cell.
+FUNGE_ATTR_COLD
+static void profile_sample_report(void)
+{
+	struct itimerval timer;
+	FILE *file;
+	bool ok;
+
+	memset(&timer, 0, sizeof(timer));
+	setitimer(ITIMER_PROF, &timer, NULL);
+
+	file = fopen(setting_sample_file, "w");
+	ok = (file != NULL);
+	for (size_t i = 0; ok && i < sample_slots; i++) {
+		const profileSample *entry = &sample_table[i];
+		funge_cell band;
+		if (!entry->count)
+			continue;
+		// Round down, also for negative rows.
+		band = entry->position.y / SAMPLE_BAND * SAMPLE_BAND;
+		if (entry->position.y < 0 && entry->position.y % SAMPLE_BAND)
+			band -= SAMPLE_BAND;
+		ok = fprintf(file, "ip %" FUNGECELLPRI ";rows %" FUNGECELLPRI "-%" FUNGECELLPRI
+		             ";x=%" FUNGECELLPRI " y=%" FUNGECELLPRI " %" PRIu64 "\n",
+		             entry->id, band, band + SAMPLE_BAND - 1,
+		             entry->position.x, entry->position.y, entry->count) > 0;
+	}
+	if (file && fclose(file) != 0)
+		ok = false;
+	if (!ok)
+		diag_warn_format("Failed to write profile samples \"%s\": %s", setting_sample_file, strerror(errno));
+}
+
+/// Start the sampling timer.
+FUNGE_ATTR_FAST
+static void profile_sample_init(void)
+{
+	struct sigaction action;
+	struct itimerval timer;
+
+	sample_slots = SAMPLE_INITIAL_SLOTS;
+	sample_table = calloc(sample_slots, sizeof(profileSample));
+	if (FUNGE_UNLIKELY(!sample_table)) {
+		DIAG_OOM("Couldn't allocate profile data");
+	}
+
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = &profile_sigprof_handler;
+	sigemptyset(&action.sa_mask);
+	// Don't make reads from stdin and such fail with EINTR.
+	action.sa_flags = SA_RESTART;
+	if (sigaction(SIGPROF, &action, NULL) != 0) {
+		diag_fatal_format("Couldn't install SIGPROF handler: %s", strerror(errno));
+	}
+	atexit(&profile_sample_report);
+
+	timer.it_interval.tv_sec = 0;
+	timer.it_interval.tv_usec = SAMPLE_INTERVAL;
+	timer.it_value = timer.it_interval;
+	if (setitimer(ITIMER_PROF, &timer, NULL) != 0) {
+		diag_fatal_format("Couldn't start profiling timer: %s", strerror(errno));
+	}
+}
+
+/*****************
+ * Common set up *
+ *****************/
+
+FUNGE_ATTR_FAST void profile_init(void)
+{
+	if (setting_sample_file)
+		profile_sample_init();
+	if (!setting_profile_file)
+		return;
+	fungespace_get_bounds_rect(&profile_area);
+	// The bounds rectangle is inclusive.
+	profile_area.w++;
+	profile_area.h++;
+	if ((size_t)profile_area.w * (size_t)profile_area.h > PROFILE_MAX_CELLS) {
+		// Start with an empty area around the origin instead, it grows as
+		// needed.
+		profile_area.x = profile_area.y = 0;
+		profile_area.w = profile_area.h = 1;
+	}
+	profile_cells = calloc((size_t)profile_area.w * (size_t)profile_area.h, sizeof(uint64_t));
+	if (FUNGE_UNLIKELY(!profile_cells)) {
+		DIAG_OOM("Couldn't allocate profile data");
+	}
+	atexit(&profile_report);
+}
+
+#else
+
+FUNGE_ATTR_FAST void profile_init(void)
+{
+	// Profiling disabled in this build, -P is ignored.
+}
+
+#endif /* DISABLE_PROFILE */
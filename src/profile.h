@@ -0,0 +1,84 @@
+/* -*- mode: C; coding: utf-8; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*-
+ *
+ * cfunge - A standard-conforming Befunge93/98/109 interpreter in C.
+ * Copyright (C) 2008-2013 Arvid Norlander <VorpalBlade AT users.noreply.github.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at the proxy's option) any later version. Arvid Norlander is a
+ * proxy who can decide which future versions of the GNU General Public
+ * License can be used.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file
+ * Execution profilers.
+ *
+ * With -P every instruction is counted: how many times each instruction and
+ * each Funge-Space cell is executed, and how many times each fingerprint
+ * instruction is called and the time spent in it. On exit a histogram is
+ * printed to stderr and a heatmap of the executed cells is written to the
+ * file given to -P.
+ *
+ * With -p execution is instead sampled using SIGPROF. Samples are attributed
+ * to the IP and cell executing when the signal arrived, and are written on
+ * exit in the collapsed stack format used by flame graph tools.
+ */
+
+#ifndef FUNGE_HAD_SRC_PROFILE_H
+#define FUNGE_HAD_SRC_PROFILE_H
+
+#include "global.h"
+
+#include <signal.h>
+
+#include "ip.h"
+
+/// Set by the SIGPROF handler, the main loop calls profile_sample() when it is
+/// non-zero. Ticks arriving before the sample is recorded are merged into it.
+extern volatile sig_atomic_t profile_sample_pending;
+
+/**
+ * Set up the profilers if -P or -p was given. Must be called after the program is
+ * loaded, the bounds at that point is the initial area of the heatmap.
+ * @warning Should only be called from internal setup code.
+ */
+FUNGE_ATTR_FAST
+void profile_init(void);
+
+/**
+ * Count an instruction about to be executed. Only call when
+ * setting_profile_file is set.
+ * @param ip The IP executing it.
+ * @param opcode The instruction.
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL
+void profile_instruction(const instructionPointer * restrict ip, funge_cell opcode);
+
+/**
+ * Call the fingerprint instruction opcode (A-Z) for ip and account for it.
+ * Only call when setting_profile_file is set.
+ * @param ip The IP executing it.
+ * @param opcode The instruction.
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL
+void profile_fingerprint(instructionPointer * restrict ip, funge_cell opcode);
+
+/**
+ * Record a pending sample for ip. Call after executing an instruction, before
+ * moving the IP, when profile_sample_pending is non-zero.
+ * @param ip The IP that was executing.
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL FUNGE_ATTR_COLD
+void profile_sample(const instructionPointer * restrict ip);
+
+#endif
@@ -0,0 +1,191 @@
+/* -*- mode: C; coding: utf-8; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*-
+ *
+ * cfunge - A standard-conforming Befunge93/98/109 interpreter in C.
+ * Copyright (C) 2008-2013 Arvid Norlander <VorpalBlade AT users.noreply.github.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at the proxy's option) any later version. Arvid Norlander is a
+ * proxy who can decide which future versions of the GNU General Public
+ * License can be used.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "global.h"
+#include "replay.h"
+
+#include "diagnostic.h"
+#include "settings.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h> /* SIZE_MAX */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h> /* memcmp, strerror */
+
+/// Magic at the start of a log, including the version in the last byte.
+static const char replay_magic[8] = { 'C', 'F', 'U', 'N', 'R', 'P', 'L', 1 };
+
+replayMode replay_mode = replay_off;
+
+static FILE *replay_file = NULL;
+static const char *replay_filename = NULL;
+
+/// Close the log when exiting, flushing anything buffered when recording.
+static void replay_finish(void)
+{
+	if (!replay_file)
+		return;
+	if (fclose(replay_file) != 0 && replay_mode == replay_record)
+		diag_warn_format("Failed to write replay log \"%s\": %s", replay_filename, strerror(errno));
+	replay_file = NULL;
+}
+
+FUNGE_ATTR_NORET FUNGE_ATTR_COLD
+static void replay_write_error(void)
+{
+	diag_fatal_format("Failed to write replay log \"%s\": %s", replay_filename, strerror(errno));
+}
+
+FUNGE_ATTR_NORET FUNGE_ATTR_COLD
+static void replay_desync(const char *what)
+{
+	diag_fatal_format("Replay log \"%s\" doesn't match this run: %s.", replay_filename, what);
+}
+
+/*
+ * Values are stored as zigzag encoded LEB128, so small values of either sign
+ * take one byte.
+ */
+
+FUNGE_ATTR_FAST
+static void replay_put_varint(int64_t value)
+{
+	uint64_t bits = ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+	do {
+		unsigned char byte = bits & 0x7f;
+		bits >>= 7;
+		if (bits)
+			byte |= 0x80;
+		if (FUNGE_UNLIKELY(putc(byte, replay_file) == EOF))
+			replay_write_error();
+	} while (bits);
+}
+
+FUNGE_ATTR_FAST FUNGE_ATTR_WARN_UNUSED
+static int64_t replay_get_varint(void)
+{
+	uint64_t bits = 0;
+	for (unsigned int shift = 0; shift < 64; shift += 7) {
+		int byte = getc(replay_file);
+		if (FUNGE_UNLIKELY(byte == EOF))
+			replay_desync("the log ended early");
+		bits |= (uint64_t)(byte & 0x7f) << shift;
+		if (!(byte & 0x80))
+			return (int64_t)(bits >> 1) ^ -(int64_t)(bits & 1);
+	}
+	replay_desync("invalid value");
+}
+
+FUNGE_ATTR_FAST
+static void replay_put_event(replayEvent event)
+{
+	if (FUNGE_UNLIKELY(putc(event, replay_file) == EOF))
+		replay_write_error();
+}
+
+FUNGE_ATTR_FAST
+static void replay_get_event(replayEvent event)
+{
+	int found = getc(replay_file);
+	if (FUNGE_UNLIKELY(found == EOF))
+		replay_desync("the log ended early");
+	if (FUNGE_UNLIKELY(found != (int)event))
+		replay_desync("the program asked for a different kind of input");
+}
+
+FUNGE_ATTR_FAST int64_t replay_value(replayEvent event, int64_t value)
+{
+	if (FUNGE_LIKELY(replay_mode == replay_off))
+		return value;
+	if (replay_mode == replay_record) {
+		replay_put_event(event);
+		replay_put_varint(value);
+		return value;
+	}
+	replay_get_event(event);
+	return replay_get_varint();
+}
+
+FUNGE_ATTR_FAST
+void replay_write_bytes(replayEvent event, const void * restrict data, ssize_t length)
+{
+	if (replay_mode != replay_record)
+		return;
+	replay_put_event(event);
+	replay_put_varint(length);
+	if (length > 0 && fwrite(data, 1, (size_t)length, replay_file) != (size_t)length)
+		replay_write_error();
+}
+
+FUNGE_ATTR_FAST
+ssize_t replay_read_bytes(replayEvent event, unsigned char ** restrict data)
+{
+	int64_t length;
+
+	assert(replay_mode == replay_play);
+	replay_get_event(event);
+	length = replay_get_varint();
+	if (length < 0) {
+		*data = NULL;
+		return -1;
+	}
+	if (FUNGE_UNLIKELY((uint64_t)length >= SIZE_MAX))
+		replay_desync("invalid length");
+	*data = malloc((size_t)length + 1);
+	if (FUNGE_UNLIKELY(!*data)) {
+		DIAG_OOM("Couldn't allocate replayed data");
+	}
+	if (FUNGE_UNLIKELY(fread(*data, 1, (size_t)length, replay_file) != (size_t)length))
+		replay_desync("the log ended early");
+	(*data)[length] = '\0';
+	return (ssize_t)length;
+}
+
+FUNGE_ATTR_FAST void replay_init(void)
+{
+	char magic[sizeof(replay_magic)];
+
+	if (setting_record_file && setting_replay_file)
+		diag_fatal("Can't both record (-r) and replay (-R) at the same time.");
+	if (setting_record_file) {
+		replay_filename = setting_record_file;
+		replay_file = fopen(replay_filename, "wb");
+		if (!replay_file)
+			replay_write_error();
+		if (fwrite(replay_magic, sizeof(replay_magic), 1, replay_file) != 1)
+			replay_write_error();
+		replay_mode = replay_record;
+	} else if (setting_replay_file) {
+		replay_filename = setting_replay_file;
+		replay_file = fopen(replay_filename, "rb");
+		if (!replay_file)
+			diag_fatal_format("Failed to open replay log \"%s\": %s", replay_filename, strerror(errno));
+		if (fread(magic, sizeof(magic), 1, replay_file) != 1
+		    || memcmp(magic, replay_magic, sizeof(magic)) != 0)
+			diag_fatal_format("\"%s\" is not a replay log from this version of cfunge.", replay_filename);
+		replay_mode = replay_play;
+	} else {
+		return;
+	}
+	atexit(&replay_finish);
+}
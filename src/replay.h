@@ -0,0 +1,105 @@
+/* -*- mode: C; coding: utf-8; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*-
+ *
+ * cfunge - A standard-conforming Befunge93/98/109 interpreter in C.
+ * Copyright (C) 2008-2013 Arvid Norlander <VorpalBlade AT users.noreply.github.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at the proxy's option) any later version. Arvid Norlander is a
+ * proxy who can decide which future versions of the GNU General Public
+ * License can be used.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file
+ * Recording and replay of nondeterministic inputs.
+ *
+ * With -r file, every value the program gets from outside (random numbers,
+ * bytes read from standard input, the time and data received from sockets)
+ * is appended to a log. With -R file the same values are taken from the log
+ * instead, so the run is repeated exactly. Since IP scheduling is
+ * deterministic this also holds for concurrent programs.
+ *
+ * Sources call replay_value() (for single values where the live source is
+ * harmless to query) or check replay_playing() and use replay_read_bytes()
+ * and replay_write_bytes() (for reads that must not happen during replay).
+ */
+
+#ifndef FUNGE_HAD_SRC_REPLAY_H
+#define FUNGE_HAD_SRC_REPLAY_H
+
+#include "global.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h> /* ssize_t */
+
+/// Kinds of events in the log. The values are stored in the log, only add
+/// new ones at the end.
+typedef enum e_replayEvent {
+	replay_event_random = 1, ///< Random number from prng.c.
+	replay_event_input  = 2, ///< Line read from standard input.
+	replay_event_time   = 3, ///< Wall clock time in seconds.
+	replay_event_clock  = 4, ///< High resolution timer (two values).
+	replay_event_recv   = 5, ///< Data received from a socket.
+	replay_event_poll   = 6  ///< Result of polling a socket.
+} replayEvent;
+
+/// What the replay module is doing.
+typedef enum e_replayMode {
+	replay_off = 0, ///< Neither recording nor replaying.
+	replay_record,  ///< Appending events to the log.
+	replay_play     ///< Reading events from the log.
+} replayMode;
+
+/// Current mode, only changed by replay_init().
+extern replayMode replay_mode;
+
+/// Are events taken from the log instead of from the system?
+#define replay_playing() (replay_mode == replay_play)
+
+/**
+ * Open the log if -r or -R was given.
+ * @warning Should only be called from internal setup code.
+ */
+FUNGE_ATTR_FAST
+void replay_init(void);
+
+/**
+ * Record or replay a single value.
+ * @param event The kind of value.
+ * @param value The live value, used when not replaying.
+ * @return The value the program should use.
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_WARN_UNUSED
+int64_t replay_value(replayEvent event, int64_t value);
+
+/**
+ * Record the result of a read, does nothing unless recording.
+ * @param event The kind of read.
+ * @param data The data read.
+ * @param length Length of data, or -1 if the read failed.
+ */
+FUNGE_ATTR_FAST
+void replay_write_bytes(replayEvent event, const void * restrict data, ssize_t length);
+
+/**
+ * Get the result of a read from the log. Only call when replay_playing().
+ * @param event The kind of read.
+ * @param data Set to a malloc()ed copy of the data, with an extra NUL byte
+ *             at the end, or NULL if the read failed. Free it with free().
+ * @return Length of the data, or -1 if the read failed.
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL FUNGE_ATTR_WARN_UNUSED
+ssize_t replay_read_bytes(replayEvent event, unsigned char ** restrict data);
+
+#endif
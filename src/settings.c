@@ -32,3 +32,16 @@ bool setting_enable_warnings = false;
 bool setting_enable_errors = false;
 bool setting_disable_fingerprints = false;
 bool setting_enable_sandbox = false;
+
+const char * setting_image_load = NULL;
+const char * setting_image_save = NULL;
+const char * setting_checkpoint_file = NULL;
+const char * setting_profile_file = NULL;
+const char * setting_sample_file = NULL;
+const char * setting_trace_file = NULL;
+bool setting_print_stats = false;
+const char * setting_record_file = NULL;
+const char * setting_replay_file = NULL;
+uint64_t setting_prng_seed = 0;
+bool setting_prng_seed_set = false;
+bool setting_fully_buffered = false;
@@ -67,4 +67,31 @@ extern bool setting_disable_fingerprints;
 /// - In fingerprints: Non-safe fingerprints are not loaded.
 extern bool setting_enable_sandbox;
 
+/// If not NULL, the initial state is loaded from this image file instead of
+/// from a program file.
+extern const char * setting_image_load;
+/// If not NULL, an image of the initial state is written to this file and
+/// the interpreter exits without running the program.
+extern const char * setting_image_save;
+/// If not NULL, a checkpoint image is written to this file on SIGUSR1.
+extern const char * setting_checkpoint_file;
+/// If not NULL, profile the execution. The heatmap is written to this file.
+extern const char * setting_profile_file;
+/// If not NULL, sample the execution. The samples are written to this file.
+extern const char * setting_sample_file;
+/// If not NULL, write a binary execution trace to this file.
+extern const char * setting_trace_file;
+/// Should statistics be printed at exit and on SIGUSR2?
+extern bool setting_print_stats;
+/// If not NULL, record nondeterministic inputs to this file.
+extern const char * setting_record_file;
+/// If not NULL, replay nondeterministic inputs from this file.
+extern const char * setting_replay_file;
+/// Seed for the PRNG, only used if setting_prng_seed_set is true.
+extern uint64_t setting_prng_seed;
+/// Was a seed for the PRNG given?
+extern bool setting_prng_seed_set;
+/// Should output only be written when the buffer is full (-b)?
+extern bool setting_fully_buffered;
+
 #endif
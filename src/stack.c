@@ -23,7 +23,9 @@
 #include "stack.h"
 #include "vector.h"
 #include "ip.h"
+#include "image.h"
 #include "settings.h"
+#include "stats.h"
 #include "diagnostic.h"
 
 #include <assert.h>
@@ -31,29 +33,39 @@
 
 /// How many new items to allocate in one go?
 #define ALLOCSIZE_STACK 4096
+/// Initial size of stacks created by {, most are small.
+#define ALLOCSIZE_STACK_FRAME 32
 /// How many stack pointers to allocate for the stack stack in one go.
 #define ALLOCSIZE_STACKSTACK 32
+/// Initial size of the buffer used by stack_pop_string_scratch().
+#define ALLOCSIZE_SCRATCH 256
 
 
 /******************************
  * Constructor and destructor *
  ******************************/
 
-funge_stack * stack_create(void)
+FUNGE_ATTR_FAST FUNGE_ATTR_MALLOC FUNGE_ATTR_WARN_UNUSED
+static inline funge_stack * stack_create_sized(size_t size)
 {
 	funge_stack * tmp = (funge_stack*)malloc(sizeof(funge_stack));
 	if (FUNGE_UNLIKELY(!tmp))
 		return NULL;
-	tmp->entries = (funge_cell*)malloc(ALLOCSIZE_STACK * sizeof(funge_cell));
+	tmp->entries = (funge_cell*)malloc(size * sizeof(funge_cell));
 	if (FUNGE_UNLIKELY(!tmp->entries)) {
 		free(tmp);
 		return NULL;
 	}
-	tmp->size = ALLOCSIZE_STACK;
+	tmp->size = size;
 	tmp->top = 0;
 	return tmp;
 }
 
+funge_stack * stack_create(void)
+{
+	return stack_create_sized(ALLOCSIZE_STACK);
+}
+
 FUNGE_ATTR_FAST void stack_free(funge_stack * stack)
 {
 	if (FUNGE_UNLIKELY(!stack))
@@ -112,6 +124,7 @@ static inline void stack_prealloc_space(funge_stack * restrict stack, size_t min
 		{
 			stack_oom();
 		}
+		STATS_INC(stat_stack_reallocs);
 		stack->entries = (funge_cell*)realloc(stack->entries, allocation_size);
 		if (FUNGE_UNLIKELY(!stack->entries)) {
 			stack_oom();
@@ -136,7 +149,9 @@ FUNGE_ATTR_FAST void stack_push(funge_stack * restrict stack, funge_cell value)
 
 	// Do we need to realloc?
 	if (FUNGE_UNLIKELY(stack->top == stack->size)) {
-		funge_cell* new_entries = (funge_cell*)realloc(stack->entries, (stack->size + ALLOCSIZE_STACK) * sizeof(funge_cell));
+		funge_cell* new_entries;
+		STATS_INC(stat_stack_reallocs);
+		new_entries = (funge_cell*)realloc(stack->entries, (stack->size + ALLOCSIZE_STACK) * sizeof(funge_cell));
 		if (FUNGE_UNLIKELY(!new_entries)) {
 			stack_oom();
 		}
@@ -193,11 +208,21 @@ FUNGE_ATTR_FAST inline funge_cell stack_get_index(const funge_stack * restrict s
 
 FUNGE_ATTR_FAST inline size_t stack_strlen(const funge_stack * restrict stack)
 {
+	const funge_cell * restrict entries;
+	size_t i;
 	paranoid_assert(stack != NULL);
-	// TODO: Maybe scan two cells at once if we are using 32-bit cells on a
-	// 64-bit system?
-	for (size_t i = stack->top; i > 0; i--) {
-		if (stack->entries[i - 1] == 0)
+	entries = stack->entries;
+	i = stack->top;
+	// Check four cells at a time, the exact position is then found by the
+	// loop below.
+	while (i >= 4) {
+		const funge_cell * restrict block = entries + i - 4;
+		if (!(block[0] && block[1] && block[2] && block[3]))
+			break;
+		i -= 4;
+	}
+	for (; i > 0; i--) {
+		if (entries[i - 1] == 0)
 			return stack->top - i;
 	}
 	return stack->top;
@@ -241,27 +266,94 @@ FUNGE_ATTR_FAST void stack_push_string(funge_stack * restrict stack, const unsig
 	}
 }
 
+FUNGE_ATTR_FAST funge_string_view stack_pop_string_view(funge_stack * restrict stack)
+{
+	funge_string_view view;
+	paranoid_assert(stack != NULL);
+	view.len = stack_strlen(stack);
+	view.start = stack->top - view.len;
+	// Pop the 0 too, unless the string reached the bottom of the stack.
+	stack->top = (view.start > 0) ? view.start - 1 : 0;
+	return view;
+}
+
+FUNGE_ATTR_FAST void stack_push_string_view(funge_stack * restrict stack,
+                                            const funge_string_view * restrict view,
+                                            size_t offset, size_t count)
+{
+	size_t source;
+	paranoid_assert(stack != NULL);
+	paranoid_assert(view != NULL);
+	paranoid_assert(offset + count <= view->len);
+	// In the entries the string is reversed, so the last of the characters
+	// to push is the lowest entry.
+	source = view->start + view->len - offset - count;
+	stack_prealloc_space(stack, count + 1);
+	// The characters may overlap where they end up, move them before
+	// writing the 0.
+	memmove(&stack->entries[stack->top + 1], &stack->entries[source],
+	        count * sizeof(funge_cell));
+	stack->entries[stack->top] = 0;
+	stack->top += count + 1;
+}
+
+/// Narrow the characters of a string view into buf, and null-terminate it.
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL
+static inline void stack_narrow_view(const funge_stack * restrict stack,
+                                     const funge_string_view * restrict view,
+                                     unsigned char * restrict buf)
+{
+	for (size_t i = 0; i < view->len; i++)
+		buf[i] = (unsigned char)stack_view_char(stack, *view, i);
+	buf[view->len] = '\0';
+}
+
 FUNGE_ATTR_FAST unsigned char *stack_pop_string(funge_stack * restrict stack, size_t * restrict len)
 {
-	funge_cell c;
-	size_t index = 0;
+	funge_string_view view;
 	unsigned char *buf;
 	paranoid_assert(stack != NULL);
-	// FIXME: This may very likely be more than is needed.
-	buf = (unsigned char*)malloc((stack->top + 1) * sizeof(unsigned char));
+	view = stack_pop_string_view(stack);
+	buf = (unsigned char*)malloc((view.len + 1) * sizeof(unsigned char));
 	if (FUNGE_UNLIKELY(!buf)) {
 		if (len)
 			*len = 0;
 		return NULL;
 	}
+	stack_narrow_view(stack, &view, buf);
+	if (len)
+		*len = view.len;
+	return buf;
+}
+
+/// Buffer for stack_pop_string_scratch().
+static unsigned char *string_scratch = NULL;
+/// Size of string_scratch.
+static size_t string_scratch_size = 0;
 
-	while ((c = stack_pop(stack)) != '\0') {
-		buf[index++] = (unsigned char)c;
+FUNGE_ATTR_FAST const unsigned char *stack_pop_string_scratch(funge_stack * restrict stack, size_t * restrict len)
+{
+	funge_string_view view;
+	paranoid_assert(stack != NULL);
+	view = stack_pop_string_view(stack);
+	if (FUNGE_UNLIKELY(view.len >= string_scratch_size)) {
+		size_t newsize = string_scratch_size ? string_scratch_size : ALLOCSIZE_SCRATCH;
+		unsigned char *newbuf;
+		while (newsize <= view.len)
+			newsize *= 2;
+		newbuf = (unsigned char*)realloc(string_scratch, newsize);
+		if (FUNGE_UNLIKELY(!newbuf)) {
+			if (len)
+				*len = 0;
+			return NULL;
+		}
+		string_scratch = newbuf;
+		string_scratch_size = newsize;
 	}
-	buf[index] = '\0';
+	stack_narrow_view(stack, &view, string_scratch);
 	if (len)
-		*len = index;
-	return buf;
+		*len = view.len;
+	return string_scratch;
 }
 
 FUNGE_ATTR_FAST void stack_push_string_multibyte(funge_stack * restrict stack, const funge_cell * restrict str, size_t len)
@@ -280,24 +372,21 @@ FUNGE_ATTR_FAST void stack_push_string_multibyte(funge_stack * restrict stack, c
 
 FUNGE_ATTR_FAST funge_cell *stack_pop_string_multibyte(funge_stack * restrict stack, size_t * restrict len)
 {
-	funge_cell c;
-	size_t index = 0;
+	funge_string_view view;
 	funge_cell *buf;
 	paranoid_assert(stack != NULL);
-	// FIXME: This may very likely be more than is needed.
-	buf = (funge_cell*)malloc((stack->top + 1) * sizeof(funge_cell));
+	view = stack_pop_string_view(stack);
+	buf = (funge_cell*)malloc((view.len + 1) * sizeof(funge_cell));
 	if (FUNGE_UNLIKELY(!buf)) {
 		if (len)
 			*len = 0;
 		return NULL;
 	}
-
-	while ((c = stack_pop(stack)) != '\0') {
-		buf[index++] = c;
-	}
-	buf[index] = '\0';
+	for (size_t i = 0; i < view.len; i++)
+		buf[i] = stack_view_char(stack, view, i);
+	buf[view.len] = '\0';
 	if (len)
-		*len = index;
+		*len = view.len;
 	return buf;
 }
 
@@ -405,6 +494,7 @@ funge_stackstack * stackstack_create(void)
 
 	stackStack->size = ALLOCSIZE_STACKSTACK;
 	stackStack->current = 0;
+	stackStack->pooled = 0;
 	stackStack->stacks[0] = stack;
 	return stackStack;
 }
@@ -414,7 +504,7 @@ FUNGE_ATTR_FAST void stackstack_free(funge_stackstack * me)
 	if (FUNGE_UNLIKELY(!me))
 		return;
 
-	for (size_t i = 0; i <= me->current; i++)
+	for (size_t i = 0; i <= me->current + me->pooled; i++)
 		stack_free(me->stacks[i]);
 
 	free(me);
@@ -445,10 +535,70 @@ FUNGE_ATTR_FAST funge_stackstack * stackstack_duplicate(const funge_stackstack *
 
 	stackStack->size = old->size;
 	stackStack->current = old->current;
+	stackStack->pooled = 0;
 	return stackStack;
 }
 #endif
 
+FUNGE_ATTR_FAST bool stackstack_save_image(FILE * restrict file, const funge_stackstack * restrict me)
+{
+	uint64_t count = me->current + 1;
+
+	if (!image_write_value(file, count))
+		return false;
+	for (size_t i = 0; i <= me->current; i++) {
+		const funge_stack *stack = me->stacks[i];
+		uint64_t top = stack->top;
+		if (!image_write_value(file, top)
+		    || !image_write(file, stack->entries, stack->top * sizeof(funge_cell)))
+			return false;
+	}
+	return true;
+}
+
+FUNGE_ATTR_FAST funge_stackstack * stackstack_load_image(FILE * restrict file)
+{
+	funge_stackstack * stackStack;
+	uint64_t count;
+	size_t size;
+
+	if (!image_read_value(file, count) || (count == 0) || (count > SIZE_MAX / sizeof(funge_stack*)))
+		return NULL;
+	// Round upwards to whole ALLOCSIZE_STACKSTACK sized blocks.
+	size = (size_t)count + ALLOCSIZE_STACKSTACK - ((size_t)count % ALLOCSIZE_STACKSTACK);
+
+	stackStack = (funge_stackstack*)malloc(sizeof(funge_stackstack) + size * sizeof(funge_stack*));
+	if (FUNGE_UNLIKELY(!stackStack))
+		return NULL;
+	stackStack->size = size;
+	stackStack->pooled = 0;
+
+	for (size_t i = 0; i < count; i++) {
+		funge_stack *stack;
+		uint64_t top;
+
+		stackStack->current = i;
+		stackStack->stacks[i] = NULL;
+		if (!image_read_value(file, top) || (top >= SIZE_MAX / sizeof(funge_cell) - ALLOCSIZE_STACK))
+			goto error;
+		stack = (funge_stack*)malloc(sizeof(funge_stack));
+		if (FUNGE_UNLIKELY(!stack))
+			goto error;
+		stack->top = (size_t)top;
+		stack->size = stack->top + ALLOCSIZE_STACK - (stack->top % ALLOCSIZE_STACK);
+		stack->entries = (funge_cell*)malloc(stack->size * sizeof(funge_cell));
+		stackStack->stacks[i] = stack;
+		if (FUNGE_UNLIKELY(!stack->entries)
+		    || !image_read(file, stack->entries, stack->top * sizeof(funge_cell)))
+			goto error;
+	}
+	return stackStack;
+error:
+	// stackstack_free() handles a NULL topmost stack.
+	stackstack_free(stackStack);
+	return NULL;
+}
+
 
 FUNGE_ATTR_FAST static void oom_stackstack(const instructionPointer * restrict ip)
 {
@@ -480,6 +630,7 @@ static inline bool stack_prealloc_space_non_fatal(funge_stack * restrict stack,
 		{
 			return false;
 		}
+		STATS_INC(stat_stack_reallocs);
 		newentries = (funge_cell*)realloc(stack->entries, allocation_size);
 		if (FUNGE_UNLIKELY(!newentries)) {
 			return false;
@@ -522,6 +673,78 @@ inline void stack_bulk_copy(funge_stack * restrict dest,
 	dest->top += count;
 }
 
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL
+void stack_bulk_move_reverse(funge_stack * restrict dest,
+                             funge_stack * restrict src, size_t count)
+{
+	funge_cell * restrict to;
+	const funge_cell * restrict from;
+	size_t available;
+
+	paranoid_assert(dest != NULL);
+	paranoid_assert(src != NULL);
+
+	stack_prealloc_space(dest, count);
+	available = (count > src->top) ? src->top : count;
+	to = &dest->entries[dest->top];
+	from = &src->entries[src->top - available];
+	// Simple enough loop for the compiler to vectorise.
+	for (size_t i = 0; i < available; i++)
+		to[i] = from[available - 1 - i];
+	src->top -= available;
+	// Popping an empty stack gives zeros.
+	if (count > available)
+		memset(&to[available], 0, (count - available) * sizeof(funge_cell));
+	dest->top += count;
+}
+
+/**
+ * Add zeros at the bottom of the stack so it has at least size elements, as
+ * popping past the bottom of the stack would give.
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL
+static inline void stack_pad_bottom(funge_stack * restrict stack, size_t size)
+{
+	if (size > stack->top) {
+		const size_t pad = size - stack->top;
+		stack_prealloc_space(stack, pad);
+		memmove(&stack->entries[pad], stack->entries, stack->top * sizeof(funge_cell));
+		memset(stack->entries, 0, pad * sizeof(funge_cell));
+		stack->top = size;
+	}
+}
+
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL
+void stack_insert(funge_stack * restrict stack, size_t depth,
+                  const funge_cell * restrict values, size_t count)
+{
+	size_t base;
+
+	paranoid_assert(stack != NULL);
+
+	stack_pad_bottom(stack, depth);
+	stack_prealloc_space(stack, count);
+	base = stack->top - depth;
+	memmove(&stack->entries[base + count], &stack->entries[base], depth * sizeof(funge_cell));
+	memcpy(&stack->entries[base], values, count * sizeof(funge_cell));
+	stack->top += count;
+}
+
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL
+void stack_remove(funge_stack * restrict stack, size_t depth,
+                  funge_cell * restrict values, size_t count)
+{
+	size_t base;
+
+	paranoid_assert(stack != NULL);
+
+	stack_pad_bottom(stack, depth + count);
+	base = stack->top - depth - count;
+	memcpy(values, &stack->entries[base], count * sizeof(funge_cell));
+	memmove(&stack->entries[base], &stack->entries[base + count], depth * sizeof(funge_cell));
+	stack->top -= count;
+}
+
 FUNGE_ATTR_FAST
 bool stackstack_begin(instructionPointer * ip, funge_cell count, const funge_vector * restrict storageOffset)
 {
@@ -534,29 +757,43 @@ bool stackstack_begin(instructionPointer * ip, funge_cell count, const funge_vec
 	// Set up variables
 	stackStack = ip->stackstack;
 
-	TOSS = stack_create();
-	if (FUNGE_UNLIKELY(!TOSS)) {
-		oom_stackstack(ip);
-		return false;
+	// Extend the stack stack allocation if required, doubling it so deep
+	// recursion doesn't realloc often. If it is full there are no pooled
+	// stacks to worry about.
+	if ((stackStack->size - 1) == stackStack->current) {
+		funge_stackstack *newStackStack;
+		STATS_INC(stat_stack_reallocs);
+		newStackStack = realloc(stackStack, sizeof(funge_stackstack) + stackStack->size * 2 * sizeof(funge_stack*));
+		if (FUNGE_UNLIKELY(!newStackStack)) {
+			oom_stackstack(ip);
+			return false;
+		}
+		stackStack = newStackStack;
+		stackStack->size *= 2;
+		ip->stackstack = stackStack;
+	}
+
+	// Reuse a stack from an earlier } if there is one.
+	if (stackStack->pooled > 0) {
+		TOSS = stackStack->stacks[stackStack->current + 1];
+	} else {
+		TOSS = stack_create_sized(ALLOCSIZE_STACK_FRAME);
+		if (FUNGE_UNLIKELY(!TOSS)) {
+			oom_stackstack(ip);
+			return false;
+		}
 	}
 	// Allocate enough space on the TOSS and reflect if not.
 	// This is count + 2 (storage offset)
 	if (FUNGE_UNLIKELY(!stack_prealloc_space_non_fatal(TOSS, ABS(count) + 2))) {
-		stack_free(TOSS);
+		// A pooled stack just stays in the pool.
+		if (stackStack->pooled == 0)
+			stack_free(TOSS);
 		oom_stackstack(ip);
 		return false;
 	}
-
-	// Extend the stack stack allocation if required:
-	if ((stackStack->size - 1) == stackStack->current) {
-		stackStack = realloc(stackStack, sizeof(funge_stackstack) + (stackStack->size + ALLOCSIZE_STACKSTACK) * sizeof(funge_stack*));
-		if (FUNGE_UNLIKELY(!stackStack)) {
-			stack_free(TOSS);
-			oom_stackstack(ip);
-			return false;
-		}
-		stackStack->size += ALLOCSIZE_STACKSTACK;
-	}
+	if (stackStack->pooled > 0)
+		stackStack->pooled--;
 
 	SOSS = stackStack->stacks[stackStack->current];
 
@@ -577,7 +814,6 @@ bool stackstack_begin(instructionPointer * ip, funge_cell count, const funge_vec
 	ip->storageOffset.x = storageOffset->x;
 	ip->storageOffset.y = storageOffset->y;
 	ip->stack = TOSS;
-	ip->stackstack = stackStack;
 	return true;
 }
 
@@ -606,11 +842,21 @@ bool stackstack_end(instructionPointer * ip, funge_cell count)
 	ip->storageOffset.y = storageOffset.y;
 
 	ip->stack = SOSS;
-	stackStack->stacks[stackStack->current] = NULL;
 	// TODO: Should we shrink stack stack allocation if difference is large?
 	// Needs testing to figure out.
 	stackStack->current--;
-	stack_free(TOSS);
+	// Keep the TOSS for the next {, it is already in the right place: the
+	// pooled stacks start just after current. Stacks that grew large are
+	// freed instead, moving the last pooled stack into the hole.
+	if (FUNGE_LIKELY(TOSS->size <= ALLOCSIZE_STACK)) {
+		TOSS->top = 0;
+		stackStack->pooled++;
+	} else {
+		const size_t hole = stackStack->current + 1;
+		stack_free(TOSS);
+		stackStack->stacks[hole] = stackStack->stacks[hole + stackStack->pooled];
+		stackStack->stacks[hole + stackStack->pooled] = NULL;
+	}
 	return true;
 }
 
@@ -623,12 +869,8 @@ void stackstack_transfer(funge_cell count, funge_stack * restrict TOSS, funge_st
 	assert(TOSS != SOSS);
 
 	if (count > 0) {
-		while (count--) {
-			stack_push(TOSS, stack_pop(SOSS));
-		}
+		stack_bulk_move_reverse(TOSS, SOSS, (size_t)count);
 	} else if (count < 0) {
-		while (count++) {
-			stack_push(SOSS, stack_pop(TOSS));
-		}
+		stack_bulk_move_reverse(SOSS, TOSS, (size_t)(-count));
 	}
 }
@@ -31,6 +31,7 @@
 
 #include <sys/types.h>
 #include <stdint.h>
+#include <stdio.h>
 
 #include "vector.h"
 
@@ -50,6 +51,8 @@ typedef struct funge_stack {
 typedef struct funge_stackstack {
 	size_t         size;     ///< This is number of elements in stacks.
 	size_t         current;  ///< Top stack and current stack.
+	/// Number of unused stacks kept after current in stacks, for reuse by {.
+	size_t         pooled;
 	funge_stack  * stacks[]; ///< Array of pointers to stacks.
 } funge_stackstack;
 
@@ -151,6 +154,53 @@ FUNGE_ATTR_MALLOC FUNGE_ATTR_WARN_UNUSED FUNGE_ATTR((nonnull(1))) FUNGE_ATTR_FAS
 funge_cell * stack_pop_string_multibyte(funge_stack * restrict stack,
                                         size_t * restrict len);
 
+/**
+ * Pop a 0"gnirts" into a buffer that is reused between calls, instead of
+ * allocating a new string. The returned string is only valid until the next
+ * call to this function, and must not be freed.
+ * @param stack A pointer to the stack in question.
+ * @param len If non-NULL, the string length is stored in this variable.
+ * @return Null-terminated string, or NULL if the buffer could not be grown.
+ */
+FUNGE_ATTR_WARN_UNUSED FUNGE_ATTR((nonnull(1))) FUNGE_ATTR_FAST
+const unsigned char * stack_pop_string_scratch(funge_stack * restrict stack,
+                                               size_t * restrict len);
+
+/**
+ * A 0"gnirts" that has been popped but still is in the entries of the stack.
+ * The string is stored in reverse, the first character is the highest entry.
+ */
+typedef struct funge_string_view {
+	size_t start; ///< Index of the last character in the entries of the stack.
+	size_t len;   ///< Length of the string, excluding the 0.
+} funge_string_view;
+
+/// Get character i (counting from the start of the string) of a string view.
+#define stack_view_char(m_stack, m_view, m_i) \
+	((m_stack)->entries[(m_view).start + (m_view).len - 1 - (m_i)])
+
+/**
+ * Pop a 0"gnirts" without copying it. The characters can be accessed with
+ * stack_view_char() until something is pushed to the stack.
+ * @param stack A pointer to the stack in question.
+ */
+FUNGE_ATTR_WARN_UNUSED FUNGE_ATTR_NONNULL FUNGE_ATTR_FAST
+funge_string_view stack_pop_string_view(funge_stack * restrict stack);
+
+/**
+ * Push count characters starting at offset of a string view as a 0"gnirts".
+ * The view must have been popped from the same stack, with nothing pushed
+ * since.
+ * @param stack A pointer to the stack in question.
+ * @param view The string view.
+ * @param offset Index of the first character to push.
+ * @param count Number of characters to push.
+ */
+FUNGE_ATTR_NONNULL FUNGE_ATTR_FAST
+void stack_push_string_view(funge_stack * restrict stack,
+                            const funge_string_view * restrict view,
+                            size_t offset, size_t count);
+
 /**
  * Free a 0"gnirts" that was popped with stack_pop_string().
  * Do NOT use for stack_pop_sized_string().
@@ -217,11 +267,66 @@ FUNGE_ATTR_MALLOC FUNGE_ATTR_NONNULL FUNGE_ATTR_WARN_UNUSED FUNGE_ATTR_FAST
 funge_stackstack * stackstack_duplicate(const funge_stackstack * restrict old);
 #endif
 
+/**
+ * Write a stack-stack and the contents of all its stacks to an image.
+ * @param file Image file to write to.
+ * @param me Stack-stack to write.
+ * @return True if successful, otherwise false.
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL FUNGE_ATTR_WARN_UNUSED
+bool stackstack_save_image(FILE * restrict file,
+                           const funge_stackstack * restrict me);
+/**
+ * Create a stack-stack from data written by stackstack_save_image().
+ * @param file Image file to read from.
+ * @return The new stack-stack, or NULL on error.
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL FUNGE_ATTR_MALLOC FUNGE_ATTR_WARN_UNUSED
+funge_stackstack * stackstack_load_image(FILE * restrict file);
+
 /// This does an in-order bulk copy of count elements between two stacks.
 FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL
 void stack_bulk_copy(funge_stack * restrict dest,
                      const funge_stack * restrict src, size_t count);
 
+/**
+ * Move count elements from src to dest, one at a time. The result is the same
+ * as count calls of stack_push(dest, stack_pop(src)), so the order is reversed
+ * and zeros are pushed if src runs out.
+ * @param dest Stack to push on.
+ * @param src Stack to pop from.
+ * @param count How many items to move.
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL
+void stack_bulk_move_reverse(funge_stack * restrict dest,
+                             funge_stack * restrict src, size_t count);
+
+/**
+ * Insert elements below the top depth elements of the stack. The result is
+ * the same as popping depth elements, pushing values and then pushing back
+ * the popped elements.
+ * @param stack Stack to operate on.
+ * @param depth How many elements to insert below.
+ * @param values Elements to insert, bottom first.
+ * @param count Number of elements in values.
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL
+void stack_insert(funge_stack * restrict stack, size_t depth,
+                  const funge_cell * restrict values, size_t count);
+
+/**
+ * Remove elements below the top depth elements of the stack. The result is
+ * the same as popping depth elements, popping count elements into values and
+ * then pushing back the first popped elements.
+ * @param stack Stack to operate on.
+ * @param depth How many elements to remove below.
+ * @param values Filled in with the removed elements, bottom first.
+ * @param count Number of elements to remove.
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL
+void stack_remove(funge_stack * restrict stack, size_t depth,
+                  funge_cell * restrict values, size_t count);
+
 /**
  * Begin a new stack on the stack-stack.
  * @param ip Instruction pointer (will operate on it's stack stack).
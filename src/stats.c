@@ -0,0 +1,121 @@
+/* -*- mode: C; coding: utf-8; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*-
+ *
+ * cfunge - A standard-conforming Befunge93/98/109 interpreter in C.
+ * Copyright (C) 2008-2013 Arvid Norlander <VorpalBlade AT users.noreply.github.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at the proxy's option) any later version. Arvid Norlander is a
+ * proxy who can decide which future versions of the GNU General Public
+ * License can be used.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "global.h"
+#include "stats.h"
+
+#include "diagnostic.h"
+#include "output.h"
+#include "settings.h"
+#include "funge-space/funge-space.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h> /* memset, strerror */
+
+uint64_t stats_counters[stat_counter_count];
+volatile sig_atomic_t stats_requested = 0;
+
+/// Names of the statistics, indexed by fungeStat.
+static const char * const stats_names[stat_count] = {
+	"instructions",
+	"wraps",
+	"space_skips",
+	"static_gets",
+	"hash_gets",
+	"static_sets",
+	"hash_sets",
+	"stack_reallocs",
+	"ip_spawns",
+	"ip_kills",
+	"fingerprint_loads",
+	"hash_items",
+	"hash_buckets",
+	"hash_used_buckets",
+	"hash_longest_chain",
+};
+
+FUNGE_ATTR_FAST uint64_t stats_get(fungeStat stat)
+{
+	fungeHashStats hash;
+
+	assert(stat < stat_count);
+	if (stat < stat_counter_count)
+		return stats_counters[stat];
+	fungespace_get_hash_stats(&hash);
+	if (stat == stat_hash_items)
+		return hash.items;
+	else if (stat == stat_hash_buckets)
+		return hash.buckets;
+	else if (stat == stat_hash_used_buckets)
+		return hash.used_buckets;
+	else
+		return hash.longest_chain;
+}
+
+FUNGE_ATTR_FAST const char * stats_name(fungeStat stat)
+{
+	assert(stat < stat_count);
+	return stats_names[stat];
+}
+
+FUNGE_ATTR_FAST void stats_reset(void)
+{
+	memset(stats_counters, 0, sizeof(stats_counters));
+}
+
+FUNGE_ATTR_FAST void stats_print(void)
+{
+	// Make sure the output of the program comes before the report.
+	output_flush();
+	fputs("\ncfunge statistics:\n", stderr);
+	for (int i = 0; i < stat_count; i++) {
+		fprintf(stderr, "%-20s %12" PRIu64 "\n",
+		        stats_names[i], stats_get((fungeStat)i));
+	}
+}
+
+/// Ask the main loop to print the statistics.
+static void stats_signal_handler(int signum)
+{
+	(void)signum;
+	stats_requested = 1;
+}
+
+FUNGE_ATTR_FAST void stats_init(void)
+{
+	struct sigaction action;
+
+	if (!setting_print_stats)
+		return;
+	atexit(&stats_print);
+
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = &stats_signal_handler;
+	sigemptyset(&action.sa_mask);
+	action.sa_flags = SA_RESTART;
+	if (FUNGE_UNLIKELY(sigaction(SIGUSR2, &action, NULL) != 0)) {
+		diag_fatal_format("Failed to install SIGUSR2 handler: %s", strerror(errno));
+	}
+}
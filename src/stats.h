@@ -0,0 +1,109 @@
+/* -*- mode: C; coding: utf-8; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*-
+ *
+ * cfunge - A standard-conforming Befunge93/98/109 interpreter in C.
+ * Copyright (C) 2008-2013 Arvid Norlander <VorpalBlade AT users.noreply.github.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at the proxy's option) any later version. Arvid Norlander is a
+ * proxy who can decide which future versions of the GNU General Public
+ * License can be used.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file
+ * Runtime statistics counters.
+ *
+ * The counters are always updated (unless built with -DENABLE_STATS=OFF) and
+ * are cheap enough for that: a single increment at each counted event. They
+ * are printed to stderr at exit and on SIGUSR2 when -m is given, and can be
+ * read by programs through the STAT fingerprint.
+ */
+
+#ifndef FUNGE_HAD_SRC_STATS_H
+#define FUNGE_HAD_SRC_STATS_H
+
+#include "global.h"
+
+#include <signal.h>
+#include <stdint.h>
+
+/// Indexes of the statistics. The order is part of the STAT fingerprint
+/// interface, only add new ones at the end.
+typedef enum e_fungeStat {
+	stat_instructions,      ///< Instructions executed.
+	stat_wraps,             ///< Times an IP wrapped around Funge-Space.
+	stat_space_skips,       ///< Cells skipped over by spaces.
+	stat_static_gets,       ///< Funge-Space reads from the static area.
+	stat_hash_gets,         ///< Funge-Space reads from the hash table.
+	stat_static_sets,       ///< Funge-Space writes to the static area.
+	stat_hash_sets,         ///< Funge-Space writes to the hash table.
+	stat_stack_reallocs,    ///< Reallocations of stacks and stack-stacks.
+	stat_ip_spawns,         ///< IPs created by t.
+	stat_ip_kills,          ///< IPs terminated.
+	stat_fingerprint_loads, ///< Successful fingerprint loads.
+	/// Number of counters above, the ones below are computed when read.
+	stat_counter_count,
+	stat_hash_items = stat_counter_count, ///< Cells in the hash table.
+	stat_hash_buckets,      ///< Buckets in the hash table.
+	stat_hash_used_buckets, ///< Buckets with at least one cell.
+	stat_hash_longest_chain, ///< Cells in the fullest bucket.
+	/// Total number of statistics.
+	stat_count
+} fungeStat;
+
+/// The counters, indexed by fungeStat.
+extern uint64_t stats_counters[stat_counter_count];
+
+/// Set by the SIGUSR2 handler, checked by the main loop between instructions.
+extern volatile sig_atomic_t stats_requested;
+
+#ifndef DISABLE_STATS
+/// Count an event.
+#  define STATS_INC(m_stat) (stats_counters[(m_stat)]++)
+/// Count several events.
+#  define STATS_ADD(m_stat, m_count) (stats_counters[(m_stat)] += (m_count))
+#else
+#  define STATS_INC(m_stat) ((void)0)
+#  define STATS_ADD(m_stat, m_count) ((void)0)
+#endif
+
+/**
+ * Install the SIGUSR2 handler and the exit report if -m was given.
+ * @warning Should only be called from internal setup code.
+ */
+FUNGE_ATTR_FAST
+void stats_init(void);
+
+/**
+ * Get the value of a statistic.
+ * @param stat Which one, must be less than stat_count.
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_WARN_UNUSED
+uint64_t stats_get(fungeStat stat);
+
+/**
+ * Get the name of a statistic, as printed by stats_print().
+ * @param stat Which one, must be less than stat_count.
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_CONST FUNGE_ATTR_WARN_UNUSED
+const char * stats_name(fungeStat stat);
+
+/// Reset the counters (but not the computed statistics) to zero.
+FUNGE_ATTR_FAST
+void stats_reset(void);
+
+/// Print all statistics to stderr.
+FUNGE_ATTR_FAST FUNGE_ATTR_COLD
+void stats_print(void);
+
+#endif
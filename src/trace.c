@@ -0,0 +1,128 @@
+/* -*- mode: C; coding: utf-8; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*-
+ *
+ * cfunge - A standard-conforming Befunge93/98/109 interpreter in C.
+ * Copyright (C) 2008-2013 Arvid Norlander <VorpalBlade AT users.noreply.github.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at the proxy's option) any later version. Arvid Norlander is a
+ * proxy who can decide which future versions of the GNU General Public
+ * License can be used.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "global.h"
+#include "trace.h"
+
+#include "diagnostic.h"
+#include "settings.h"
+#include "stack.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h> /* memcpy, memset, strerror */
+#include <unistd.h>
+
+#include <sys/mman.h>
+
+uint64_t trace_tick = 0;
+
+#ifndef DISABLE_TRACE
+
+/// The mapped trace file, header followed by the ring of records.
+static traceHeader *trace_header = NULL;
+static traceRecord *trace_ring = NULL;
+static size_t trace_map_size = 0;
+
+/// Flush the trace file when exiting.
+static void trace_finish(void)
+{
+	if (!trace_header)
+		return;
+	if (msync(trace_header, trace_map_size, MS_SYNC) != 0)
+		diag_warn_format("Failed to write trace \"%s\": %s", setting_trace_file, strerror(errno));
+	munmap(trace_header, trace_map_size);
+	trace_header = NULL;
+	trace_ring = NULL;
+}
+
+FUNGE_ATTR_FAST void trace_init(void)
+{
+	int fd;
+	void *map;
+
+	if (!setting_trace_file)
+		return;
+	trace_map_size = sizeof(traceHeader) + TRACE_RECORDS * sizeof(traceRecord);
+	fd = open(setting_trace_file, O_RDWR | O_CREAT | O_TRUNC, 0666);
+	if (fd == -1)
+		diag_fatal_format("Failed to open trace \"%s\": %s", setting_trace_file, strerror(errno));
+	if (ftruncate(fd, (off_t)trace_map_size) != 0)
+		diag_fatal_format("Failed to size trace \"%s\": %s", setting_trace_file, strerror(errno));
+	map = mmap(NULL, trace_map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED)
+		diag_fatal_format("Failed to map trace \"%s\": %s", setting_trace_file, strerror(errno));
+	// The mapping stays valid after closing.
+	close(fd);
+
+	trace_header = map;
+	trace_ring = (traceRecord*)(trace_header + 1);
+	memset(trace_header, 0, sizeof(traceHeader));
+	memcpy(trace_header->magic, TRACE_MAGIC, sizeof(TRACE_MAGIC));
+	trace_header->version = TRACE_VERSION;
+	trace_header->byteorder = TRACE_BYTEORDER;
+	trace_header->recordsize = sizeof(traceRecord);
+	trace_header->cellsize = sizeof(funge_cell);
+	trace_header->capacity = TRACE_RECORDS;
+	atexit(&trace_finish);
+}
+
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL
+void trace_record(const instructionPointer * restrict ip, funge_cell opcode)
+{
+	uint64_t sequence = trace_header->written;
+	traceRecord *record = &trace_ring[sequence % TRACE_RECORDS];
+	size_t depth = ip->stack->top;
+
+	record->sequence = sequence;
+#ifdef CONCURRENT_FUNGE
+	record->tick = trace_tick;
+#else
+	record->tick = sequence;
+#endif
+	record->id = ip->ID;
+	record->x = ip->position.x;
+	record->y = ip->position.y;
+	record->opcode = opcode;
+	record->depth = depth > UINT32_MAX ? UINT32_MAX : (uint32_t)depth;
+	record->flags = 0;
+	if (ip->mode == ipmSTRING)
+		record->flags |= TRACE_FLAG_STRING;
+	if (depth > 0) {
+		record->top = ip->stack->entries[depth - 1];
+		record->flags |= TRACE_FLAG_TOP;
+	} else {
+		record->top = 0;
+	}
+	// Only count the record when it is complete, so a reader of a crashed
+	// run never sees a partial one.
+	trace_header->written = sequence + 1;
+}
+
+#else
+
+FUNGE_ATTR_FAST void trace_init(void)
+{
+	// Tracing disabled in this build, -T is ignored.
+}
+
+#endif /* DISABLE_TRACE */
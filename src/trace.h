@@ -0,0 +1,104 @@
+/* -*- mode: C; coding: utf-8; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*-
+ *
+ * cfunge - A standard-conforming Befunge93/98/109 interpreter in C.
+ * Copyright (C) 2008-2013 Arvid Norlander <VorpalBlade AT users.noreply.github.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at the proxy's option) any later version. Arvid Norlander is a
+ * proxy who can decide which future versions of the GNU General Public
+ * License can be used.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file
+ * Binary execution trace, enabled with -T.
+ *
+ * One fixed size record is written for each instruction executed, into a
+ * ring of records in a memory mapped file. When the ring is full the oldest
+ * records are overwritten, so the file always holds the end of the run, also
+ * if cfunge crashes. Use tools/cfunge-trace.py to decode, filter and diff
+ * trace files.
+ */
+
+#ifndef FUNGE_HAD_SRC_TRACE_H
+#define FUNGE_HAD_SRC_TRACE_H
+
+#include "global.h"
+
+#include <stdint.h>
+
+#include "ip.h"
+
+/// Magic at the start of a trace file.
+#define TRACE_MAGIC "CFUNTRC"
+/// Version of the trace file format. Change when the layout changes.
+#define TRACE_VERSION 1
+/// Used to check the byte order of a trace file.
+#define TRACE_BYTEORDER 0x01020304
+/// Number of records in the ring.
+#define TRACE_RECORDS (1024 * 1024)
+
+/// Set in traceRecord.flags if top is valid (the stack wasn't empty).
+#define TRACE_FLAG_TOP 0x1
+/// Set in traceRecord.flags if the IP was in string mode.
+#define TRACE_FLAG_STRING 0x2
+
+/**
+ * Header of a trace file. Everything is in native byte order.
+ * The size is a multiple of the record size.
+ */
+typedef struct s_traceHeader {
+	char     magic[8];   ///< TRACE_MAGIC, NUL terminated.
+	uint32_t version;    ///< TRACE_VERSION.
+	uint32_t byteorder;  ///< TRACE_BYTEORDER.
+	uint32_t recordsize; ///< sizeof(traceRecord).
+	uint32_t cellsize;   ///< sizeof(funge_cell) of the cfunge that wrote it.
+	uint64_t capacity;   ///< Number of records in the ring.
+	uint64_t written;    ///< Number of records written in total. The next
+	                     ///< record goes at written % capacity.
+	uint8_t  padding[24];
+} traceHeader;
+
+/// One executed instruction.
+typedef struct s_traceRecord {
+	uint64_t sequence; ///< Number of instructions executed before this one.
+	uint64_t tick;     ///< Tick, 0 based (same as sequence unless concurrent).
+	int64_t  id;       ///< ID of the IP.
+	int64_t  x;        ///< Position of the IP.
+	int64_t  y;        ///< Position of the IP.
+	int64_t  opcode;   ///< The instruction.
+	int64_t  top;      ///< Value on top of the stack, if TRACE_FLAG_TOP.
+	uint32_t depth;    ///< Number of items on the stack (saturating).
+	uint32_t flags;    ///< TRACE_FLAG_*.
+} traceRecord;
+
+/// Current tick, advanced by the main loop for concurrent Funge.
+extern uint64_t trace_tick;
+
+/**
+ * Create the trace file if -T was given.
+ * @warning Should only be called from internal setup code.
+ */
+FUNGE_ATTR_FAST
+void trace_init(void);
+
+/**
+ * Record an instruction about to be executed. Only call when
+ * setting_trace_file is set.
+ * @param ip The IP executing it.
+ * @param opcode The instruction.
+ */
+FUNGE_ATTR_FAST FUNGE_ATTR_NONNULL
+void trace_record(const instructionPointer * restrict ip, funge_cell opcode);
+
+#endif
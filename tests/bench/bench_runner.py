@@ -0,0 +1,254 @@
+#!/usr/bin/python3
+"""Benchmark runner for cfunge"""
+
+import argparse
+import hashlib
+import json
+import os
+import os.path
+import subprocess
+import sys
+import time
+
+_BENCH_DIR = os.path.dirname(os.path.abspath(__file__))
+_EXAMPLES_DIR = os.path.join(_BENCH_DIR, '..', '..', 'examples')
+
+# Name, program, extra command line arguments and data for stdin.
+# Programs are looked for in this directory, then in examples/.
+# large-load.b98 is generated in the work directory.
+# life.bf is not included as it never terminates.
+_WORKLOADS = [
+    ('arith', 'arith.b98', [], b''),
+    ('sparse-pg', 'sparse-pg.b98', [], b''),
+    ('wrap', 'wrap.b98', [], b''),
+    ('fanout', 'fanout.b98', [], b''),
+    ('deep-stack', 'deep-stack.b98', [], b''),
+    ('fingerprints', 'fingerprints.b98', [], b''),
+    ('fixp', 'fixp.b98', [], b''),
+    ('rexp', 'rexp.b98', [], b''),
+    ('large-load', 'large-load.b98', [], b''),
+    ('pi2', 'pi2.bf', [], b''),
+    ('prime', 'prime.bf', [], b''),
+    ('fib', 'fib.bf', [], b'24\n'),
+]
+
+# Workloads that measure loading rather than execution, for these the load
+# time (total time minus startup time) is reported instead of ns/instruction.
+_LOAD_WORKLOADS = ('large-load',)
+
+_LARGE_LOAD_SIZE = 1000
+
+
+def find_program(name, work_dir):
+    """Find the path of a workload program"""
+    for directory in (_BENCH_DIR, _EXAMPLES_DIR, work_dir):
+        path = os.path.join(directory, name)
+        if os.path.exists(path):
+            return path
+    raise FileNotFoundError(name)
+
+
+def generate_programs(work_dir):
+    """Generate programs that are too large to keep in the source tree"""
+    os.makedirs(work_dir, exist_ok=True)
+    path = os.path.join(work_dir, 'large-load.b98')
+    if not os.path.exists(path):
+        line = ('0123456789abcdef' * (_LARGE_LOAD_SIZE // 16 + 1))[:_LARGE_LOAD_SIZE]
+        with open(path, mode='w') as f:
+            f.write('@' + line[1:] + '\n')
+            for _ in range(_LARGE_LOAD_SIZE - 1):
+                f.write(line + '\n')
+    path = os.path.join(work_dir, 'startup.b98')
+    if not os.path.exists(path):
+        with open(path, mode='w') as f:
+            f.write('@\n')
+
+
+def run_once(command, stdin_data):
+    """Run command once, return (wall time in ns, peak RSS in kB)
+
+    Note that on Linux the peak RSS of a child includes that of this runner at
+    the time of the fork, so it is never below the size of this process."""
+    start = time.perf_counter_ns()
+    process = subprocess.Popen(command,
+                               stdin=subprocess.PIPE,
+                               stdout=subprocess.DEVNULL,
+                               stderr=subprocess.DEVNULL)
+    if stdin_data:
+        try:
+            process.stdin.write(stdin_data)
+        except BrokenPipeError:
+            pass
+    process.stdin.close()
+    # Use wait4() directly to get the resource usage of just this child.
+    _, status, rusage = os.wait4(process.pid, 0)
+    elapsed = time.perf_counter_ns() - start
+    process.returncode = os.waitstatus_to_exitcode(status)
+    if process.returncode != 0:
+        raise subprocess.CalledProcessError(process.returncode, command)
+    return elapsed, rusage.ru_maxrss
+
+
+def count_instructions(command, stdin_data):
+    """Count executed instructions using trace level 3, which prints one
+    character to stderr for each instruction executed."""
+    count = 0
+    with subprocess.Popen(command[:1] + ['-t', '3'] + command[1:],
+                          stdin=subprocess.PIPE,
+                          stdout=subprocess.DEVNULL,
+                          stderr=subprocess.PIPE) as process:
+        process.stdin.write(stdin_data)
+        process.stdin.close()
+        # Don't keep the trace in memory, that would inflate the peak RSS
+        # of later runs (see run_once()).
+        while True:
+            data = process.stderr.read(65536)
+            if not data:
+                break
+            count += len(data)
+    if process.returncode != 0:
+        raise subprocess.CalledProcessError(process.returncode, command)
+    return count
+
+
+def file_digest(path):
+    """Return SHA-1 of a file"""
+    with open(path, mode='rb') as f:
+        return hashlib.sha1(f.read()).hexdigest()
+
+
+def load_json(path, default):
+    """Load a JSON file, or return default if it doesn't exist"""
+    if path is None or not os.path.exists(path):
+        return default
+    with open(path) as f:
+        return json.load(f)
+
+
+def run_benchmarks(args):
+    """Run all selected workloads, return the results"""
+    generate_programs(args.work_dir)
+    counts_path = os.path.join(args.work_dir, 'bench-counts.json')
+    counts = load_json(counts_path, {})
+
+    results = {
+        'cfunge': args.cfunge_path,
+        'repeat': args.repeat,
+        'workloads': {},
+    }
+
+    startup = os.path.join(args.work_dir, 'startup.b98')
+    results['startup_ns'] = min(run_once([args.cfunge_path, startup], b'')[0]
+                                for _ in range(args.repeat))
+
+    for name, program, extra_args, stdin_data in _WORKLOADS:
+        if args.only and name not in args.only:
+            continue
+        path = find_program(program, args.work_dir)
+        command = [args.cfunge_path] + extra_args + [path]
+        # Programs are deterministic, so counts only change with the program.
+        key = '%s:%s:%s' % (name, file_digest(path), hashlib.sha1(stdin_data).hexdigest())
+        if key not in counts:
+            print('Counting instructions for %s...' % name, file=sys.stderr)
+            counts[key] = count_instructions(command, stdin_data)
+        instructions = counts[key]
+
+        times = []
+        rss = 0
+        for _ in range(args.repeat):
+            elapsed, maxrss = run_once(command, stdin_data)
+            times.append(elapsed)
+            rss = max(rss, maxrss)
+        best = min(times)
+        data = {
+            'instructions': instructions,
+            'time_ns': best,
+            'peak_rss_kb': rss,
+        }
+        if name in _LOAD_WORKLOADS:
+            data['load_ns'] = max(best - results['startup_ns'], 0)
+            summary = '%8.3f ms load' % (data['load_ns'] / 1e6)
+        elif instructions:
+            data['ns_per_instruction'] = best / instructions
+            summary = '%8.2f ns/instr' % data['ns_per_instruction']
+        else:
+            # Trace support is disabled in this binary.
+            summary = ''
+        results['workloads'][name] = data
+        print('%-14s %10d instr %10.3f ms %8d kB %s' %
+              (name, instructions, best / 1e6, rss, summary),
+              file=sys.stderr)
+
+    with open(counts_path, mode='w') as f:
+        json.dump(counts, f, indent=1, sort_keys=True)
+    return results
+
+
+def compare(results, baseline, threshold):
+    """Compare against baseline, return True if there were no regressions"""
+    success = True
+    checks = [('startup', results['startup_ns'], baseline.get('startup_ns'))]
+    for name, data in sorted(results['workloads'].items()):
+        old = baseline.get('workloads', {}).get(name)
+        if old:
+            checks.append((name, data['time_ns'], old['time_ns']))
+    for name, new, old in checks:
+        if not old:
+            continue
+        change = (new - old) / old * 100
+        mark = ''
+        if change > threshold:
+            mark = '  REGRESSION'
+            success = False
+        print('%-14s %+7.1f %%%s' % (name, change, mark), file=sys.stderr)
+    return success
+
+
+def main():
+    """Main function"""
+    parser = argparse.ArgumentParser(description='Benchmark runner for cfunge')
+    parser.add_argument('cfunge_path',
+                        help='Path to cfunge')
+    parser.add_argument('--work-dir',
+                        default='.',
+                        help='Directory for generated programs and cached data (default: .)')
+    parser.add_argument('--repeat',
+                        default=5,
+                        type=int,
+                        help='Number of runs of each workload, the fastest is used (default: 5)')
+    parser.add_argument('--only',
+                        action='append',
+                        help='Only run the given workload (may be repeated)')
+    parser.add_argument('--output',
+                        help='Write results as JSON to this file (default: stdout)')
+    parser.add_argument('--baseline',
+                        help='Compare against results in this file, if it exists')
+    parser.add_argument('--save-baseline',
+                        help='Also write results to this file, for later comparisons')
+    parser.add_argument('--threshold',
+                        default=10.0,
+                        type=float,
+                        help='Slowdown in percent counted as a regression (default: 10)')
+    args = parser.parse_args()
+    args.cfunge_path = os.path.abspath(args.cfunge_path)
+
+    results = run_benchmarks(args)
+
+    for path in (args.output, args.save_baseline):
+        if path:
+            with open(path, mode='w') as f:
+                json.dump(results, f, indent=1, sort_keys=True)
+                f.write('\n')
+    if not args.output:
+        json.dump(results, sys.stdout, indent=1, sort_keys=True)
+        print()
+
+    baseline = load_json(args.baseline, None)
+    if baseline is not None and not args.save_baseline:
+        if not compare(results, baseline, args.threshold):
+            sys.exit(1)
+    sys.exit(0)
+
+
+if __name__ == '__main__':
+    main()
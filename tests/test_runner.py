@@ -4,9 +4,13 @@
 import argparse
 import os
 import os.path
+import re
+import select
 import sys
 import subprocess
 
+_TRACE_DECODER = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'tools', 'cfunge-trace.py')
+
 _SUFFIX_MAP = {
     'b109': '109',
     'b93': '93',
@@ -17,10 +21,12 @@ _SUFFIX_MAP = {
 
 def cleanup():
     """Clean up output files from the test"""
-    try:
-        os.unlink('cfunge_TURT.svg')
-    except OSError:
-        pass
+    for path in ('cfunge_TURT.svg', 'test.img', 'replay.log', 'samples.folded', 'profile.pgm', 'test.trace',
+                 'checkpoint.img', 'checkpoint.img.tmp'):
+        try:
+            os.unlink(path)
+        except OSError:
+            pass
 
 
 def compare_contents(name, expected, actual, test_filter):
@@ -52,6 +58,85 @@ def compare_contents(name, expected, actual, test_filter):
         return False
 
 
+def read_input(path_base):
+    """Return the data for stdin from <test>.input, or None if there is none"""
+    try:
+        with open(path_base + '.input', mode='rb') as f:
+            return f.read()
+    except FileNotFoundError:
+        return None
+
+
+_SAMPLE_LINE = re.compile(rb'ip (\d+);rows (-?\d+)-(-?\d+);x=(-?\d+) y=(-?\d+) (\d+)\n')
+
+
+def check_samples(program_path):
+    """Check that samples.folded from -p is well formed, return True if it is"""
+    with open(program_path, mode='rb') as f:
+        program = f.read().split(b'\n')
+    with open('samples.folded', mode='rb') as f:
+        lines = f.readlines()
+    if not lines:
+        print("No samples were written", file=sys.stderr)
+        return False
+    for line in lines:
+        match = _SAMPLE_LINE.fullmatch(line)
+        if not match:
+            print("Malformed sample line %r" % line, file=sys.stderr)
+            return False
+        first_row, last_row, x, y, count = (int(v) for v in match.groups()[1:])
+        if first_row != y - y % 16 or last_row != first_row + 15:
+            print("Sample %r is in the wrong band of rows" % line, file=sys.stderr)
+            return False
+        if not (0 <= y < len(program) and 0 <= x < len(program[y])) or count < 1:
+            print("Sample %r is not for a cell of the program" % line, file=sys.stderr)
+            return False
+    return True
+
+
+def run(command, stdin_data):
+    """Run cfunge, return (exit code, output, error output)
+
+    If stdin_data is None stdin is inherited."""
+    process = subprocess.run(command,
+                             input=stdin_data,
+                             stdout=subprocess.PIPE,
+                             stderr=subprocess.PIPE,
+                             env={'TEST_ENV': 'test'})
+    sys.stderr.buffer.write(process.stderr)
+    sys.stderr.flush()
+    return process.returncode, process.stdout, process.stderr
+
+
+def run_prompted(command, stdin_data, prompt=b'? ', timeout=10):
+    """Run cfunge, sending each line of stdin_data only after the program has
+    printed another prompt. Return (exit code, output, error output), the exit
+    code is None if a prompt didn't show up."""
+    process = subprocess.Popen(command,
+                               stdin=subprocess.PIPE,
+                               stdout=subprocess.PIPE,
+                               stderr=subprocess.PIPE,
+                               env={'TEST_ENV': 'test'})
+    output = b''
+    for count, line in enumerate(stdin_data.splitlines(keepends=True), start=1):
+        while output.count(prompt) < count or not output.endswith(prompt):
+            ready, _, _ = select.select([process.stdout], [], [], timeout)
+            data = os.read(process.stdout.fileno(), 4096) if ready else b''
+            if not data:
+                process.kill()
+                _, error_output = process.communicate()
+                print("No prompt before input line %d, output so far: %r" % (count, output),
+                      file=sys.stderr)
+                return None, output, error_output
+            output += data
+        process.stdin.write(line)
+        process.stdin.flush()
+    rest, error_output = process.communicate()
+    sys.stderr.buffer.write(error_output)
+    sys.stderr.flush()
+    return process.returncode, output + rest, error_output
+
+
 def main():
     """Main function"""
     parser = argparse.ArgumentParser(description='Test runner for cfunge')
@@ -67,31 +152,132 @@ def main():
                         default=0,
                         type=int,
                         help='Expected exit code (default: 0)')
+    parser.add_argument('--image',
+                        action='store_true',
+                        help='Run the test from a saved image of the program')
+    parser.add_argument('--replay',
+                        action='store_true',
+                        help='Record a run with -r, then replay it with -R with no input and require the same output')
+    parser.add_argument('--replay-from',
+                        metavar='PROGRAM',
+                        help='Record a run of PROGRAM with -r and replay that log with the test, which should fail')
+    parser.add_argument('--seed',
+                        help='Run the test twice with -z SEED and require the same output')
+    parser.add_argument('--samples',
+                        action='store_true',
+                        help='Run with -p and check that the samples written are well formed')
+    parser.add_argument('--profile',
+                        action='store_true',
+                        help='Run with -P, compare the report with <test>.profile.expected '
+                             'and the heatmap with <test>.pgm.expected')
+    parser.add_argument('--trace',
+                        action='store_true',
+                        help='Run with -T and compare the trace decoded by cfunge-trace.py '
+                             'with <test>.trace.expected')
+    parser.add_argument('--checkpoint',
+                        action='store_true',
+                        help='Run with -C, then resume the last checkpoint with -I and compare '
+                             'its output with <test>.resume.expected')
+    parser.add_argument('--prompts',
+                        action='store_true',
+                        help='Only send each line of <test>.input after the program printed a prompt '
+                             'ending in "? ", so output must be flushed before reading')
+    parser.add_argument('--cell-bits',
+                        metavar='BITS',
+                        help='Compare the output with <test>.BITS.expected, for output that depends '
+                             'on the cell size')
+    parser.add_argument('--error',
+                        metavar='TEXT',
+                        help='Require TEXT in the error output')
     args = parser.parse_args()
     test = args.test_file
     test_extension = test.split('.')[-1]
     expected_file_path_base = '.'.join(test.split('.')[:-1])
-    ret_code = 0
-    output = b''
-    try:
-        output = subprocess.check_output([args.cfunge_path,
-                                          '-s', _SUFFIX_MAP[test_extension],
-                                          test],
-                                         env={'TEST_ENV': 'test'})
-    except subprocess.CalledProcessError as e:
-        ret_code = e.returncode
-        output = e.output
+    command = [args.cfunge_path, '-s', _SUFFIX_MAP[test_extension], test]
+    stdin_data = read_input(expected_file_path_base)
+    if args.image:
+        subprocess.check_call([args.cfunge_path, '-O', 'test.img', test])
+        command[-1:] = ['-I', 'test.img']
+    if args.replay:
+        command[1:1] = ['-r', 'replay.log']
+    elif args.replay_from:
+        other_base = '.'.join(args.replay_from.split('.')[:-1])
+        run([args.cfunge_path, '-r', 'replay.log', args.replay_from],
+            read_input(other_base))
+        command[1:1] = ['-R', 'replay.log']
+        stdin_data = b''
+    elif args.seed is not None:
+        command[1:1] = ['-z', args.seed]
+    elif args.samples:
+        command[1:1] = ['-p', 'samples.folded']
+    elif args.profile:
+        command[1:1] = ['-P', 'profile.pgm']
+    elif args.trace:
+        command[1:1] = ['-T', 'test.trace']
+    elif args.checkpoint:
+        command[1:1] = ['-C', 'checkpoint.img']
+    if args.prompts:
+        ret_code, output, error_output = run_prompted(command, stdin_data)
+    else:
+        ret_code, output, error_output = run(command, stdin_data)
 
-    success = True
+    # A missing prompt was already reported by run_prompted().
+    success = ret_code is not None
 
     if ret_code != args.exit_code:
         print("Incorrect exit code %r (expected %r)" % (ret_code, args.exit_code), file=sys.stderr)
 
-    with open(expected_file_path_base + '.expected', mode='rb') as expected_file:
-        success = compare_contents("Output",
-                                   expected_file.read(),
-                                   output,
-                                   args.test_filter) and success
+    if args.replay:
+        replay_command = [args.cfunge_path, '-R', 'replay.log'] + command[3:]
+        replay_ret_code, replay_output, _ = run(replay_command, b'')
+        if replay_ret_code != ret_code:
+            print("Incorrect exit code %r when replaying (expected %r)" % (replay_ret_code, ret_code),
+                  file=sys.stderr)
+            success = False
+        success = compare_contents("replayed output", output, replay_output, None) and success
+    elif args.replay_from and b"doesn't match this run" not in error_output:
+        print("Replaying a log from another program didn't report a mismatch", file=sys.stderr)
+        success = False
+    elif args.seed is not None:
+        _, second_output, _ = run(command, stdin_data)
+        success = compare_contents("output of second run", output, second_output, None) and success
+    elif args.samples:
+        success = check_samples(test) and success
+    elif args.profile:
+        with open(expected_file_path_base + '.profile.expected', mode='rb') as expected_file:
+            success = compare_contents("profile report", expected_file.read(), error_output, None) and success
+        with open(expected_file_path_base + '.pgm.expected', mode='rb') as expected_file, \
+             open('profile.pgm', mode='rb') as actual_file:
+            success = compare_contents("profile heatmap", expected_file.read(), actual_file.read(), None) and success
+    elif args.checkpoint:
+        # The checkpoint is written by a child of cfunge, run() has waited for
+        # it too as it keeps stdout open.
+        resume_command = [args.cfunge_path] + command[3:-1] + ['-I', 'checkpoint.img']
+        _, resumed_output, _ = run(resume_command, stdin_data)
+        with open(expected_file_path_base + '.resume.expected', mode='rb') as expected_file:
+            success = compare_contents("resumed output", expected_file.read(), resumed_output, None) and success
+    elif args.trace:
+        decoded = subprocess.run([sys.executable, _TRACE_DECODER, 'dump', 'test.trace'],
+                                 stdout=subprocess.PIPE, check=True).stdout
+        with open(expected_file_path_base + '.trace.expected', mode='rb') as expected_file:
+            success = compare_contents("decoded trace", expected_file.read(), decoded, None) and success
+
+    if args.error is not None and args.error.encode() not in error_output:
+        print("Expected %r in the error output" % args.error, file=sys.stderr)
+        success = False
+
+    # The random numbers depend on the PRNG cfunge was built with, so --seed
+    # and --replay tests only need an expected file if their output doesn't.
+    if args.cell_bits is not None:
+        expected_file_path = '%s.%s.expected' % (expected_file_path_base, args.cell_bits)
+    else:
+        expected_file_path = expected_file_path_base + '.expected'
+    if (args.seed is None and not args.replay) or os.path.exists(expected_file_path):
+        with open(expected_file_path, mode='rb') as expected_file:
+            success = compare_contents("Output",
+                                       expected_file.read(),
+                                       output,
+                                       args.test_filter) and success
     if os.path.exists('cfunge_TURT.svg'):
         with open(expected_file_path_base + '.TURT.expected', mode='rb') as expected_file, \
              open('cfunge_TURT.svg', mode='rb') as actual_file:
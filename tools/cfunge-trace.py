@@ -0,0 +1,217 @@
+#!/usr/bin/python3
+"""Decode, filter and diff binary traces written by cfunge -T"""
+
+import argparse
+import struct
+import sys
+
+# See src/trace.h for the layout.
+_MAGIC = b'CFUNTRC\0'
+_VERSION = 1
+_BYTEORDER = 0x01020304
+_HEADER = '8sIIIIQQ24x'
+_RECORD = 'QQqqqqqII'
+_FIELDS = ('sequence', 'tick', 'id', 'x', 'y', 'opcode', 'top', 'depth', 'flags')
+
+_FLAG_TOP = 0x1
+_FLAG_STRING = 0x2
+
+
+class TraceError(Exception):
+    """Invalid trace file"""
+
+
+class Record:
+    """One executed instruction"""
+    __slots__ = _FIELDS
+
+    def __init__(self, values):
+        for name, value in zip(_FIELDS, values):
+            setattr(self, name, value)
+
+    def key(self):
+        """Fields compared by diff. The sequence number is not included so
+        traces can be compared from different starting points."""
+        return (self.tick, self.id, self.x, self.y, self.opcode,
+                self.depth, self.flags, self.top)
+
+    def __str__(self):
+        if 32 <= self.opcode < 127:
+            char = chr(self.opcode)
+        else:
+            char = '?'
+        text = '%d tick=%d ip=%d x=%d y=%d: %s (%d) depth=%d' % (
+            self.sequence, self.tick, self.id, self.x, self.y,
+            char, self.opcode, self.depth)
+        if self.flags & _FLAG_TOP:
+            text += ' top=%d' % self.top
+        if self.flags & _FLAG_STRING:
+            text += ' string'
+        return text
+
+
+def read_trace(path):
+    """Return the records in a trace file, oldest first"""
+    with open(path, mode='rb') as f:
+        data = f.read()
+    header_size = struct.calcsize('=' + _HEADER)
+    if len(data) < header_size or data[:8] != _MAGIC:
+        raise TraceError('%s: not a cfunge trace' % path)
+    for order in '<>':
+        header = struct.unpack_from(order + _HEADER, data)
+        if header[2] == _BYTEORDER:
+            break
+    else:
+        raise TraceError('%s: unknown byte order' % path)
+    _, version, _, record_size, _, capacity, written = header
+    if version != _VERSION:
+        raise TraceError('%s: unsupported version %d' % (path, version))
+    record = struct.Struct(order + _RECORD)
+    if record_size != record.size:
+        raise TraceError('%s: unexpected record size %d' % (path, record_size))
+    if len(data) < header_size + capacity * record_size:
+        raise TraceError('%s: truncated' % path)
+    # When the ring has wrapped, the oldest record is at written % capacity.
+    count = min(written, capacity)
+    start = written - count
+    for sequence in range(start, written):
+        offset = header_size + (sequence % capacity) * record_size
+        yield Record(record.unpack_from(data, offset))
+
+
+def parse_opcode(text):
+    """Parse an instruction given as a character or a number"""
+    if len(text) == 1 and not text.isdigit():
+        return ord(text)
+    return int(text, 0)
+
+
+def parse_region(text):
+    """Parse x1,y1,x2,y2 (inclusive)"""
+    values = [int(v) for v in text.split(',')]
+    if len(values) != 4:
+        raise argparse.ArgumentTypeError('region must be x1,y1,x2,y2')
+    return values
+
+
+def matches(record, args):
+    """Check if record passes the filters of dump"""
+    if args.ip is not None and record.id not in args.ip:
+        return False
+    if args.opcode is not None and record.opcode not in args.opcode:
+        return False
+    if args.start is not None and record.tick < args.start:
+        return False
+    if args.end is not None and record.tick > args.end:
+        return False
+    if args.region is not None:
+        x1, y1, x2, y2 = args.region
+        if not (x1 <= record.x <= x2 and y1 <= record.y <= y2):
+            return False
+    return True
+
+
+def dump(args):
+    """Print the records of a trace"""
+    shown = 0
+    for record in read_trace(args.trace):
+        if not matches(record, args):
+            continue
+        print(record)
+        shown += 1
+        if args.limit is not None and shown >= args.limit:
+            break
+    return 0
+
+
+def diff(args):
+    """Report the first difference between two traces"""
+    old = read_trace(args.old)
+    new = read_trace(args.new)
+    history = []
+    index = 0
+    while True:
+        a = next(old, None)
+        b = next(new, None)
+        if a is None and b is None:
+            print('Traces are identical (%d records)' % index)
+            return 0
+        if a is None or b is None or a.key() != b.key():
+            break
+        history.append(a)
+        if len(history) > args.context:
+            history.pop(0)
+        index += 1
+    print('Traces differ at record %d' % index)
+    for record in history:
+        print('  %s' % record)
+    print('- %s' % (a if a is not None else '(end of trace)'))
+    print('+ %s' % (b if b is not None else '(end of trace)'))
+    for _ in range(args.context):
+        a = next(old, None)
+        b = next(new, None)
+        if a is None and b is None:
+            break
+        if a is not None:
+            print('- %s' % a)
+        if b is not None:
+            print('+ %s' % b)
+    return 1
+
+
+def main():
+    """Main function"""
+    parser = argparse.ArgumentParser(description='Decode traces written by cfunge -T')
+    subparsers = parser.add_subparsers(dest='command')
+    subparsers.required = True
+
+    dump_parser = subparsers.add_parser('dump', help='Print records, optionally filtered')
+    dump_parser.add_argument('trace',
+                             help='Trace file')
+    dump_parser.add_argument('--ip',
+                             action='append',
+                             type=int,
+                             help='Only show this IP ID (may be repeated)')
+    dump_parser.add_argument('--opcode',
+                             action='append',
+                             type=parse_opcode,
+                             help='Only show this instruction, as character or number (may be repeated)')
+    dump_parser.add_argument('--from',
+                             dest='start',
+                             type=int,
+                             help='Only show records from this tick')
+    dump_parser.add_argument('--to',
+                             dest='end',
+                             type=int,
+                             help='Only show records up to and including this tick')
+    dump_parser.add_argument('--region',
+                             type=parse_region,
+                             help='Only show records inside x1,y1,x2,y2 (inclusive)')
+    dump_parser.add_argument('--limit',
+                             type=int,
+                             help='Stop after this many records')
+    dump_parser.set_defaults(function=dump)
+
+    diff_parser = subparsers.add_parser('diff', help='Find the first difference between two traces')
+    diff_parser.add_argument('old',
+                             help='First trace file')
+    diff_parser.add_argument('new',
+                             help='Second trace file')
+    diff_parser.add_argument('--context',
+                             default=5,
+                             type=int,
+                             help='Records to show before and after the difference (default: 5)')
+    diff_parser.set_defaults(function=diff)
+
+    args = parser.parse_args()
+    try:
+        sys.exit(args.function(args))
+    except TraceError as e:
+        print(e, file=sys.stderr)
+        sys.exit(2)
+    except BrokenPipeError:
+        sys.exit(0)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,126 @@
+/* -*- mode: C; coding: utf-8; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*-
+ *
+ * cfunge - A standard-conforming Befunge93/98/109 interpreter in C.
+ * Copyright (C) 2008-2013 Arvid Norlander <VorpalBlade AT users.noreply.github.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at the proxy's option) any later version. Arvid Norlander is a
+ * proxy who can decide which future versions of the GNU General Public
+ * License can be used.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Checks that the double versions of the FIXP trigonometric functions give
+ * the same result as the long double reference versions. Built and run by
+ * "make check-fixp".
+ *
+ * Without arguments every input where the result changes quickly is checked,
+ * along with a fixed sequence of random inputs. With -f every 32-bit input is
+ * checked for all functions, this takes a long time.
+ */
+
+#define FIXP_CHECK
+#include "fingerprints/FIXP/FIXP.c"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/// Number of mismatches to print before only counting them.
+#define MAX_REPORTED 20
+/// Number of random inputs checked.
+#define RANDOM_COUNT 3000000
+
+typedef funge_cell (*fixp_func)(funge_cell n);
+
+typedef struct fixp_test {
+	const char *name;
+	fixp_func fast;
+	fixp_func ref;
+	/// Inputs from -limit to limit are checked without -f.
+	int64_t limit;
+	uint64_t checked;
+	uint64_t failed;
+} fixp_test;
+
+static fixp_test tests[] = {
+	{ "acos", fixp_acos, fixp_ref_acos,    20000, 0, 0 },
+	{ "asin", fixp_asin, fixp_ref_asin,    20000, 0, 0 },
+	{ "atan", fixp_atan, fixp_ref_atan, 10000000, 0, 0 },
+	{ "cos",  fixp_cos,  fixp_ref_cos,   7200000, 0, 0 },
+	{ "sin",  fixp_sin,  fixp_ref_sin,   7200000, 0, 0 },
+	{ "tan",  fixp_tan,  fixp_ref_tan,   7200000, 0, 0 },
+};
+
+#define TEST_COUNT (sizeof(tests) / sizeof(tests[0]))
+
+static uint64_t reported = 0;
+
+static void check(fixp_test * test, funge_cell n)
+{
+	funge_cell got = test->fast(n);
+	funge_cell expected = test->ref(n);
+	test->checked++;
+	if (got == expected)
+		return;
+	test->failed++;
+	if (reported++ < MAX_REPORTED)
+		printf("fixp-check: %s(%" FUNGECELLPRI "): got %" FUNGECELLPRI ", expected %" FUNGECELLPRI "\n",
+		       test->name, n, got, expected);
+}
+
+/// xorshift64, with a fixed seed so that a failure can be reproduced.
+static uint64_t random_state = UINT64_C(88172645463325252);
+
+static uint64_t random_next(void)
+{
+	random_state ^= random_state << 13;
+	random_state ^= random_state >> 7;
+	random_state ^= random_state << 17;
+	return random_state;
+}
+
+int main(int argc, char *argv[])
+{
+	bool full = false;
+	uint64_t failed = 0;
+
+	if (argc == 2 && strcmp(argv[1], "-f") == 0) {
+		full = true;
+	} else if (argc != 1) {
+		fprintf(stderr, "Usage: %s [-f]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	for (size_t i = 0; i < TEST_COUNT; i++) {
+		int64_t first = full ? INT32_MIN : -tests[i].limit;
+		int64_t last = full ? INT32_MAX : tests[i].limit;
+		for (int64_t n = first; n <= last; n++)
+			check(&tests[i], (funge_cell)n);
+	}
+	for (uint64_t j = 0; j < RANDOM_COUNT; j++) {
+		uint64_t r = random_next();
+		for (size_t i = 0; i < TEST_COUNT; i++) {
+			check(&tests[i], (funge_cell)r);
+			check(&tests[i], (funge_cell)(int32_t)r);
+		}
+	}
+
+	for (size_t i = 0; i < TEST_COUNT; i++) {
+		printf("%-4s %" PRIu64 " of %" PRIu64 " inputs differ\n",
+		       tests[i].name, tests[i].failed, tests[i].checked);
+		failed += tests[i].failed;
+	}
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -131,6 +131,13 @@ genfprintinfo() {
 		FPRINTHEX+="$hex"
 	done
 	ENTRIES+=( "$FPRINTHEX" )
+	# Bit n set means the fingerprint implements instruction 'A' + n.
+	local OPCODEMASK=0
+	for (( i = 0; i < ${#fp_OPCODES}; i++ )); do
+		printf -v hex '%d' "'${fp_OPCODES:$i:1}"
+		(( OPCODEMASK |= 1 << (hex - 65) ))
+	done
+	printf -v OPCODEMASK '0x%07x' "$OPCODEMASK"
 
 	if [[ $GENERATE_MAN ]]; then
 		MANENTRY1[$FPRINTHEX]="${FPRINT}"
@@ -143,7 +150,7 @@ genfprintinfo() {
 		[[ "$fp_CONDITION" ]] && ENTRYL1_cond[$FPRINTHEX]="#if $fp_CONDITION"
 		ENTRYL2[$FPRINTHEX]="	// ${FPRINT} - ${fp_DESCRIPTION}"
 		ENTRYL3[$FPRINTHEX]="	{ .fprint = ${FPRINTHEX}, .uri = ${fp_F109_URI}, .loader = &finger_${FPRINT}_load, .opcodes = \"${fp_OPCODES}\","
-		ENTRYL4[$FPRINTHEX]="	  .url = \"${fp_URL}\", .safe = ${fp_SAFE} },"
+		ENTRYL4[$FPRINTHEX]="	  .opcodemask = ${OPCODEMASK}, .url = \"${fp_URL}\", .safe = ${fp_SAFE} },"
 		[[ "$fp_CONDITION" ]] && ENTRYL5_cond[$FPRINTHEX]="#endif"
 		statuslvl2 "Done"
 		if [[ ${!fp_ALIASES[*]} ]]; then
@@ -160,7 +167,7 @@ genfprintinfo() {
 				[[ "$fp_CONDITION" ]] && ENTRYL1_cond[$ALIASHEX]="#if $fp_CONDITION"
 				ENTRYL2[$ALIASHEX]="	// ${myalias} - Alias for ${FPRINT} - ${fp_DESCRIPTION}"
 				ENTRYL3[$ALIASHEX]="	{ .fprint = ${ALIASHEX}, .uri = ${fp_F109_URI}, .loader = &finger_${myalias}_load, .opcodes = \"${fp_OPCODES}\","
-				ENTRYL4[$ALIASHEX]="	  .url = \"${fp_URL}\", .safe = ${fp_SAFE} },"
+				ENTRYL4[$ALIASHEX]="	  .opcodemask = ${OPCODEMASK}, .url = \"${fp_URL}\", .safe = ${fp_SAFE} },"
 				[[ "$fp_CONDITION" ]] && ENTRYL5_cond[$ALIASHEX]="#endif"
 			done
 		fi
@@ -251,12 +258,13 @@ typedef struct s_ImplementedFingerprintEntry {
 	const char            * uri;      /**< URI, used for Funge-109. */
 	const fingerprintLoader loader;   /**< Loader function pointer. */
 	const char            * opcodes;  /**< Sorted string with all implemented opcodes. */
+	const uint32_t          opcodemask; /**< Same as opcodes, bit n is set for instruction 'A' + n. */
 	const char            * url;      /**< URL, used to show links for more info about fingerprints. */
 	const bool              safe;     /**< If true, this fingerprint is safe in sandbox mode. */
 } ImplementedFingerprintEntry;
 
 // Implemented fingerprints
-// NOTE: Keep sorted!
+// NOTE: Keep sorted! Lookup is a binary search on fprint.
 // Also note that this table is processed by scripts, so keep the .loader and
 // .opcodes entries on the same line! As well as in current format.
 static const ImplementedFingerprintEntry ImplementedFingerprints[] = {